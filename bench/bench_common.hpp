@@ -0,0 +1,136 @@
+#pragma once
+
+// Helpers every benchmark and check under bench/ shares.
+
+#include <types.inl>
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#elif defined(__APPLE__)
+#include <mach/mach.h>
+#include <sys/resource.h>
+#else
+#include <fstream>
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+namespace tmx {
+
+template<typename Fn>
+f64 time_ms(Fn &&fn) {
+  const auto begin = std::chrono::steady_clock::now();
+  fn();
+  const auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<f64, std::chrono::milliseconds::period>(end - begin).count();
+}
+
+// Peak resident set of the process so far, on Linux since the last
+// reset_peak_rss.
+inline u64 peak_rss_bytes(void) {
+#if defined(_WIN32)
+  PROCESS_MEMORY_COUNTERS counters{};
+  GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters));
+  return static_cast<u64>(counters.PeakWorkingSetSize);
+#elif defined(__APPLE__)
+  rusage usage{};
+  getrusage(RUSAGE_SELF, &usage);
+  return static_cast<u64>(usage.ru_maxrss);
+#else
+  // ru_maxrss ignores reset_peak_rss, VmHWM follows it.
+  std::ifstream status("/proc/self/status");
+  std::string line;
+  while(std::getline(status, line)) {
+    if(line.rfind("VmHWM:", 0) == 0) {
+      return std::strtoull(line.c_str() + 6, nullptr, 10)*1024;
+    }
+  }
+  rusage usage{};
+  getrusage(RUSAGE_SELF, &usage);
+  return static_cast<u64>(usage.ru_maxrss)*1024;
+#endif
+}
+
+// Resident set of the process right now.
+inline u64 current_rss_bytes(void) {
+#if defined(_WIN32)
+  PROCESS_MEMORY_COUNTERS counters{};
+  GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters));
+  return static_cast<u64>(counters.WorkingSetSize);
+#elif defined(__APPLE__)
+  mach_task_basic_info info{};
+  mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+  if(task_info(mach_task_self(), MACH_TASK_BASIC_INFO, reinterpret_cast<task_info_t>(&info), &count) != KERN_SUCCESS) {
+    return 0;
+  }
+  return static_cast<u64>(info.resident_size);
+#else
+  std::ifstream statm("/proc/self/statm");
+  u64 size_pages{0}, resident_pages{0};
+  statm >> size_pages >> resident_pages;
+  return resident_pages*static_cast<u64>(sysconf(_SC_PAGESIZE));
+#endif
+}
+
+// Starts a new peak at the current resident set where the OS allows it,
+// which is only Linux. Returns whether it did.
+inline bool reset_peak_rss(void) {
+#if defined(_WIN32) || defined(__APPLE__)
+  return false;
+#else
+  std::ofstream clear_refs("/proc/self/clear_refs");
+  clear_refs << "5";
+  clear_refs.flush();
+  return static_cast<bool>(clear_refs);
+#endif
+}
+
+// Resident memory one run adds on top of what the process held when it
+// started, so runs are not hidden behind the peak of an earlier, larger
+// one. Where the peak cannot be reset the resident set at the time of
+// bytes() is used instead, read it while the run's allocations are alive.
+struct RssProbe {
+  public:
+  RssProbe(void) : start{current_rss_bytes()}, peak_reset{reset_peak_rss()} {}
+
+  [[nodiscard]]
+  u64 bytes(void) const {
+    const u64 end = peak_reset ? peak_rss_bytes() : current_rss_bytes();
+    return end > start ? end - start : 0;
+  }
+
+  private:
+  u64 start;
+  bool peak_reset;
+};
+
+// Comma separated unsigned values of a command line option, e.g. 8,16,32.
+inline std::vector<u32> parse_list(const std::string &arg, const std::string &value) {
+  std::vector<u32> list;
+  std::istringstream fields(value);
+  std::string field;
+  while(std::getline(fields, field, ',')) {
+    char *end{nullptr};
+    const unsigned long parsed = std::strtoul(field.c_str(), &end, 10);
+    if(end == field.c_str() || *end != '\0' || parsed > UINT32_MAX) {
+      throw std::runtime_error("Invalid value " + value + " for " + arg + "!");
+    }
+    list.push_back(static_cast<u32>(parsed));
+  }
+  if(list.empty()) {
+    throw std::runtime_error("Missing value for " + arg + "!");
+  }
+  return list;
+}
+
+}
@@ -0,0 +1,122 @@
+// Throughput of the terrain collision queries on a synthetic mesh,
+// independent of the renderer and the GPU.
+//
+// usage: collision_bench [queries] [threads] [subdivisions]
+
+#include "../src/cpu/systems/terrain_collision.hpp"
+#include "bench_common.hpp"
+
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+
+using namespace tmx;
+
+namespace {
+
+// Rolling heightfield kept inside one layer of chunks so every
+// triangle stays within the box of the chunk that owns it.
+f32 height(const f32 x, const f32 z, const f32 base) {
+  return base + 0.5f*COUNT_VOXELS_Y + 3.0f*glm::sin(x*0.21f)*glm::cos(z*0.17f);
+}
+
+std::vector<float4> chunk_mesh(const int3 chunk, const u32 subdivisions, const f32 base) {
+  std::vector<float4> vertices;
+  const f32 cell = 1.0f / static_cast<f32>(subdivisions);
+  const u32 cells_x = COUNT_VOXELS_X*subdivisions;
+  const u32 cells_z = COUNT_VOXELS_Z*subdivisions;
+
+  for(u32 z = 0; z < cells_z; z++) {
+  for(u32 x = 0; x < cells_x; x++) {
+    const f32 x0 = chunk.x*COUNT_VOXELS_X + x*cell, x1 = x0 + cell;
+    const f32 z0 = chunk.z*COUNT_VOXELS_Z + z*cell, z1 = z0 + cell;
+    const float4 a{x0, height(x0, z0, base), z0, 1.0f};
+    const float4 b{x1, height(x1, z0, base), z0, 1.0f};
+    const float4 c{x1, height(x1, z1, base), z1, 1.0f};
+    const float4 d{x0, height(x0, z1, base), z1, 1.0f};
+    vertices.insert(vertices.end(), {a, c, b, a, d, c});
+  }
+  }
+
+  return vertices;
+}
+
+void report(const char *name, const u32 count, const f64 ms, const std::vector<CollisionHit> &hits) {
+  u32 hit_count{0};
+  for(const CollisionHit &hit : hits) {
+    hit_count += hit.hit ? 1 : 0;
+  }
+  std::cout
+    << name << ": " << count << " queries in " << ms << " ms, "
+    << (count / ms) / 1000.0 << " Mq/s, "
+    << hit_count << " hits" << std::endl;
+}
+
+}
+
+int main(int argc, char **argv) {
+  const u32 query_count = argc > 1 ? static_cast<u32>(std::atoi(argv[1])) : 100000;
+  const u32 threads = std::max(argc > 2 ? static_cast<u32>(std::atoi(argv[2])) : std::thread::hardware_concurrency(), 1u);
+  const u32 subdivisions = argc > 3 ? static_cast<u32>(std::atoi(argv[3])) : 4;
+
+  ThreadPool thread_pool{threads - 1};
+  TerrainCollision collision{nullptr, &thread_pool};
+
+  const i32 layer = COUNT_CHUNKS_Y / 2;
+  const f32 base = static_cast<f32>(layer*COUNT_VOXELS_Y);
+  const f32 world_x = static_cast<f32>(COUNT_CHUNKS_X*COUNT_VOXELS_X);
+  const f32 world_y = static_cast<f32>(COUNT_CHUNKS_Y*COUNT_VOXELS_Y);
+  const f32 world_z = static_cast<f32>(COUNT_CHUNKS_Z*COUNT_VOXELS_Z);
+
+  std::vector<std::vector<float4>> meshes;
+  std::vector<int3> mesh_chunks;
+  for(i32 z = 0; z < COUNT_CHUNKS_Z; z++) {
+  for(i32 x = 0; x < COUNT_CHUNKS_X; x++) {
+    mesh_chunks.push_back(int3{x, layer, z});
+    meshes.push_back(chunk_mesh(mesh_chunks.back(), subdivisions, base));
+  }
+  }
+
+  u64 triangle_count{0};
+  const f64 build_ms = time_ms([&]() {
+    for(u32 i = 0; i < meshes.size(); i++) {
+      collision.update_chunk(mesh_chunks[i], meshes[i].data(), static_cast<u32>(meshes[i].size()));
+      triangle_count += meshes[i].size() / 3;
+    }
+  });
+
+  // Same triangle count, so this takes the refit path.
+  const f64 refit_ms = time_ms([&]() {
+    for(u32 i = 0; i < meshes.size(); i++) {
+      collision.update_chunk(mesh_chunks[i], meshes[i].data(), static_cast<u32>(meshes[i].size()));
+    }
+  });
+
+  std::cout
+    << threads << " threads, " << meshes.size() << " chunks, " << triangle_count << " triangles" << std::endl
+    << "build: " << build_ms << " ms, refit: " << refit_ms << " ms" << std::endl;
+
+  std::mt19937 rng{1337};
+  std::uniform_real_distribution<f32> unit{0.0f, 1.0f};
+
+  std::vector<RaycastQuery> rays(query_count);
+  std::vector<SphereOverlapQuery> spheres(query_count);
+  std::vector<CapsuleSweepQuery> capsules(query_count);
+  for(u32 i = 0; i < query_count; i++) {
+    const float3 p{unit(rng)*world_x, base + unit(rng)*COUNT_VOXELS_Y, unit(rng)*world_z};
+    const float3 above{p.x, world_y - 1.0f, p.z};
+
+    rays[i] = RaycastQuery{above, float3{unit(rng) - 0.5f, -1.0f, unit(rng) - 0.5f}, 1000.0f};
+    spheres[i] = SphereOverlapQuery{p, 0.5f + unit(rng)*1.5f};
+    capsules[i] = CapsuleSweepQuery{above, above + float3{0.0f, 1.8f, 0.0f}, 0.4f, float3{0.0f, -world_y, 0.0f}};
+  }
+
+  std::vector<CollisionHit> hits(query_count);
+
+  report("raycast", query_count, time_ms([&]() { collision.raycast(rays, hits); }), hits);
+  report("sphere overlap", query_count, time_ms([&]() { collision.overlap_sphere(spheres, hits); }), hits);
+  report("capsule sweep", query_count, time_ms([&]() { collision.sweep_capsule(capsules, hits); }), hits);
+
+  return 0;
+}
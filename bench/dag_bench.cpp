@@ -0,0 +1,89 @@
+// Offline bake of the procedural density into a voxel DAG, with its size
+// against dense storage and the throughput of online leaf updates.
+//
+// usage: dag_bench [levels] [updates] [output.dag]
+//
+// The baked DAG is written before the updates; passed to the application
+// as --dag output.dag, it replaces the generated world as a static one.
+
+#include "../src/cpu/systems/voxel_dag.hpp"
+#include "../src/cpu/systems/density_bounds.hpp"
+#include "bench_common.hpp"
+
+#include <cstdlib>
+#include <iostream>
+#include <random>
+
+using namespace tmx;
+
+namespace {
+
+u64 leaf_mask(const int3 origin) {
+  u64 mask{0};
+  for(i32 z = 0; z < DAG_LEAF_VOXELS; z++) {
+  for(i32 y = 0; y < DAG_LEAF_VOXELS; y++) {
+  for(i32 x = 0; x < DAG_LEAF_VOXELS; x++) {
+    if(DensityBounds::fbm(float3{origin + int3{x, y, z}}) < 0.0f) {
+      mask |= u64{1} << dag_leaf_bit(int3{x, y, z});
+    }
+  }
+  }
+  }
+  return mask;
+}
+
+}
+
+int main(int argc, char **argv) {
+  const u32 levels = argc > 1 ? static_cast<u32>(std::atoi(argv[1])) : 6;
+  const u32 update_count = argc > 2 ? static_cast<u32>(std::atoi(argv[2])) : 100000;
+  const char *output = argc > 3 ? argv[3] : nullptr;
+
+  const DagSource source {
+    .classify = [](const int3 lo, const int3 hi) { return DensityBounds::classify_bound(lo, hi, 0.0f); },
+    .leaf = leaf_mask,
+  };
+
+  VoxelDag dag{};
+  const f64 build_ms = time_ms([&]() { dag = VoxelDag::build(levels, source); });
+
+  const f64 side = static_cast<f64>(dag.side());
+  const f64 voxels = side*side*side;
+  std::cout
+    << "side " << dag.side() << " (" << voxels << " voxels), built in " << build_ms << " ms" << std::endl
+    << "dag: " << dag.size_bytes() << " bytes, "
+    << voxels*sizeof(f32) / dag.size_bytes() << "x smaller than dense f32, "
+    << voxels/8.0 / dag.size_bytes() << "x smaller than a dense bit grid" << std::endl;
+
+  std::mt19937 rng{1337};
+  std::uniform_int_distribution<i32> coord{0, dag.side() - 1};
+
+  u32 mismatches{0};
+  for(u32 i = 0; i < 100000; i++) {
+    const int3 v{coord(rng), coord(rng), coord(rng)};
+    mismatches += dag.occupied(v) != (DensityBounds::fbm(float3{v}) < 0.0f) ? 1 : 0;
+  }
+  std::cout << "verify: " << mismatches << " of 100000 sampled voxels differ" << std::endl;
+
+  if(output != nullptr) {
+    dag.save(output);
+    std::cout << "saved " << output << std::endl;
+  }
+
+  // Online updates carve random leaves out and path-copy their ancestors.
+  const f64 update_ms = time_ms([&]() {
+    for(u32 i = 0; i < update_count; i++) {
+      const int3 origin = int3{coord(rng), coord(rng), coord(rng)} & ~(DAG_LEAF_VOXELS - 1);
+      dag.set_leaf(origin, 0);
+    }
+  });
+  const u64 stale_bytes = dag.size_bytes();
+  const f64 compact_ms = time_ms([&]() { dag.compact(); });
+
+  std::cout
+    << "updates: " << update_count << " in " << update_ms << " ms, "
+    << (update_count / update_ms) / 1000.0 << " M/s" << std::endl
+    << "compact: " << stale_bytes << " -> " << dag.size_bytes() << " bytes in " << compact_ms << " ms" << std::endl;
+
+  return 0;
+}
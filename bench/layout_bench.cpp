@@ -0,0 +1,119 @@
+// Host-side cost of the voxel layout selected by VOXEL_LAYOUT: writing a
+// generated world, gathering cell corners the way meshing does and picking.
+// Built once per layout as layout_bench_linear and layout_bench_morton.
+//
+// usage: layout_bench [repeats] [rays]
+
+#include "../src/cpu/systems/terrain_picker.hpp"
+#include "bench_common.hpp"
+
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+
+using namespace tmx;
+
+namespace {
+
+// Rolling hills, cheap enough that memory access dominates.
+f32 density(const int3 v) {
+  const f32 height = 0.5f*COUNT_VOXELS_Y*COUNT_CHUNKS_Y + 6.0f*glm::sin(v.x*0.13f)*glm::cos(v.z*0.11f);
+  return static_cast<f32>(v.y) - height;
+}
+
+}
+
+int main(int argc, char **argv) {
+  const u32 repeats = argc > 1 ? static_cast<u32>(std::atoi(argv[1])) : 20;
+  const u32 ray_count = argc > 2 ? static_cast<u32>(std::atoi(argv[2])) : 100000;
+
+  const int3 voxels_per_chunk{COUNT_VOXELS_X, COUNT_VOXELS_Y, COUNT_VOXELS_Z};
+  const int3 world_voxels = int3{COUNT_CHUNKS_X, COUNT_CHUNKS_Y, COUNT_CHUNKS_Z}*voxels_per_chunk;
+
+  std::vector<DensityCode> voxels(static_cast<size_t>(COUNT_VOXELS)*COUNT_CHUNKS);
+  std::vector<u32> page_table(COUNT_CHUNKS);
+  std::vector<float2> summaries(COUNT_SUMMARIES, float2{1e30f, -1e30f});
+  for(u32 i = 0; i < COUNT_CHUNKS; i++) {
+    page_table[i] = i;
+  }
+
+  std::cout << (VOXEL_LAYOUT == VOXEL_LAYOUT_MORTON ? "morton" : "linear") << " layout, "
+            << voxels.size()*sizeof(DensityCode) << " bytes of voxels" << std::endl;
+
+  // Generation as a host loop: chunks in index order, voxels in x-major order.
+  const f64 generation_ms = time_ms([&]() {
+    for(u32 r = 0; r < repeats; r++) {
+      for(u32 c = 0; c < COUNT_CHUNKS; c++) {
+        const int3 origin = idx2chunk(c)*voxels_per_chunk;
+        for(i32 z = 0; z < COUNT_VOXELS_Z; z++) {
+        for(i32 y = 0; y < COUNT_VOXELS_Y; y++) {
+        for(i32 x = 0; x < COUNT_VOXELS_X; x++) {
+          voxels[pool_index(page_table[c], int3{x, y, z})] = encode_density(density(origin + int3{x, y, z}));
+        }
+        }
+        }
+      }
+    }
+  });
+
+  // Meshing visits cells in invocation order and reads 8 corners each,
+  // crossing into the +1 neighbours on the chunk borders.
+  u64 surface_cells{0};
+  const f64 meshing_ms = time_ms([&]() {
+    for(u32 r = 0; r < repeats; r++) {
+      for(u32 c = 0; c < COUNT_CHUNKS; c++) {
+        const int3 origin = idx2chunk(c)*voxels_per_chunk;
+        for(u32 t = 0; t < COUNT_VOXELS; t++) {
+          const int3 cell = origin + idx2voxel(t);
+          u32 config{0};
+          for(u32 i = 0; i < 8; i++) {
+            const int3 v = cell + int3{static_cast<i32>(i & 1), static_cast<i32>((i >> 1) & 1), static_cast<i32>((i >> 2) & 1)};
+            const f32 d = voxel_in_world(v) ?
+              decode_density(voxels[pool_index(page_table[chunk2idx(voxel_chunk(v))], voxel_local(v))]) :
+              static_cast<f32>(DENSITY_OUTSIDE_WORLD);
+            config |= (d < 0.0f ? 1u : 0u) << i;
+          }
+          surface_cells += (config != 0 && config != 255) ? 1 : 0;
+        }
+      }
+    }
+  });
+
+  // Same min/max reduction the generation shader runs.
+  for(u32 c = 0; c < COUNT_CHUNKS; c++) {
+    const int3 chunk = idx2chunk(c);
+    for(u32 t = 0; t < COUNT_VOXELS; t++) {
+      const int3 local = idx2voxel(t);
+      const f32 d = decode_density(voxels[pool_index(page_table[c], local)]);
+      for(const u32 index : {summary_chunk_index(chunk), summary_brick_index(chunk, local / COUNT_BRICK_VOXELS)}) {
+        summaries[index] = float2{glm::min(summaries[index].x, d), glm::max(summaries[index].y, d)};
+      }
+    }
+  }
+
+  const TerrainPicker picker{voxels.data(), page_table.data(), summaries.data()};
+
+  std::mt19937 rng{1337};
+  std::uniform_real_distribution<f32> unit{0.0f, 1.0f};
+  std::vector<Ray> rays(ray_count);
+  for(Ray &ray : rays) {
+    ray.pos = float3{unit(rng)*world_voxels.x, world_voxels.y - 1.0f, unit(rng)*world_voxels.z};
+    ray.dir = float3{unit(rng) - 0.5f, -1.0f, unit(rng) - 0.5f};
+  }
+
+  u32 hits{0};
+  const f64 picking_ms = time_ms([&]() {
+    for(const Ray &ray : rays) {
+      hits += picker.pick(ray).has_value() ? 1 : 0;
+    }
+  });
+
+  const f64 voxel_count = static_cast<f64>(COUNT_VOXELS)*COUNT_CHUNKS*repeats;
+  std::cout
+    << "generation: " << generation_ms*1e6 / voxel_count << " ns/voxel" << std::endl
+    << "meshing: " << meshing_ms*1e6 / voxel_count << " ns/cell, " << surface_cells / repeats << " surface cells" << std::endl
+    << "picking: " << picking_ms*1e6 / ray_count << " ns/ray, " << hits << " hits" << std::endl;
+
+  return 0;
+}
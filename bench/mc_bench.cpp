@@ -0,0 +1,306 @@
+// Terrain throughput: generates and meshes worlds of every combination of
+// the given sizes and seeds on the CPU reference engine and on a Vulkan
+// device, and writes chunks/s, voxels/s, triangles/s, memory and per-stage
+// timings as JSON for comparing builds.
+//
+// usage: mc_bench [--engine cpu|gpu|all] [--world-chunks N,N,..]
+//                 [--chunk-voxels N,N,..] [--seeds N,N,..] [--repeats N]
+//                 [--threads N] [--workgroup-size N] [--device NAME]
+//                 [--output PATH] [--chunk-stats PREFIX] [--validation]
+//
+// Worlds and chunks are cubes of the listed sides. --device picks the
+// first device whose name contains NAME, e.g. llvmpipe for lavapipe.
+// Timings are the best of the repeats, each on a freshly created world.
+// --chunk-stats has the GPU engine count per chunk costs, adds their
+// percentiles to the JSON and writes a PREFIX_<world>_<chunk>_<seed>.vtk
+// heatmap per run. The counters slow the kernels down somewhat.
+//
+// terrain_bytes is what the engine allocated for the world, for the GPU
+// engine the device memory of every terrain buffer. peak_rss_delta_bytes
+// is how far one configuration raised the resident set, see RssProbe.
+
+#include "../src/cpu/core/event_bus.hpp"
+#include "../src/cpu/core/events.hpp"
+#include "../src/cpu/core/grid_config.hpp"
+#include "../src/cpu/core/thread_pool.hpp"
+#include "../src/cpu/systems/chunk_stats.hpp"
+#include "../src/cpu/systems/cpu_mesher.hpp"
+#include "../src/cpu/systems/resource_manager.hpp"
+#include "../src/cpu/systems/terrain_system.hpp"
+#include "../src/cpu/vk/context.hpp"
+#include "../src/cpu/vk/timestamp_timer.hpp"
+#include "bench_common.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace tmx;
+
+namespace {
+
+struct BenchArgs {
+  std::string engine{"all"};
+  std::vector<u32> world_chunks{8};
+  std::vector<u32> chunk_voxels{8, 16, 32};
+  std::vector<u32> seeds{0};
+  u32 repeats{3};
+  u32 threads{std::max(std::thread::hardware_concurrency(), 1u)};
+  u32 workgroup_size{0};
+  std::string device{};
+  std::string output{"mc_bench.json"};
+  std::string chunk_stats{};
+  bool validation{false};
+};
+
+// One engine on one world, timings in milliseconds.
+struct BenchRun {
+  std::string engine;
+  std::string device;
+  GridConfig config;
+  u32 threads{1};
+  u32 workgroup_size{0};
+  u32 resident_chunks{0};
+  u64 triangles{0};
+  u64 terrain_bytes{0};
+  u64 peak_rss_delta_bytes{0};
+  f64 generation_ms{std::numeric_limits<f64>::max()};
+  f64 meshing_ms{std::numeric_limits<f64>::max()};
+  // Summed GPU timestamps, negative for the CPU engine.
+  f64 generation_gpu_ms{-1.0};
+  f64 meshing_gpu_ms{-1.0};
+  // Percentiles of ChunkStatsReport, empty without --chunk-stats.
+  std::string chunk_stats_json{};
+};
+
+BenchArgs parse_args(const int argc, const char *const *argv) {
+  BenchArgs args{};
+  for(int i = 1; i < argc; i++) {
+    const std::string arg{argv[i]};
+    if(arg == "--validation") {
+      args.validation = true;
+      continue;
+    }
+    if(i + 1 >= argc) {
+      throw std::runtime_error("Missing value for " + arg + "!");
+    }
+
+    const std::string value{argv[++i]};
+    if(arg == "--engine") args.engine = value;
+    else if(arg == "--world-chunks") args.world_chunks = parse_list(arg, value);
+    else if(arg == "--chunk-voxels") args.chunk_voxels = parse_list(arg, value);
+    else if(arg == "--seeds") args.seeds = parse_list(arg, value);
+    else if(arg == "--repeats") args.repeats = std::max(parse_list(arg, value).front(), 1u);
+    else if(arg == "--threads") args.threads = std::max(parse_list(arg, value).front(), 1u);
+    else if(arg == "--workgroup-size") args.workgroup_size = parse_list(arg, value).front();
+    else if(arg == "--device") args.device = value;
+    else if(arg == "--output") args.output = value;
+    else if(arg == "--chunk-stats") args.chunk_stats = value;
+    else throw std::runtime_error("Unknown argument " + arg + "!");
+  }
+
+  if(args.engine != "cpu" && args.engine != "gpu" && args.engine != "all") {
+    throw std::runtime_error("--engine takes cpu, gpu or all!");
+  }
+  return args;
+}
+
+// The CPU engine has no device to respect, only the grid's own checks.
+VkPhysicalDeviceLimits host_limits(void) {
+  VkPhysicalDeviceLimits limits{};
+  limits.maxComputeSharedMemorySize = UINT32_MAX;
+  limits.maxComputeWorkGroupInvocations = UINT32_MAX;
+  limits.maxComputeWorkGroupSize[0] = UINT32_MAX;
+  limits.maxDrawIndirectCount = UINT32_MAX;
+  return limits;
+}
+
+BenchRun run_cpu(const BenchArgs &args, const GridConfig &config, ThreadPool *thread_pool) {
+  config.apply(host_limits(), SUBGROUP_SIZE);
+
+  BenchRun run{.engine = "cpu", .device = "host", .config = config, .threads = args.threads};
+  const RssProbe rss{};
+  for(u32 repeat = 0; repeat < args.repeats; repeat++) {
+    CpuMesher mesher{thread_pool};
+    run.generation_ms = std::min(run.generation_ms, time_ms([&]() { mesher.generate(); }));
+    run.meshing_ms = std::min(run.meshing_ms, time_ms([&]() { mesher.mesh(); }));
+
+    run.resident_chunks = mesher.resident_count();
+    run.triangles = mesher.vertex_count() / 3;
+    run.terrain_bytes = mesher.size_bytes();
+    run.peak_rss_delta_bytes = std::max(run.peak_rss_delta_bytes, rss.bytes());
+  }
+  return run;
+}
+
+BenchRun run_gpu(const BenchArgs &args, const GridConfig &config, Context *vk_context, ResourceManager *resource_manager) {
+  config.apply(vk_context->get_limits(), vk_context->get_shader_subgroup_size());
+
+  BenchRun run{
+    .engine = "gpu",
+    .device = vk_context->get_device_name(),
+    .config = config,
+    .generation_gpu_ms = std::numeric_limits<f64>::max(),
+    .meshing_gpu_ms = std::numeric_limits<f64>::max(),
+  };
+  run.workgroup_size = WORKGROUP_SIZE;
+  const RssProbe rss{};
+  for(u32 repeat = 0; repeat < args.repeats; repeat++) {
+    EventBus event_bus{};
+
+    TimestampTimer generation_timer{vk_context, 1};
+    TimestampTimer meshing_timer{vk_context, static_cast<u32>(COUNT_CHUNKS_Y*COUNT_CHUNKS_Z)};
+
+    // The benchmark never draws, so the terrain needs no graphics pipeline.
+    TerrainManager terrain{vk_context, &event_bus, nullptr, resource_manager, !args.chunk_stats.empty()};
+    terrain.set_timers(&generation_timer, &meshing_timer);
+
+    run.generation_ms = std::min(run.generation_ms, time_ms([&]() {
+      event_bus.notify<IsosurfaceGenerationEvent>(IsosurfaceGenerationEvent{.progress = int3{0}});
+    }));
+    run.meshing_ms = std::min(run.meshing_ms, time_ms([&]() {
+      event_bus.notify<IsosurfaceMeshingEvent>(IsosurfaceMeshingEvent{.progress = int3{0}});
+    }));
+    run.generation_gpu_ms = std::min(run.generation_gpu_ms, generation_timer.resolve_ms());
+    run.meshing_gpu_ms = std::min(run.meshing_gpu_ms, meshing_timer.resolve_ms());
+
+    const VkDrawIndirectCommand *draws = terrain.get_indirect_cmds_host_address();
+    u64 vertices{0};
+    for(u32 i = 0; i < terrain.get_chunk_render_count(); i++) {
+      vertices += draws[i].vertexCount;
+    }
+    run.resident_chunks = terrain.get_resident_brick_count();
+    run.triangles = vertices / 3;
+    run.terrain_bytes = terrain.get_allocated_bytes();
+    run.peak_rss_delta_bytes = std::max(run.peak_rss_delta_bytes, rss.bytes());
+
+    if(terrain.get_chunk_stats() && repeat + 1 == args.repeats) {
+      const ChunkStatsReport report{terrain.get_chunk_stats(), config.chunks_per_axis};
+      report.export_vtk(
+        args.chunk_stats + "_" + std::to_string(config.chunks_per_axis.x) + "_" +
+        std::to_string(config.voxels_per_chunk.x) + "_" + std::to_string(config.seed) + ".vtk"
+      );
+      std::ostringstream json;
+      report.write_json(json);
+      run.chunk_stats_json = json.str();
+    }
+  }
+  return run;
+}
+
+std::string json_string(const std::string &value) {
+  std::string escaped{"\""};
+  for(const char c : value) {
+    if(c == '"' || c == '\\') escaped += '\\';
+    if(static_cast<unsigned char>(c) >= 0x20) escaped += c;
+  }
+  return escaped + "\"";
+}
+
+void write_run(std::ostream &out, const BenchRun &run) {
+  const GridConfig &config = run.config;
+  const f64 chunks = static_cast<f64>(config.chunks_per_axis.x)*config.chunks_per_axis.y*config.chunks_per_axis.z;
+  const f64 voxels = chunks*config.voxels_per_chunk.x*config.voxels_per_chunk.y*config.voxels_per_chunk.z;
+  const f64 total_s = (run.generation_ms + run.meshing_ms)*1e-3;
+
+  out << "{"
+      << "\"engine\":" << json_string(run.engine)
+      << ",\"device\":" << json_string(run.device)
+      << ",\"world_chunks\":" << config.chunks_per_axis.x
+      << ",\"chunk_voxels\":" << config.voxels_per_chunk.x
+      << ",\"seed\":" << config.seed
+      << ",\"workgroup_size\":" << run.workgroup_size
+      << ",\"threads\":" << run.threads
+      << ",\"chunks\":" << static_cast<u64>(chunks)
+      << ",\"voxels\":" << static_cast<u64>(voxels)
+      << ",\"resident_chunks\":" << run.resident_chunks
+      << ",\"triangles\":" << run.triangles
+      << ",\"generation_ms\":" << run.generation_ms
+      << ",\"meshing_ms\":" << run.meshing_ms
+      << ",\"total_ms\":" << run.generation_ms + run.meshing_ms;
+  if(run.generation_gpu_ms >= 0.0) {
+    out << ",\"generation_gpu_ms\":" << run.generation_gpu_ms
+        << ",\"meshing_gpu_ms\":" << run.meshing_gpu_ms;
+  }
+  if(!run.chunk_stats_json.empty()) {
+    out << ",\"chunk_stats\":" << run.chunk_stats_json;
+  }
+  out << ",\"chunks_per_s\":" << chunks / total_s
+      << ",\"voxels_per_s\":" << voxels / total_s
+      << ",\"triangles_per_s\":" << static_cast<f64>(run.triangles) / total_s
+      << ",\"terrain_bytes\":" << run.terrain_bytes
+      << ",\"peak_rss_delta_bytes\":" << run.peak_rss_delta_bytes
+      << "}";
+}
+
+}
+
+int main(int argc, char **argv) {
+  try {
+    const BenchArgs args = parse_args(argc, argv);
+    const bool cpu = args.engine != "gpu";
+    const bool gpu = args.engine != "cpu";
+
+    // The calling thread takes part in every parallel_for.
+    ThreadPool thread_pool{args.threads - 1};
+
+    std::unique_ptr<Context> vk_context;
+    std::unique_ptr<ResourceManager> resource_manager;
+    if(gpu) {
+      try {
+        vk_context = std::make_unique<Context>(TmxHeadlessInfo{
+          .extent = VkExtent2D{64, 64},
+          .validation = args.validation,
+          .device_name = args.device,
+        });
+        resource_manager = std::make_unique<ResourceManager>(vk_context.get());
+      }
+      catch(const std::runtime_error &error) {
+        if(args.engine == "gpu") throw;
+        std::cerr << "mc_bench: no usable Vulkan device, CPU engine only: " << error.what() << std::endl;
+      }
+    }
+
+    std::vector<BenchRun> runs;
+    for(const u32 world : args.world_chunks) {
+    for(const u32 side : args.chunk_voxels) {
+    for(const u32 seed : args.seeds) {
+      const GridConfig config{
+        .voxels_per_chunk = int3{static_cast<i32>(side)},
+        .chunks_per_axis = int3{static_cast<i32>(world)},
+        .workgroup_size = args.workgroup_size,
+        .seed = seed,
+      };
+      if(cpu) runs.push_back(run_cpu(args, config, &thread_pool));
+      if(vk_context) runs.push_back(run_gpu(args, config, vk_context.get(), resource_manager.get()));
+    }
+    }
+    }
+
+    std::ofstream file(args.output, std::ios::trunc);
+    if(!file.is_open()) {
+      throw std::runtime_error("Failed to open " + args.output + " for writing!");
+    }
+    file << "{\"benchmark\":\"mc_bench\",\"repeats\":" << args.repeats << ",\"runs\":[";
+    for(size_t i = 0; i < runs.size(); i++) {
+      file << (i == 0 ? "\n" : ",\n");
+      write_run(file, runs[i]);
+    }
+    file << "\n]}\n";
+
+    std::cout << runs.size() << " runs written to " << args.output << std::endl;
+  }
+  catch(const std::exception &error) {
+    std::cerr << "mc_bench: " << error.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
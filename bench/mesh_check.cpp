@@ -0,0 +1,352 @@
+// Golden mesh check of isosurface_meshing.comp. Meshes seeded worlds on a
+// Vulkan device (lavapipe is fine), reads the vertices back through the
+// indirect commands and compares every chunk's triangles with CpuMesher
+// and each world's hash with the stored golden one. Exits non-zero on any
+// difference, so kernel changes can be verified before they ship.
+//
+// usage: mesh_check [--world-chunks N] [--chunk-voxels N] [--seeds N,N,..]
+//                   [--tolerance F] [--device NAME] [--update-golden]
+//                   [--validation]
+//
+// Triangles are canonicalised: each starts at its smallest vertex, keeping
+// its winding, and a chunk's triangles are sorted, so the order in which
+// invocations emit them does not matter. The GPU and CPU noise differ in
+// rounding, so GPU and CPU triangles match in any rotation with vertices
+// within VERTEX_EPSILON, and up to --tolerance of them may differ where a
+// corner's density rounds to the other sign. Golden hashes are of the
+// GPU mesh with positions quantised to 1/HASH_SCALE voxels and are tied
+// to the device that stored them, the committed golden_meshes.txt is for
+// lavapipe. A world without a golden hash fails; --update-golden stores
+// or replaces them.
+
+#include "../src/cpu/core/event_bus.hpp"
+#include "../src/cpu/core/events.hpp"
+#include "../src/cpu/core/grid_config.hpp"
+#include "../src/cpu/core/paths.hpp"
+#include "../src/cpu/systems/cpu_mesher.hpp"
+#include "../src/cpu/systems/resource_manager.hpp"
+#include "../src/cpu/systems/terrain_system.hpp"
+#include "../src/cpu/vk/context.hpp"
+#include "bench_common.hpp"
+
+#include <algorithm>
+#include <any>
+#include <array>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace tmx;
+
+namespace {
+
+constexpr const char *GOLDEN_FILE = "golden_meshes.txt";
+
+constexpr f32 VERTEX_EPSILON = 1e-2f;
+constexpr f32 HASH_SCALE = 256.0f;
+
+using Triangle = std::array<float4, 3>;
+
+struct CheckArgs {
+  i32 world_chunks{4};
+  i32 chunk_voxels{16};
+  std::vector<u32> seeds{0, 1, 2, 3};
+  f64 tolerance{1e-3};
+  std::string device{};
+  bool update_golden{false};
+  bool validation{false};
+};
+
+// Copies every chunk's mesh out of the host views once meshing completes.
+struct MeshCapture {
+  std::vector<std::vector<float4>> chunks;
+
+  void capture(const std::any &e) {
+    const auto &event = std::any_cast<const IsosurfaceRemeshedEvent &>(e);
+    chunks.assign(COUNT_CHUNKS, {});
+    for(u32 i = 0; i < static_cast<u32>(COUNT_CHUNKS); i++) {
+      const uint2 info = event.chunk_draw_info[i];
+      if(info.x == 0 || info.y == 0) {
+        continue;
+      }
+      const VkDrawIndirectCommand &command = event.indirect[info.x - 1];
+      chunks[i].assign(event.vertices + command.firstVertex, event.vertices + command.firstVertex + command.vertexCount);
+    }
+  }
+};
+
+bool vertex_less(const float4 &a, const float4 &b) {
+  if(a.x != b.x) return a.x < b.x;
+  if(a.y != b.y) return a.y < b.y;
+  if(a.z != b.z) return a.z < b.z;
+  return a.w < b.w;
+}
+
+bool vertex_near(const float4 &a, const float4 &b) {
+  return std::abs(a.x - b.x) <= VERTEX_EPSILON && std::abs(a.y - b.y) <= VERTEX_EPSILON &&
+         std::abs(a.z - b.z) <= VERTEX_EPSILON && a.w == b.w;
+}
+
+// Rotates each triangle to start at its smallest vertex and sorts them.
+std::vector<Triangle> canonical_triangles(const std::vector<float4> &vertices) {
+  if(vertices.size() % 3 != 0) {
+    throw std::runtime_error("A chunk holds " + std::to_string(vertices.size()) + " vertices, not whole triangles!");
+  }
+
+  std::vector<Triangle> triangles(vertices.size() / 3);
+  for(size_t t = 0; t < triangles.size(); t++) {
+    size_t first{0};
+    for(size_t v = 1; v < 3; v++) {
+      if(vertex_less(vertices[3*t + v], vertices[3*t + first])) first = v;
+    }
+    for(size_t v = 0; v < 3; v++) {
+      triangles[t][v] = vertices[3*t + (first + v) % 3];
+    }
+  }
+
+  std::sort(triangles.begin(), triangles.end(), [](const Triangle &a, const Triangle &b) {
+    for(size_t v = 0; v < 3; v++) {
+      if(vertex_less(a[v], b[v])) return true;
+      if(vertex_less(b[v], a[v])) return false;
+    }
+    return false;
+  });
+  return triangles;
+}
+
+f32 centroid_x(const Triangle &t) {
+  return (t[0].x + t[1].x + t[2].x) / 3.0f;
+}
+
+// Any rotation, vertices equal within rounding can still order differently.
+bool triangle_near(const Triangle &a, const Triangle &b) {
+  for(size_t r = 0; r < 3; r++) {
+    if(vertex_near(a[0], b[r]) && vertex_near(a[1], b[(r + 1) % 3]) && vertex_near(a[2], b[(r + 2) % 3])) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Triangles of a without a counterpart in b, candidates are found
+// through their centroids, which rotations leave alone.
+u64 unmatched_triangles(const std::vector<Triangle> &a, std::vector<Triangle> b) {
+  std::sort(b.begin(), b.end(), [](const Triangle &l, const Triangle &r) { return centroid_x(l) < centroid_x(r); });
+
+  std::vector<bool> used(b.size(), false);
+  u64 unmatched{0};
+  for(const Triangle &triangle : a) {
+    const f32 x = centroid_x(triangle);
+    auto candidate = std::lower_bound(b.begin(), b.end(), x - VERTEX_EPSILON,
+      [](const Triangle &t, const f32 bound) { return centroid_x(t) < bound; });
+
+    bool found{false};
+    for(; candidate != b.end() && centroid_x(*candidate) <= x + VERTEX_EPSILON; ++candidate) {
+      const size_t index = static_cast<size_t>(candidate - b.begin());
+      if(!used[index] && triangle_near(triangle, *candidate)) {
+        used[index] = true;
+        found = true;
+        break;
+      }
+    }
+    unmatched += found ? 0 : 1;
+  }
+  return unmatched;
+}
+
+// FNV-1a over the quantised canonical triangles of every chunk in order.
+u64 mesh_hash(const std::vector<std::vector<Triangle>> &chunks) {
+  u64 hash{14695981039346656037ull};
+  const auto mix = [&hash](const i64 value) {
+    for(u32 byte = 0; byte < 8; byte++) {
+      hash ^= static_cast<u64>(value >> (8*byte)) & 0xFF;
+      hash *= 1099511628211ull;
+    }
+  };
+
+  for(const std::vector<Triangle> &triangles : chunks) {
+    mix(static_cast<i64>(triangles.size()));
+    for(const Triangle &triangle : triangles) {
+      for(const float4 &v : triangle) {
+        mix(std::llround(v.x*HASH_SCALE));
+        mix(std::llround(v.y*HASH_SCALE));
+        mix(std::llround(v.z*HASH_SCALE));
+        mix(std::llround(v.w*255.0f));
+      }
+    }
+  }
+  return hash;
+}
+
+// Lines of "seed chunk_voxels world_chunks hash", # starts a comment.
+std::string golden_key(const GridConfig &config) {
+  return std::to_string(config.seed) + " " +
+         std::to_string(config.voxels_per_chunk.x) + " " +
+         std::to_string(config.chunks_per_axis.x);
+}
+
+std::optional<u64> load_golden(const std::string &key) {
+  std::ifstream file(asset_path(GOLDEN_FILE));
+  std::string line;
+  while(std::getline(file, line)) {
+    if(line.rfind(key + " ", 0) == 0) {
+      return std::stoull(line.substr(key.size() + 1), nullptr, 16);
+    }
+  }
+  return std::nullopt;
+}
+
+void save_golden(const std::string &key, const u64 hash) {
+  std::vector<std::string> lines;
+  {
+    std::ifstream file(asset_path(GOLDEN_FILE));
+    std::string line;
+    while(std::getline(file, line)) {
+      if(line.rfind(key + " ", 0) != 0) {
+        lines.push_back(line);
+      }
+    }
+  }
+
+  const std::string path = asset_path(GOLDEN_FILE);
+  std::ofstream file(path, std::ios::trunc);
+  if(!file.is_open()) {
+    throw std::runtime_error("Failed to open " + path + " for writing!");
+  }
+  for(const std::string &line : lines) {
+    file << line << "\n";
+  }
+  std::ostringstream hex;
+  hex << std::hex << hash;
+  file << key << " " << hex.str() << "\n";
+}
+
+CheckArgs parse_args(const int argc, const char *const *argv) {
+  CheckArgs args{};
+  for(int i = 1; i < argc; i++) {
+    const std::string arg{argv[i]};
+    if(arg == "--update-golden") { args.update_golden = true; continue; }
+    if(arg == "--validation") { args.validation = true; continue; }
+    if(i + 1 >= argc) {
+      throw std::runtime_error("Missing value for " + arg + "!");
+    }
+
+    const std::string value{argv[++i]};
+    if(arg == "--world-chunks") args.world_chunks = static_cast<i32>(parse_list(arg, value).front());
+    else if(arg == "--chunk-voxels") args.chunk_voxels = static_cast<i32>(parse_list(arg, value).front());
+    else if(arg == "--seeds") args.seeds = parse_list(arg, value);
+    else if(arg == "--tolerance") args.tolerance = std::stod(value);
+    else if(arg == "--device") args.device = value;
+    else throw std::runtime_error("Unknown argument " + arg + "!");
+  }
+  return args;
+}
+
+// Meshes one world on both engines, returns whether it passed.
+bool check_world(const CheckArgs &args, const GridConfig &config, Context *vk_context, ResourceManager *resource_manager) {
+  config.apply(vk_context->get_limits(), vk_context->get_shader_subgroup_size());
+
+  MeshCapture capture{};
+  {
+    EventBus event_bus{};
+    event_bus.add<IsosurfaceRemeshedEvent>(&capture, &MeshCapture::capture);
+
+    // Only meshing is checked, the terrain needs no graphics pipeline.
+    TerrainManager terrain{vk_context, &event_bus, nullptr, resource_manager};
+    event_bus.notify<IsosurfaceGenerationEvent>(IsosurfaceGenerationEvent{.progress = int3{0}});
+    event_bus.notify<IsosurfaceMeshingEvent>(IsosurfaceMeshingEvent{.progress = int3{0}});
+  }
+  if(capture.chunks.size() != static_cast<size_t>(COUNT_CHUNKS)) {
+    throw std::runtime_error("Meshing never reported the remeshed world!");
+  }
+
+  CpuMesher mesher{};
+  mesher.generate();
+  mesher.mesh();
+
+  std::vector<std::vector<Triangle>> gpu_chunks(COUNT_CHUNKS);
+  u64 triangles{0}, gpu_unmatched{0}, cpu_unmatched{0};
+  u32 differing_chunks{0};
+  for(u32 i = 0; i < static_cast<u32>(COUNT_CHUNKS); i++) {
+    gpu_chunks[i] = canonical_triangles(capture.chunks[i]);
+    const std::vector<Triangle> cpu = canonical_triangles(mesher.chunk(idx2chunk(i)).vertices);
+
+    const u64 gpu_only = unmatched_triangles(gpu_chunks[i], cpu);
+    const u64 cpu_only = unmatched_triangles(cpu, gpu_chunks[i]);
+    triangles += gpu_chunks[i].size();
+    gpu_unmatched += gpu_only;
+    cpu_unmatched += cpu_only;
+    differing_chunks += gpu_only + cpu_only > 0 ? 1 : 0;
+  }
+
+  const f64 mismatch = static_cast<f64>(gpu_unmatched + cpu_unmatched) / static_cast<f64>(std::max<u64>(triangles, 1));
+  const bool reference_passed = mismatch <= args.tolerance;
+  std::cout << "CHECK seed " << config.seed << ": " << triangles << " triangles, "
+            << gpu_unmatched << " only on the GPU, " << cpu_unmatched << " only on the CPU, in "
+            << differing_chunks << " of " << COUNT_CHUNKS << " chunks"
+            << (reference_passed ? "" : ", exceeds the tolerance") << std::endl;
+
+  const std::string key = golden_key(config);
+  const u64 hash = mesh_hash(gpu_chunks);
+  if(args.update_golden) {
+    save_golden(key, hash);
+    std::cout << "CHECK seed " << config.seed << ": golden hash " << std::hex << hash << std::dec << " stored" << std::endl;
+    return reference_passed;
+  }
+
+  // A world without a stored hash fails, otherwise a lost or stale file
+  // would let every kernel change through.
+  const std::optional<u64> golden = load_golden(key);
+  if(!golden.has_value()) {
+    std::cout << "CHECK seed " << config.seed << ": no golden hash for \"" << key << "\" in "
+              << asset_path(GOLDEN_FILE) << ", store one with --update-golden" << std::endl;
+    return false;
+  }
+  const bool golden_passed = golden.value() == hash;
+  std::cout << "CHECK seed " << config.seed << ": hash " << std::hex << hash
+            << (golden_passed ? " matches the golden hash" : " differs from the golden hash ") << std::dec;
+  if(!golden_passed) {
+    std::cout << std::hex << golden.value() << std::dec;
+  }
+  std::cout << std::endl;
+  return reference_passed && golden_passed;
+}
+
+}
+
+int main(int argc, char **argv) {
+  try {
+    const CheckArgs args = parse_args(argc, argv);
+
+    Context vk_context{TmxHeadlessInfo{
+      .extent = VkExtent2D{64, 64},
+      .validation = args.validation,
+      .device_name = args.device,
+    }};
+    ResourceManager resource_manager{&vk_context};
+
+    u32 failed{0};
+    for(const u32 seed : args.seeds) {
+      const GridConfig config{
+        .voxels_per_chunk = int3{args.chunk_voxels},
+        .chunks_per_axis = int3{args.world_chunks},
+        .seed = seed,
+      };
+      failed += check_world(args, config, &vk_context, &resource_manager) ? 0 : 1;
+    }
+
+    std::cout << "CHECK " << args.seeds.size() - failed << " of " << args.seeds.size() << " worlds passed on "
+              << vk_context.get_device_name() << std::endl;
+    return failed == 0 ? 0 : 1;
+  }
+  catch(const std::exception &error) {
+    std::cerr << "mesh_check: " << error.what() << std::endl;
+    return 1;
+  }
+}
@@ -0,0 +1,379 @@
+// Micro-benchmarks of the terrain kernels on the host: OpenSimplexNoise
+// 2D/3D/4D, the CPU port of snoise and the density FBM, box and chunk
+// classification, marching cubes emission from the LUTs, the vertex count
+// scans of meshing and a model of the GPU page allocator. Meant for trying
+// SIMD and layout changes before they reach the full pipeline.
+//
+// usage: micro_bench [--repeats N] [--filter NAME] [--output PATH]
+//
+// Every kernel runs at three problem sizes, warm (after an untimed run)
+// and cold (after streaming a buffer larger than the caches), and reports
+// min/median/mean/stddev over the repeats as JSON.
+
+#include "../src/cpu/core/grid_config.hpp"
+#include "../src/cpu/noise/OpenSimplexNoise.h"
+#include "../src/cpu/noise/simplex.hpp"
+#include "../src/cpu/systems/cpu_mesher.hpp"
+#include "../src/cpu/systems/density_bounds.hpp"
+#include "bench_common.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace tmx;
+
+namespace {
+
+// Larger than the last level cache of current desktop parts.
+constexpr size_t EVICTION_BYTES = 64 << 20;
+
+// Results are summed into it so no kernel is optimised away.
+volatile f64 sink{0.0};
+
+struct Case {
+  std::string kernel;
+  u64 size;
+  bool cold;
+  u64 items;
+  std::vector<f64> samples_ms;
+};
+
+void evict_caches(void) {
+  static std::vector<u8> buffer(EVICTION_BYTES);
+  for(size_t i = 0; i < buffer.size(); i += 64) {
+    buffer[i]++;
+  }
+  sink = sink + buffer[buffer.size()/2];
+}
+
+// Host model of atomicMalloc() and atomicFree() in memory.glsl: a first
+// fit scan over one flag per page for a run of pages holding size vertices.
+struct AllocatorModel {
+  std::vector<u32> free;
+
+  u32 malloc(const u32 size) {
+    const u32 pages = (size + ALLOCATOR_PAGE_SIZE - 1)/ALLOCATOR_PAGE_SIZE;
+    u32 first{0};
+    u32 i{0};
+    while(i - first < pages) {
+      if(i == free.size()) {
+        throw std::runtime_error("AllocatorModel out of pages!");
+      }
+      if(free[i] != 0) { first = i + 1; }
+      i++;
+    }
+    std::fill_n(free.begin() + first, pages, 1u);
+    return first*ALLOCATOR_PAGE_SIZE;
+  }
+
+  void release(const u32 base, const u32 size) {
+    const u32 pages = (size + ALLOCATOR_PAGE_SIZE - 1)/ALLOCATOR_PAGE_SIZE;
+    std::fill_n(free.begin() + base/ALLOCATOR_PAGE_SIZE, pages, 0u);
+  }
+};
+
+// The CPU kernels need no device limits, only the grid's own checks.
+void apply_grid(const i32 chunk_side, const i32 world_chunks) {
+  VkPhysicalDeviceLimits limits{};
+  limits.maxComputeSharedMemorySize = UINT32_MAX;
+  limits.maxComputeWorkGroupInvocations = UINT32_MAX;
+  limits.maxComputeWorkGroupSize[0] = UINT32_MAX;
+  limits.maxDrawIndirectCount = UINT32_MAX;
+
+  const GridConfig config{
+    .voxels_per_chunk = int3{chunk_side},
+    .chunks_per_axis = int3{world_chunks},
+  };
+  config.apply(limits, SUBGROUP_SIZE);
+}
+
+struct MicroBench {
+  u32 repeats{15};
+  std::string filter{};
+  std::vector<Case> cases;
+
+  [[nodiscard]]
+  bool selected(const std::string &kernel) const {
+    return kernel.find(filter) != std::string::npos;
+  }
+
+  // Times fn warm and cold, items is the work per call.
+  template<typename Fn>
+  void measure(const std::string &kernel, const u64 size, const u64 items, Fn &&fn) {
+    for(const bool cold : {false, true}) {
+      Case result{.kernel = kernel, .size = size, .cold = cold, .items = items, .samples_ms = {}};
+      if(!cold) {
+        fn();
+      }
+      for(u32 repeat = 0; repeat < repeats; repeat++) {
+        if(cold) {
+          evict_caches();
+        }
+        result.samples_ms.push_back(time_ms(fn));
+      }
+
+      std::sort(result.samples_ms.begin(), result.samples_ms.end());
+      std::cout << kernel << " size " << size << (cold ? " cold: " : " warm: ")
+                << result.samples_ms[result.samples_ms.size()/2] << " ms median" << std::endl;
+      cases.push_back(std::move(result));
+    }
+  }
+};
+
+std::vector<float3> random_points(const u64 count, const f32 extent) {
+  std::mt19937 rng{1337};
+  std::uniform_real_distribution<f32> coord{0.0f, extent};
+  std::vector<float3> points(count);
+  for(float3 &p : points) {
+    p = float3{coord(rng), coord(rng), coord(rng)};
+  }
+  return points;
+}
+
+void bench_opensimplex(MicroBench &bench) {
+  const OpenSimplexNoise::Noise noise{1337};
+  for(const u64 count : {u64{1} << 12, u64{1} << 16, u64{1} << 20}) {
+    const std::vector<float3> points = random_points(count, 64.0f);
+
+    if(bench.selected("opensimplex_2d")) {
+      bench.measure("opensimplex_2d", count, count, [&]() {
+        f64 sum{0.0};
+        for(const float3 &p : points) sum += noise.eval(p.x, p.y);
+        sink = sink + sum;
+      });
+    }
+    if(bench.selected("opensimplex_3d")) {
+      bench.measure("opensimplex_3d", count, count, [&]() {
+        f64 sum{0.0};
+        for(const float3 &p : points) sum += noise.eval(p.x, p.y, p.z);
+        sink = sink + sum;
+      });
+    }
+    if(bench.selected("opensimplex_4d")) {
+      bench.measure("opensimplex_4d", count, count, [&]() {
+        f64 sum{0.0};
+        for(const float3 &p : points) sum += noise.eval(p.x, p.y, p.z, p.x + p.y);
+        sink = sink + sum;
+      });
+    }
+  }
+}
+
+void bench_snoise(MicroBench &bench) {
+  for(const u64 count : {u64{1} << 12, u64{1} << 16, u64{1} << 20}) {
+    const std::vector<float3> points = random_points(count, 1024.0f);
+
+    if(bench.selected("snoise")) {
+      bench.measure("snoise", count, count, [&]() {
+        f64 sum{0.0};
+        for(const float3 &p : points) sum += simplex::snoise(p * static_cast<f32>(DENSITY_FREQUENCY));
+        sink = sink + sum;
+      });
+    }
+    if(bench.selected("fbm")) {
+      bench.measure("fbm", count, count, [&]() {
+        f64 sum{0.0};
+        for(const float3 &p : points) sum += DensityBounds::fbm(p);
+        sink = sink + sum;
+      });
+    }
+  }
+}
+
+// Box classification as generation runs it, and whole chunks before any
+// brick is allocated. Sizes are the world's side in voxels.
+void bench_classification(MicroBench &bench) {
+  for(const i32 world_chunks : {2, 4, 8}) {
+    apply_grid(16, world_chunks);
+    const i32 side = world_chunks*COUNT_VOXELS_X;
+    const u64 boxes = u64(side/CpuMesher::BOX_VOXELS)*(side/CpuMesher::BOX_VOXELS)*(side/CpuMesher::BOX_VOXELS);
+
+    if(bench.selected("classify_box")) {
+      bench.measure("classify_box", static_cast<u64>(side), boxes, [&]() {
+        i64 sum{0};
+        for(i32 z = 0; z < side; z += CpuMesher::BOX_VOXELS) {
+        for(i32 y = 0; y < side; y += CpuMesher::BOX_VOXELS) {
+        for(i32 x = 0; x < side; x += CpuMesher::BOX_VOXELS) {
+          sum += DensityBounds::classify_bound(int3{x, y, z}, int3{x, y, z} + CpuMesher::BOX_VOXELS - 1);
+        }
+        }
+        }
+        sink = sink + static_cast<f64>(sum);
+      });
+    }
+    if(bench.selected("classify_chunk")) {
+      bench.measure("classify_chunk", static_cast<u64>(side), static_cast<u64>(COUNT_CHUNKS), [&]() {
+        i64 sum{0};
+        for(u32 i = 0; i < static_cast<u32>(COUNT_CHUNKS); i++) {
+          sum += DensityBounds::classify_chunk(idx2chunk(i));
+        }
+        sink = sink + static_cast<f64>(sum);
+      });
+    }
+  }
+}
+
+// Marching cubes over a generated world, per cell: corner loads, the case
+// and the vertices from the LUTs. Sizes are the world's side in voxels.
+void bench_emission(MicroBench &bench) {
+  if(!bench.selected("lut_emission")) {
+    return;
+  }
+  for(const i32 world_chunks : {2, 4, 8}) {
+    apply_grid(16, world_chunks);
+    CpuMesher mesher{};
+    mesher.generate();
+
+    const u64 cells = u64(COUNT_CHUNKS)*COUNT_VOXELS;
+    bench.measure("lut_emission", static_cast<u64>(world_chunks*COUNT_VOXELS_X), cells, [&]() {
+      mesher.mesh();
+      sink = sink + static_cast<f64>(mesher.vertex_count());
+    });
+  }
+}
+
+// Exclusive scans of per-cell vertex counts, sizes are the cells of a
+// chunk. The subgroup variant is the two level scan meshing runs: within
+// each SUBGROUP_SIZE block, then over the block totals.
+void bench_prefix_sums(MicroBench &bench) {
+  for(const u64 cells : {u64{8*8*8}, u64{16*16*16}, u64{32*32*32}}) {
+    std::mt19937 rng{1337};
+    std::uniform_int_distribution<u32> vertices{0, 15};
+    std::bernoulli_distribution surface{0.1};
+    std::vector<u32> counts(cells);
+    for(u32 &count : counts) {
+      count = surface(rng) ? vertices(rng) : 0;
+    }
+    std::vector<u32> offsets(cells);
+
+    if(bench.selected("prefix_sum_sequential")) {
+      bench.measure("prefix_sum_sequential", cells, cells, [&]() {
+        std::exclusive_scan(counts.begin(), counts.end(), offsets.begin(), 0u);
+        sink = sink + offsets.back();
+      });
+    }
+    if(bench.selected("prefix_sum_subgroup")) {
+      const u64 block = SUBGROUP_SIZE;
+      std::vector<u32> block_totals((cells + block - 1) / block);
+      bench.measure("prefix_sum_subgroup", cells, cells, [&]() {
+        for(u64 b = 0; b < block_totals.size(); b++) {
+          u32 sum{0};
+          for(u64 i = b*block; i < std::min((b + 1)*block, cells); i++) {
+            offsets[i] = sum;
+            sum += counts[i];
+          }
+          block_totals[b] = sum;
+        }
+        std::exclusive_scan(block_totals.begin(), block_totals.end(), block_totals.begin(), 0u);
+        for(u64 i = 0; i < cells; i++) {
+          offsets[i] += block_totals[i / block];
+        }
+        sink = sink + offsets.back();
+      });
+    }
+  }
+}
+
+// Remeshing churn at half occupancy: every operation frees a random live
+// page and allocates another. Sizes are the allocator's pages.
+void bench_allocator(MicroBench &bench) {
+  if(!bench.selected("allocator")) {
+    return;
+  }
+  for(const u32 pages : {1u << 10, 1u << 14, 1u << 18}) {
+    AllocatorModel allocator{.free = std::vector<u32>(pages, 0)};
+    std::vector<u32> live;
+    for(u32 i = 0; i < pages/2; i++) {
+      live.push_back(allocator.malloc(ALLOCATOR_PAGE_SIZE));
+    }
+
+    std::mt19937 rng{1337};
+    std::uniform_int_distribution<u32> pick{0, pages/2 - 1};
+    std::vector<u32> victims(std::min(pages, 1u << 12));
+    for(u32 &victim : victims) {
+      victim = pick(rng);
+    }
+
+    bench.measure("allocator", pages, victims.size(), [&]() {
+      u64 sum{0};
+      for(const u32 victim : victims) {
+        allocator.release(live[victim], ALLOCATOR_PAGE_SIZE);
+        live[victim] = allocator.malloc(ALLOCATOR_PAGE_SIZE);
+        sum += live[victim];
+      }
+      sink = sink + static_cast<f64>(sum);
+    });
+  }
+}
+
+void write_json(const std::string &path, const MicroBench &bench) {
+  std::ofstream file(path, std::ios::trunc);
+  if(!file.is_open()) {
+    throw std::runtime_error("Failed to open " + path + " for writing!");
+  }
+
+  file << "{\"benchmark\":\"micro_bench\",\"repeats\":" << bench.repeats << ",\"results\":[";
+  for(size_t i = 0; i < bench.cases.size(); i++) {
+    const Case &c = bench.cases[i];
+    const std::vector<f64> &samples = c.samples_ms;
+    const f64 mean = std::accumulate(samples.begin(), samples.end(), 0.0) / static_cast<f64>(samples.size());
+    f64 variance{0.0};
+    for(const f64 sample : samples) {
+      variance += (sample - mean)*(sample - mean);
+    }
+    variance /= static_cast<f64>(std::max<size_t>(samples.size() - 1, 1));
+    const f64 median = samples[samples.size()/2];
+
+    file << (i == 0 ? "\n" : ",\n")
+         << "{\"kernel\":\"" << c.kernel << "\""
+         << ",\"size\":" << c.size
+         << ",\"cache\":\"" << (c.cold ? "cold" : "warm") << "\""
+         << ",\"items\":" << c.items
+         << ",\"min_ms\":" << samples.front()
+         << ",\"median_ms\":" << median
+         << ",\"mean_ms\":" << mean
+         << ",\"stddev_ms\":" << std::sqrt(variance)
+         << ",\"ns_per_item\":" << median*1e6 / static_cast<f64>(c.items)
+         << "}";
+  }
+  file << "\n]}\n";
+}
+
+}
+
+int main(int argc, char **argv) {
+  try {
+    MicroBench bench{};
+    std::string output{"micro_bench.json"};
+    for(int i = 1; i + 1 < argc; i += 2) {
+      const std::string arg{argv[i]};
+      if(arg == "--repeats") bench.repeats = std::max(std::atoi(argv[i + 1]), 1);
+      else if(arg == "--filter") bench.filter = argv[i + 1];
+      else if(arg == "--output") output = argv[i + 1];
+      else throw std::runtime_error("Unknown argument " + arg + "!");
+    }
+
+    bench_opensimplex(bench);
+    bench_snoise(bench);
+    bench_classification(bench);
+    bench_emission(bench);
+    bench_prefix_sums(bench);
+    bench_allocator(bench);
+
+    write_json(output, bench);
+    std::cout << bench.cases.size() << " cases written to " << output << std::endl;
+  }
+  catch(const std::exception &error) {
+    std::cerr << "micro_bench: " << error.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,491 @@
+// Scaling study: generates, meshes and renders headless worlds of growing
+// size at several view distances, writes one CSV row per point and fits
+// power laws to generation, meshing, memory and frame time against the
+// chunk count, flagging whatever grows faster than the world.
+//
+// usage: scaling_bench [--world-chunks N,N,..] [--view-distances N,N,..]
+//                      [--chunk-voxels N] [--seed N] [--repeats N]
+//                      [--frames N] [--device NAME] [--output PATH]
+//                      [--summary PATH] [--validation]
+//
+// Worlds are cubes of the listed sides. Sides whose chunk count exceeds
+// what GridConfig accepts, or whose terrain does not fit on the device or
+// in the vertex buffer, get a row with their status and are left out of
+// the fits. The default sweep stops at 32, the surface of larger worlds
+// outgrows the vertex buffer's pages.
+//
+// There is no culling, every chunk is drawn every frame. A view distance
+// of N chunks moves the camera's far plane there so the clipped fragments
+// are saved, 0 keeps the whole world in view. The camera sits in the
+// middle of the world looking along +z.
+
+#include "../src/cpu/core/event_bus.hpp"
+#include "../src/cpu/core/events.hpp"
+#include "../src/cpu/core/grid_config.hpp"
+#include "../src/cpu/camera.hpp"
+#include "../src/cpu/pipelines/graphics/graphics_pipeline.hpp"
+#include "../src/cpu/systems/resource_manager.hpp"
+#include "../src/cpu/systems/terrain_system.hpp"
+#include "../src/cpu/vk/context.hpp"
+#include "../src/cpu/vk/timestamp_timer.hpp"
+#include "bench_common.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace tmx;
+
+namespace {
+
+// Fitted exponents above this are reported as super-linear, e.g. meshing
+// once the free[] scan of atomicMalloc has to skip most of the vertex pages.
+constexpr f64 SUPERLINEAR_EXPONENT = 1.15;
+
+// Frames rendered before timing, the profiler reads a slot back
+// GPU_PROFILER_FRAMES frames after recording it.
+constexpr u32 WARMUP_FRAMES = 2*GPU_PROFILER_FRAMES;
+
+constexpr VkExtent2D RENDER_EXTENT{1280, 720};
+
+struct ScalingArgs {
+  std::vector<u32> world_chunks{4, 8, 16, 32};
+  std::vector<u32> view_distances{2, 4, 8, 0};
+  u32 chunk_voxels{8};
+  u32 seed{0};
+  u32 repeats{1};
+  u32 frames{64};
+  std::string device{};
+  std::string output{"scaling_bench.csv"};
+  std::string summary{"scaling_bench.txt"};
+  bool validation{false};
+};
+
+// One world size at one view distance, timings in milliseconds. The
+// generation and meshing columns repeat for every view distance.
+struct ScalingPoint {
+  u32 world_chunks{0};
+  u32 view_distance{0};
+  std::string status{"ok"};
+  f64 generation_ms{std::numeric_limits<f64>::max()};
+  f64 meshing_ms{std::numeric_limits<f64>::max()};
+  f64 generation_gpu_ms{std::numeric_limits<f64>::max()};
+  f64 meshing_gpu_ms{std::numeric_limits<f64>::max()};
+  u32 resident_bricks{0};
+  u64 triangles{0};
+  u64 terrain_bytes{0};
+  u64 peak_rss_delta_bytes{0};
+  // Medians over the timed frames.
+  f64 frame_cpu_ms{0.0};
+  f64 frame_gpu_ms{0.0};
+
+  [[nodiscard]] inline
+  bool ok(void) const { return status == "ok"; }
+
+  [[nodiscard]] inline
+  f64 chunks(void) const { return static_cast<f64>(world_chunks)*world_chunks*world_chunks; }
+};
+
+ScalingArgs parse_args(const int argc, const char *const *argv) {
+  ScalingArgs args{};
+  for(int i = 1; i < argc; i++) {
+    const std::string arg{argv[i]};
+    if(arg == "--validation") {
+      args.validation = true;
+      continue;
+    }
+    if(i + 1 >= argc) {
+      throw std::runtime_error("Missing value for " + arg + "!");
+    }
+
+    const std::string value{argv[++i]};
+    if(arg == "--world-chunks") args.world_chunks = parse_list(arg, value);
+    else if(arg == "--view-distances") args.view_distances = parse_list(arg, value);
+    else if(arg == "--chunk-voxels") args.chunk_voxels = parse_list(arg, value).front();
+    else if(arg == "--seed") args.seed = parse_list(arg, value).front();
+    else if(arg == "--repeats") args.repeats = std::max(parse_list(arg, value).front(), 1u);
+    else if(arg == "--frames") args.frames = std::max(parse_list(arg, value).front(), 1u);
+    else if(arg == "--device") args.device = value;
+    else if(arg == "--output") args.output = value;
+    else if(arg == "--summary") args.summary = value;
+    else throw std::runtime_error("Unknown argument " + arg + "!");
+  }
+
+  std::sort(args.world_chunks.begin(), args.world_chunks.end());
+  return args;
+}
+
+f64 median(std::vector<f64> values) {
+  if(values.empty()) {
+    return 0.0;
+  }
+  std::sort(values.begin(), values.end());
+  return values[values.size()/2];
+}
+
+// Draws the world like Application does and returns the median host and
+// rasterization times of the frames after the warmup.
+void render_frames(
+  const ScalingArgs &args,
+  Context *vk_context,
+  GraphicsPipeline *pipeline,
+  ResourceManager *resource_manager,
+  EventBus *event_bus,
+  TerrainManager &terrain,
+  ScalingPoint &point
+) {
+  const float3 world_size{
+    static_cast<f32>(COUNT_CHUNKS_X*COUNT_VOXELS_X),
+    static_cast<f32>(COUNT_CHUNKS_Y*COUNT_VOXELS_Y),
+    static_cast<f32>(COUNT_CHUNKS_Z*COUNT_VOXELS_Z),
+  };
+  const f32 far = point.view_distance == 0 ?
+    glm::length(world_size) :
+    static_cast<f32>(point.view_distance*COUNT_VOXELS_Z);
+
+  f64 dt{0.0};
+  Camera camera{
+    TransformComponent{world_size*0.5f, float3{0.0}, float3{1.0}},
+    0.01, far, nullptr, nullptr, event_bus, resource_manager, &dt
+  };
+  const float2 dim{static_cast<f32>(RENDER_EXTENT.width), static_cast<f32>(RENDER_EXTENT.height)};
+
+  GpuProfiler &profiler = vk_context->get_profiler();
+  VK_CHECK(vkDeviceWaitIdle(vk_context->get_device()));
+  profiler.flush();
+
+  std::vector<f64> cpu_ms;
+  size_t first_sample{0};
+  for(u32 i = 0; i < WARMUP_FRAMES + args.frames; i++) {
+    if(i == WARMUP_FRAMES) {
+      VK_CHECK(vkDeviceWaitIdle(vk_context->get_device()));
+      profiler.flush();
+      first_sample = profiler.get_history().size();
+    }
+
+    const f64 ms = time_ms([&]() {
+      VkCommandBuffer command_buffer = vk_context->rendering_begin_command_buffers();
+      const u32 raster_scope = profiler.cmd_begin(command_buffer, GPU_PASS_RASTERIZATION);
+      vk_context->cmd_begin_rendering(command_buffer);
+      const u32 frame = vk_context->get_current_frame();
+
+      camera.update_self_data(frame, 1.35, dim.x / dim.y, dim);
+
+      vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline->get_pipeline());
+
+      GraphicsPush push {
+        .pVertices = SHADER_CAST(terrain.get_terrain_vertex_buffer_address()),
+        .pMatrices = SHADER_CAST(camera.matrices_device_address(frame)),
+      };
+
+      vkCmdPushConstants(
+        command_buffer,
+        pipeline->get_pipeline_layout(),
+        VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+        0,
+        pipeline->get_push_constant_size(),
+        &push
+      );
+
+      vkCmdDrawIndirect(
+        command_buffer,
+        terrain.get_indirect_cmds_buffer(),
+        0,
+        terrain.get_chunk_render_count(),
+        sizeof(VkDrawIndirectCommand)
+      );
+
+      vk_context->cmd_end_rendering(command_buffer);
+      profiler.cmd_end(command_buffer, raster_scope);
+      vk_context->end_command_buffer(command_buffer);
+      vk_context->queue_submit_and_present(command_buffer);
+    });
+    if(i >= WARMUP_FRAMES) {
+      cpu_ms.push_back(ms);
+    }
+  }
+
+  VK_CHECK(vkDeviceWaitIdle(vk_context->get_device()));
+  profiler.flush();
+
+  std::vector<f64> gpu_ms;
+  const std::vector<GpuPassSample> &history = profiler.get_history();
+  for(size_t i = first_sample; i < history.size(); i++) {
+    if(history[i].pass == GPU_PASS_RASTERIZATION) {
+      gpu_ms.push_back(history[i].ms);
+    }
+  }
+
+  point.frame_cpu_ms = median(cpu_ms);
+  point.frame_gpu_ms = median(gpu_ms);
+}
+
+// Every view distance of one world size, the world is built once per repeat
+// and rendered after the last.
+std::vector<ScalingPoint> run_world(
+  const ScalingArgs &args,
+  const u32 world_chunks,
+  Context *vk_context,
+  GraphicsPipeline *pipeline,
+  ResourceManager *resource_manager
+) {
+  ScalingPoint world{.world_chunks = world_chunks};
+  std::vector<ScalingPoint> points;
+  const auto fail = [&](const std::string &status) {
+    world.status = status;
+    points.assign(1, world);
+    std::cerr << "scaling_bench: " << world_chunks << "^3 chunks " << status << std::endl;
+    return points;
+  };
+
+  const GridConfig config{
+    .voxels_per_chunk = int3{static_cast<i32>(args.chunk_voxels)},
+    .chunks_per_axis = int3{static_cast<i32>(world_chunks)},
+    .seed = args.seed,
+  };
+  try {
+    config.apply(vk_context->get_limits(), vk_context->get_shader_subgroup_size());
+  }
+  catch(const std::runtime_error &error) {
+    return fail(std::string{"skipped: "} + error.what());
+  }
+
+  try {
+    const RssProbe rss{};
+    for(u32 repeat = 0; repeat < args.repeats; repeat++) {
+      EventBus event_bus{};
+
+      TimestampTimer generation_timer{vk_context, 1};
+      TimestampTimer meshing_timer{vk_context, static_cast<u32>(COUNT_CHUNKS_Y*COUNT_CHUNKS_Z)};
+
+      TerrainManager terrain{vk_context, &event_bus, pipeline, resource_manager};
+      terrain.set_timers(&generation_timer, &meshing_timer);
+
+      world.generation_ms = std::min(world.generation_ms, time_ms([&]() {
+        event_bus.notify<IsosurfaceGenerationEvent>(IsosurfaceGenerationEvent{.progress = int3{0}});
+      }));
+      world.meshing_ms = std::min(world.meshing_ms, time_ms([&]() {
+        event_bus.notify<IsosurfaceMeshingEvent>(IsosurfaceMeshingEvent{.progress = int3{0}});
+      }));
+      world.generation_gpu_ms = std::min(world.generation_gpu_ms, generation_timer.resolve_ms());
+      world.meshing_gpu_ms = std::min(world.meshing_gpu_ms, meshing_timer.resolve_ms());
+
+      const VkDrawIndirectCommand *draws = terrain.get_indirect_cmds_host_address();
+      u64 vertices{0};
+      for(u32 i = 0; i < terrain.get_chunk_render_count(); i++) {
+        vertices += draws[i].vertexCount;
+      }
+      world.resident_bricks = terrain.get_resident_brick_count();
+      world.triangles = vertices / 3;
+      world.terrain_bytes = u64{world.resident_bricks}*COUNT_VOXELS*sizeof(DensityCode) + vertices*sizeof(float4);
+      world.peak_rss_delta_bytes = std::max(world.peak_rss_delta_bytes, rss.bytes());
+
+      if(repeat + 1 < args.repeats) {
+        continue;
+      }
+      for(const u32 view_distance : args.view_distances) {
+        ScalingPoint point = world;
+        point.view_distance = view_distance;
+        render_frames(args, vk_context, pipeline, resource_manager, &event_bus, terrain, point);
+        points.push_back(point);
+      }
+    }
+  }
+  catch(const std::runtime_error &error) {
+    vkDeviceWaitIdle(vk_context->get_device());
+    return fail(std::string{"failed: "} + error.what());
+  }
+  return points;
+}
+
+// Least squares fit of log(value) = log(a) + exponent*log(chunks) over the
+// successful points, with the steepest exponent between neighbours since a
+// curve can be linear overall and still bend upwards at the largest worlds.
+struct PowerFit {
+  u32 samples{0};
+  f64 exponent{0.0};
+  f64 r2{0.0};
+  f64 max_local_exponent{0.0};
+  u32 max_local_world{0};
+
+  [[nodiscard]] inline
+  bool superlinear(void) const {
+    return samples >= 2 && (exponent > SUPERLINEAR_EXPONENT || max_local_exponent > SUPERLINEAR_EXPONENT);
+  }
+};
+
+template<typename Metric>
+PowerFit fit(const std::vector<ScalingPoint> &points, const u32 view_distance, Metric &&metric) {
+  std::vector<f64> xs, ys;
+  std::vector<u32> worlds;
+  for(const ScalingPoint &point : points) {
+    const f64 value = metric(point);
+    if(!point.ok() || point.view_distance != view_distance || value <= 0.0) {
+      continue;
+    }
+    xs.push_back(std::log(point.chunks()));
+    ys.push_back(std::log(value));
+    worlds.push_back(point.world_chunks);
+  }
+
+  PowerFit result{.samples = static_cast<u32>(xs.size())};
+  if(xs.size() < 2) {
+    return result;
+  }
+
+  const f64 n = static_cast<f64>(xs.size());
+  f64 mean_x{0.0}, mean_y{0.0};
+  for(size_t i = 0; i < xs.size(); i++) {
+    mean_x += xs[i] / n;
+    mean_y += ys[i] / n;
+  }
+  f64 sxx{0.0}, sxy{0.0}, syy{0.0};
+  for(size_t i = 0; i < xs.size(); i++) {
+    sxx += (xs[i] - mean_x)*(xs[i] - mean_x);
+    sxy += (xs[i] - mean_x)*(ys[i] - mean_y);
+    syy += (ys[i] - mean_y)*(ys[i] - mean_y);
+  }
+  if(sxx <= 0.0) {
+    return result;
+  }
+  result.exponent = sxy / sxx;
+  result.r2 = syy > 0.0 ? (sxy*sxy) / (sxx*syy) : 1.0;
+
+  result.max_local_exponent = -std::numeric_limits<f64>::max();
+  for(size_t i = 1; i < xs.size(); i++) {
+    const f64 local = (ys[i] - ys[i - 1]) / (xs[i] - xs[i - 1]);
+    if(local > result.max_local_exponent) {
+      result.max_local_exponent = local;
+      result.max_local_world = worlds[i];
+    }
+  }
+  return result;
+}
+
+void write_csv(const std::string &path, const ScalingArgs &args, const std::vector<ScalingPoint> &points) {
+  std::ofstream file(path, std::ios::trunc);
+  if(!file.is_open()) {
+    throw std::runtime_error("Failed to open " + path + " for writing!");
+  }
+
+  file << "world_chunks,chunks,chunk_voxels,view_distance,status,generation_ms,meshing_ms,"
+          "generation_gpu_ms,meshing_gpu_ms,resident_bricks,triangles,terrain_bytes,peak_rss_delta_bytes,"
+          "frame_cpu_ms,frame_gpu_ms\n";
+  for(const ScalingPoint &point : points) {
+    file << point.world_chunks << "," << static_cast<u64>(point.chunks()) << "," << args.chunk_voxels << ","
+         << point.view_distance << ",\"" << point.status << "\"";
+    if(point.ok()) {
+      file << "," << point.generation_ms << "," << point.meshing_ms << ","
+           << point.generation_gpu_ms << "," << point.meshing_gpu_ms << ","
+           << point.resident_bricks << "," << point.triangles << "," << point.terrain_bytes << ","
+           << point.peak_rss_delta_bytes << "," << point.frame_cpu_ms << "," << point.frame_gpu_ms;
+    }
+    else {
+      file << ",,,,,,,,,,";
+    }
+    file << "\n";
+  }
+  std::cout << points.size() << " points written to " << path << std::endl;
+}
+
+// Exponent 1 is linear in the chunk count, a fixed cost per chunk.
+void write_summary(const std::string &path, const ScalingArgs &args, const std::vector<ScalingPoint> &points) {
+  std::ostringstream summary;
+  summary << "scaling_bench, " << args.chunk_voxels << "^3 voxels per chunk, seed " << args.seed
+          << ", super-linear above exponent " << SUPERLINEAR_EXPONENT << "\n\n";
+
+  u32 flagged{0};
+  const auto report = [&](const std::string &name, const u32 view_distance, auto &&metric) {
+    const PowerFit result = fit(points, view_distance, metric);
+    summary << name;
+    if(result.samples < 2) {
+      summary << ": too few points\n";
+      return;
+    }
+    summary << ": exponent " << result.exponent << " (r2 " << result.r2 << ", " << result.samples << " points)"
+            << ", steepest " << result.max_local_exponent << " up to " << result.max_local_world << "^3";
+    if(result.superlinear()) {
+      summary << "  SUPER-LINEAR";
+      flagged++;
+    }
+    summary << "\n";
+  };
+
+  // World metrics repeat for every view distance, the first one is enough.
+  const u32 first_view = args.view_distances.front();
+  report("generation_ms", first_view, [](const ScalingPoint &p) { return p.generation_ms; });
+  report("meshing_ms", first_view, [](const ScalingPoint &p) { return p.meshing_ms; });
+  report("generation_gpu_ms", first_view, [](const ScalingPoint &p) { return p.generation_gpu_ms; });
+  report("meshing_gpu_ms", first_view, [](const ScalingPoint &p) { return p.meshing_gpu_ms; });
+  report("resident_bricks", first_view, [](const ScalingPoint &p) { return static_cast<f64>(p.resident_bricks); });
+  report("triangles", first_view, [](const ScalingPoint &p) { return static_cast<f64>(p.triangles); });
+  report("terrain_bytes", first_view, [](const ScalingPoint &p) { return static_cast<f64>(p.terrain_bytes); });
+  for(const u32 view_distance : args.view_distances) {
+    const std::string suffix = view_distance == 0 ? " (whole world)" : " (view " + std::to_string(view_distance) + " chunks)";
+    report("frame_cpu_ms" + suffix, view_distance, [](const ScalingPoint &p) { return p.frame_cpu_ms; });
+    report("frame_gpu_ms" + suffix, view_distance, [](const ScalingPoint &p) { return p.frame_gpu_ms; });
+  }
+
+  for(const ScalingPoint &point : points) {
+    if(!point.ok()) {
+      summary << "\n" << point.world_chunks << "^3 chunks " << point.status;
+    }
+  }
+  summary << "\n" << flagged << " super-linear metrics\n";
+
+  std::ofstream file(path, std::ios::trunc);
+  if(!file.is_open()) {
+    throw std::runtime_error("Failed to open " + path + " for writing!");
+  }
+  file << summary.str();
+  std::cout << summary.str();
+}
+
+}
+
+int main(int argc, char **argv) {
+  try {
+    const ScalingArgs args = parse_args(argc, argv);
+
+    Context vk_context{TmxHeadlessInfo{
+      .extent = RENDER_EXTENT,
+      .validation = args.validation,
+      .device_name = args.device,
+    }};
+    ResourceManager resource_manager{&vk_context};
+
+    GraphicsPipeline pipeline {
+      {
+        "voxel",
+        sizeof(GraphicsPush),
+        vk_context.get_device(),
+        vk_context.get_swapchain_image_format(),
+        vk_context.get_depth_format(),
+        VK_FALSE,
+        vk_context.get_pipeline_cache(),
+      }
+    };
+
+    std::vector<ScalingPoint> points;
+    for(const u32 world_chunks : args.world_chunks) {
+      std::cout << "WORLD " << world_chunks << "^3 chunks" << std::endl;
+      const std::vector<ScalingPoint> world = run_world(args, world_chunks, &vk_context, &pipeline, &resource_manager);
+      points.insert(points.end(), world.begin(), world.end());
+    }
+
+    write_csv(args.output, args, points);
+    write_summary(args.summary, args, points);
+  }
+  catch(const std::exception &error) {
+    std::cerr << "scaling_bench: " << error.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,25 @@
+# Script mode, turns a SPIR-V module into a header of its words:
+#   cmake -DINPUT=x.spv -DOUTPUT=x.spv.inl -DSYMBOL=SPIRV_x -P embed_spirv.cmake
+# glslc writes little endian words, they are swapped into u32 literals here
+# so the array has the alignment vkCreateShaderModule needs.
+
+file(READ "${INPUT}" spirv HEX)
+string(LENGTH "${spirv}" length)
+math(EXPR remainder "${length} % 8")
+if(length EQUAL 0 OR NOT remainder EQUAL 0)
+  message(FATAL_ERROR "${INPUT} is not a SPIR-V module")
+endif()
+
+string(REGEX REPLACE "(..)(..)(..)(..)" "0x\\4\\3\\2\\1," words "${spirv}")
+# Eight words per line keeps the diff of a rebuilt header readable.
+string(REPEAT "0x........," 8 line)
+string(REGEX REPLACE "(${line})" "\\1\n  " words "${words}")
+
+file(WRITE "${OUTPUT}"
+  "// Generated from ${INPUT} by embed_spirv.cmake, do not edit.\n"
+  "namespace tmx {\n"
+  "inline constexpr u32 ${SYMBOL}[] = {\n"
+  "  ${words}\n"
+  "};\n"
+  "}\n"
+)
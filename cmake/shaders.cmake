@@ -0,0 +1,70 @@
+# Compiles the shaders with glslc at build time and embeds the SPIR-V in the
+# executables, see embedded_spirv.hpp.in. Pipelines are created from memory,
+# so no .spv files have to be shipped next to the binaries or kept in sync.
+
+find_program(TMX_GLSLC glslc
+  HINTS
+    ${Vulkan_GLSLC_EXECUTABLE}
+    ${VULKAN_SDK_PATH}/bin
+    $ENV{VULKAN_SDK}/bin
+  REQUIRED
+)
+
+set(TMX_SPIRV_DIR ${PROJECT_BINARY_DIR}/spirv)
+set(TMX_SPIRV_INCLUDES "")
+set(TMX_SPIRV_ENTRIES "")
+set(TMX_SPIRV_HEADERS "")
+
+# tmx_add_shader(NAME SOURCE [DEFINES ...])
+# NAME is what the pipelines ask for, e.g. isosurface_generation.comp. The
+# depfile glslc writes tracks the .glsl and .inl files a shader includes.
+function(tmx_add_shader name source)
+  cmake_parse_arguments(PARSE_ARGV 2 SHADER "" "" "DEFINES")
+  set(spirv ${TMX_SPIRV_DIR}/${name}.spv)
+  set(header ${TMX_SPIRV_DIR}/${name}.spv.inl)
+  string(MAKE_C_IDENTIFIER "SPIRV_${name}" symbol)
+
+  set(defines "")
+  foreach(define IN LISTS SHADER_DEFINES)
+    list(APPEND defines -D${define})
+  endforeach()
+
+  add_custom_command(
+    OUTPUT ${spirv}
+    COMMAND ${TMX_GLSLC} --target-spv=spv1.6 ${defines} -MD -MF ${spirv}.d -o ${spirv} ${source}
+    MAIN_DEPENDENCY ${source}
+    DEPFILE ${spirv}.d
+    COMMENT "Compiling ${name}"
+    VERBATIM
+  )
+  add_custom_command(
+    OUTPUT ${header}
+    COMMAND ${CMAKE_COMMAND} -DINPUT=${spirv} -DOUTPUT=${header} -DSYMBOL=${symbol} -P ${PROJECT_SOURCE_DIR}/cmake/embed_spirv.cmake
+    DEPENDS ${spirv} ${PROJECT_SOURCE_DIR}/cmake/embed_spirv.cmake
+    COMMENT "Embedding ${name}"
+    VERBATIM
+  )
+
+  set(TMX_SPIRV_INCLUDES "${TMX_SPIRV_INCLUDES}#include \"${name}.spv.inl\"\n" PARENT_SCOPE)
+  set(TMX_SPIRV_ENTRIES "${TMX_SPIRV_ENTRIES}  EmbeddedSpirv{\"${name}\", ${symbol}},\n" PARENT_SCOPE)
+  set(TMX_SPIRV_HEADERS ${TMX_SPIRV_HEADERS} ${header} PARENT_SCOPE)
+endfunction()
+
+set(TMX_SHADER_DIR ${PROJECT_SOURCE_DIR}/src/gpu/shaders)
+tmx_add_shader(isosurface_generation.comp ${TMX_SHADER_DIR}/isosurface_generation.comp)
+tmx_add_shader(isosurface_meshing.comp ${TMX_SHADER_DIR}/isosurface_meshing.comp)
+tmx_add_shader(isosurface_edit.comp ${TMX_SHADER_DIR}/isosurface_edit.comp)
+# Per chunk clocks for --chunk-stats on devices with VK_KHR_shader_clock.
+tmx_add_shader(isosurface_generation_clock.comp ${TMX_SHADER_DIR}/isosurface_generation.comp DEFINES CHUNK_STATS_CLOCK)
+tmx_add_shader(isosurface_meshing_clock.comp ${TMX_SHADER_DIR}/isosurface_meshing.comp DEFINES CHUNK_STATS_CLOCK)
+tmx_add_shader(voxel.vert ${TMX_SHADER_DIR}/raster/voxel.vert)
+tmx_add_shader(voxel.frag ${TMX_SHADER_DIR}/raster/voxel.frag)
+
+configure_file(${PROJECT_SOURCE_DIR}/cmake/embedded_spirv.hpp.in ${TMX_SPIRV_DIR}/embedded_spirv.hpp @ONLY)
+add_custom_target(tmx_spirv DEPENDS ${TMX_SPIRV_HEADERS})
+
+# For every target that creates pipelines.
+function(tmx_embed_spirv target)
+  add_dependencies(${target} tmx_spirv)
+  target_include_directories(${target} PRIVATE ${TMX_SPIRV_DIR})
+endfunction()
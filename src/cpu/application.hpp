@@ -1,16 +1,24 @@
 #pragma once
 
 #include "core/components.hpp"
+#include "core/cpu_profiler.hpp"
 #include "core/event_bus.hpp"
+#include "core/grid_config.hpp"
+#include "core/paths.hpp"
 
 #include "input.hpp"
 #include "camera.hpp"
+#include "replay.hpp"
 
 #include "pipelines/compute/compute_pipeline.hpp"
 #include "pipelines/graphics/graphics_pipeline.hpp"
 
+#include "systems/autotuner.hpp"
 #include "systems/resource_manager.hpp"
 #include "systems/terrain_system.hpp"
+#include "systems/terrain_collision.hpp"
+
+#include "vk/frame_stats.hpp"
 
 #include <array>
 #include <cstring>
@@ -20,6 +28,10 @@
 #include <iostream>
 #include <utility>
 #include <filesystem>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
 
 #include <unistd.h>
 
@@ -27,15 +39,53 @@ namespace tmx {
   
   struct Application {
 
+  GridConfig grid_config{};
+  ReplayConfig replay_config{};
+
+  // --dag PATH meshes a world baked by dag_bench instead of the generated
+  // one. DAG worlds are static, brush edits to them are dropped.
+  std::string dag_path{};
+
+  // Arguments meant for others are skipped, like GridConfig::from_args.
+  [[nodiscard]]
+  static std::string dag_path_from_args(const int argc, const char *const *argv) {
+    std::string path{};
+    for(int i = 1; i < argc; i++) {
+      if(std::string{argv[i]} != "--dag") {
+        continue;
+      }
+      if(i + 1 >= argc) {
+        throw std::runtime_error("Missing value for --dag!");
+      }
+      path = argv[++i];
+    }
+    return path;
+  }
+
   void run(void) {
     f64 dt{0.0};
     f32 iTime{0.0}; // In seconds
     u64 frame_number{0};
+    bool trace_key_down{false};
 
     EventBus event_bus{};
 
-    Window window{1280, 720, "Vulkan"};
-    Context vk_context{window};
+    // Headless replays render offscreen at the window's size.
+    std::unique_ptr<Window> window{};
+    std::unique_ptr<Context> context{};
+    if(replay_config.headless) {
+      context = std::make_unique<Context>(TmxHeadlessInfo{.extent = {1280, 720}, .validation = replay_config.validation});
+    }
+    else {
+      window = std::make_unique<Window>(1280, 720, "Vulkan");
+      context = std::make_unique<Context>(*window);
+    }
+    Context &vk_context = *context;
+    // Cursor positions are in window coordinates, see Camera::initial_response.
+    const VkExtent2D render_extent = vk_context.get_render_extent();
+    const float2 view_dim = window ?
+      window->get_dim_f32() :
+      float2{static_cast<f32>(render_extent.width), static_cast<f32>(render_extent.height)};
     
     GraphicsPipeline common_pipeline {
       {
@@ -45,6 +95,7 @@ namespace tmx {
         vk_context.get_swapchain_image_format(),
         vk_context.get_depth_format(),
         VK_FALSE,
+        vk_context.get_pipeline_cache(),
       }
     };
 
@@ -52,16 +103,43 @@ namespace tmx {
 
     std::unique_ptr<ResourceManager> resource_manager =
       std::make_unique<ResourceManager>(&vk_context);
-    
-    Input input{window.get_glfw_window(), &event_bus, &dt};
-    Camera camera {TransformComponent{float3{0.0}, float3{0.0}, float3{1.0}}, 0.01, 100000.0, &window, &input, &event_bus, resource_manager.get(), &dt};
+
+    grid_config = Autotuner{&vk_context, &common_pipeline, resource_manager.get()}.select(grid_config);
+    grid_config.apply(vk_context.get_limits(), vk_context.get_shader_subgroup_size());
+
+    // A replay stands in for Input, the camera is never flown by hand.
+    std::unique_ptr<Input> input{};
+    if(window) {
+      input = std::make_unique<Input>(window->get_glfw_window(), &event_bus, &dt);
+    }
+    Camera camera {TransformComponent{float3{0.0}, float3{0.0}, float3{1.0}}, 0.01, 100000.0, window.get(), input.get(), &event_bus, resource_manager.get(), &dt};
     TerrainManager terrain_manager{&vk_context, &event_bus, &common_pipeline, resource_manager.get()};
 
+    std::optional<ReplayRecorder> recorder{};
+    std::optional<ReplayPlayer> player{};
+    if(replay_config.recording()) {
+      recorder.emplace(&event_bus, grid_config);
+    }
+    if(replay_config.replaying()) {
+      player.emplace(Replay::load(replay_config.replay_path), &event_bus);
+      player->get_replay().check_grid(grid_config);
+    }
+
+    FrameStats frame_stats{};
+
+    ThreadPool thread_pool{};
+    TerrainCollision terrain_collision{&event_bus, &thread_pool};
+
     std::cout << "IsosurfaceGenerationEvent" << std::endl;
 	  event_bus.notify<IsosurfaceGenerationEvent>(
       IsosurfaceGenerationEvent{.progress = int3{0, 0, 0}}
     );
 
+    if(!dag_path.empty()) {
+      std::cout << "Meshing the static DAG world " << dag_path << ", brush edits are disabled" << std::endl;
+      terrain_manager.mesh_from_dag(VoxelDag::load(dag_path));
+    }
+
     std::cout << "IsosurfaceMeshingEvent" << std::endl;
 	  event_bus.notify<IsosurfaceMeshingEvent>(
       IsosurfaceMeshingEvent{.progress = int3{0, 0, 0}}
@@ -73,23 +151,57 @@ namespace tmx {
     
     std::cout << "Initialization Successful!" << std::endl;
 
-    while(!window.should_close() && !glfwGetKey(window.get_glfw_window(), GLFW_KEY_ESCAPE)) {
+    while(player ? !player->finished() : !window->should_close()) {
+    if(window && glfwGetKey(window->get_glfw_window(), GLFW_KEY_ESCAPE)) {
+      break;
+    }
 
+    TMX_ZONE("Application::frame");
     frame_number++;
     auto final = std::chrono::steady_clock::now();
-    dt = std::chrono::duration<f64, std::chrono::milliseconds::period>(final - initial).count();
+    const f64 frame_ms = std::chrono::duration<f64, std::chrono::milliseconds::period>(final - initial).count();
+    dt = player ? player->get_timestep_ms() : frame_ms;
     initial = final;
     iTime += dt/1000.0;
-    //std::cout << "FRAMETIME: " << dt << " ms" << std::endl;
+    frame_stats.frame(frame_ms);
+    if(frame_number % GPU_PROFILER_REPORT_INTERVAL == 0) {
+      std::cout << "FRAMETIME: " << dt << " ms" << std::endl;
+      vk_context.get_profiler().print_report();
+      frame_stats.print_report();
+    }
+
+    const auto input_time = std::chrono::steady_clock::now();
+
+    if(player) {
+      if(window) glfwPollEvents();
+      player->play_frame(camera);
+    }
+    else {
+      input->process_events();
+      camera.process_input();
+    }
+    if(recorder) {
+      recorder->end_frame(camera.transform);
+    }
+
+    // F12 dumps the recent CPU zones, e.g. right after a hitch.
+    const bool trace_key = window && glfwGetKey(window->get_glfw_window(), GLFW_KEY_F12) == GLFW_PRESS;
+    if(trace_key && !trace_key_down) {
+      CpuProfiler::export_chrome_trace(cache_path("cpu_trace.json"));
+    }
+    trace_key_down = trace_key;
 
-    input.process_events();
-    camera.process_input();
+    terrain_manager.flush_edits();
 
+    frame_stats.retire(vk_context.get_device(), vk_context.get_in_flight_fence());
     VkCommandBuffer command_buffer = vk_context.rendering_begin_command_buffers();
+    const VkFence frame_fence = vk_context.get_in_flight_fence();
+    frame_stats.collect_gpu(vk_context.get_profiler());
+    const u32 raster_scope = vk_context.get_profiler().cmd_begin(command_buffer, GPU_PASS_RASTERIZATION);
     vk_context.cmd_begin_rendering(command_buffer);
     const u32 frame = vk_context.get_current_frame();
     
-    camera.update_self_data(frame, 1.35, window.get_aspect_ratio(), window.get_dim_f32());
+    camera.update_self_data(frame, 1.35, view_dim.x / view_dim.y, view_dim);
 	
     VkDrawIndirectCommand *draws = terrain_manager.get_indirect_cmds_host_address();
 
@@ -121,12 +233,33 @@ namespace tmx {
     );
 
     vk_context.cmd_end_rendering(command_buffer);
+    vk_context.get_profiler().cmd_end(command_buffer, raster_scope);
     vk_context.end_command_buffer(command_buffer);
     vk_context.queue_submit_and_present(command_buffer);
+    frame_stats.submitted(frame_fence, final, input_time);
+
+    if(player) {
+      player->end_frame(std::chrono::duration<f64, std::chrono::milliseconds::period>(std::chrono::steady_clock::now() - final).count());
+    }
 
     }
 
     vkDeviceWaitIdle(vk_context.get_device());
+
+    vk_context.get_profiler().flush();
+    vk_context.get_profiler().print_report();
+    vk_context.get_profiler().export_csv(cache_path("gpu_profile.csv"));
+    frame_stats.collect_gpu(vk_context.get_profiler());
+    frame_stats.print_report();
+    frame_stats.export_json(cache_path("frame_stats.json"));
+    CpuProfiler::export_chrome_trace(cache_path("cpu_trace.json"));
+
+    if(recorder) {
+      recorder->save(replay_config.record_path);
+    }
+    if(player) {
+      player->export_csv(replay_config.timings_path, vk_context.get_profiler().get_history());
+    }
   }
 
   }; // Application
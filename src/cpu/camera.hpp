@@ -61,8 +61,9 @@ namespace tmx {
         1.0,
       };
       
-      float3 mouse_worldspace =
-        glm::inverse(mat4{transform}) * glm::inverse(matrices.projection_matrix) * mouse_clip;
+      const float4 mouse_world =
+        glm::inverse(matrices.projection_matrix * matrices.view_matrix) * mouse_clip;
+      const float3 mouse_worldspace = float3{mouse_world} / mouse_world.w;
 
       float3 ray_pos = transform.translation;
       float3 ray_dir = glm::normalize(mouse_worldspace - ray_pos);
@@ -74,7 +75,13 @@ namespace tmx {
       std::endl;
 
       event_bus->notify<IsosurfaceModificationEvent>(
-        IsosurfaceModificationEvent{.ray = Ray{ray_pos, ray_dir}}
+        IsosurfaceModificationEvent{
+          .ray = Ray{ray_pos, ray_dir},
+          .shape = e.shape,
+          .operation = e.operation,
+          .radius = e.radius,
+          .smoothing = e.smoothing,
+        }
       );
     }
 
@@ -0,0 +1,163 @@
+#pragma once
+
+#include <types.inl>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// 0 compiles every TMX_ZONE out. The zones cost two clock reads and a ring
+// buffer write, so they stay on in release builds.
+#ifndef TMX_CPU_PROFILER
+#define TMX_CPU_PROFILER 1
+#endif
+
+// Zones kept per thread, older ones are overwritten.
+#define CPU_PROFILER_RING_SIZE (1 << 14)
+
+namespace tmx {
+
+// name must outlive the profiler, string literals or typeid names.
+struct CpuZoneEvent {
+  const char *name;
+  u64 begin_ns;
+  u64 end_ns;
+};
+
+// Only its own thread writes a ring, publishing each zone through head.
+struct CpuZoneRing {
+  std::array<CpuZoneEvent, CPU_PROFILER_RING_SIZE> events{};
+  std::atomic<u64> head{0};
+  u32 thread_id{0};
+};
+
+// Collects zones from every thread without locks on the recording side. A
+// thread takes the registry lock once, when it records its first zone, and
+// its ring lives until exit so traces still show threads that have ended.
+struct CpuProfiler {
+  public:
+  [[nodiscard]]
+  static u64 now_ns(void) {
+    return static_cast<u64>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count()
+    );
+  }
+
+  static void record(const char *name, const u64 begin_ns, const u64 end_ns) {
+    CpuZoneRing &ring = thread_ring();
+    const u64 head = ring.head.load(std::memory_order_relaxed);
+    ring.events[head % CPU_PROFILER_RING_SIZE] = CpuZoneEvent{name, begin_ns, end_ns};
+    ring.head.store(head + 1, std::memory_order_release);
+  }
+
+  // Chrome trace event JSON, opens in chrome://tracing and Perfetto. Zones a
+  // thread overwrote while being copied are left out.
+  static void export_chrome_trace(const std::string &path) {
+    std::vector<std::pair<u32, CpuZoneEvent>> zones;
+    {
+      std::lock_guard<std::mutex> lock{registry_mutex()};
+      for(const std::unique_ptr<CpuZoneRing> &ring : rings()) {
+        const u64 head = ring->head.load(std::memory_order_acquire);
+        const u64 first = head > CPU_PROFILER_RING_SIZE ? head - CPU_PROFILER_RING_SIZE : 0;
+
+        std::vector<CpuZoneEvent> copied;
+        copied.reserve(head - first);
+        for(u64 i = first; i < head; i++) {
+          copied.push_back(ring->events[i % CPU_PROFILER_RING_SIZE]);
+        }
+
+        const u64 head_after = ring->head.load(std::memory_order_acquire);
+        for(u64 i = first; i < head; i++) {
+          if(i + CPU_PROFILER_RING_SIZE > head_after) {
+            zones.emplace_back(ring->thread_id, copied[i - first]);
+          }
+        }
+      }
+    }
+
+    std::ofstream file(path, std::ios::trunc);
+    if(!file.is_open()) {
+      throw std::runtime_error("Failed to open " + path + " for writing!");
+    }
+
+    u64 origin_ns = ~u64{0};
+    for(const auto &[thread_id, zone] : zones) {
+      origin_ns = std::min(origin_ns, zone.begin_ns);
+    }
+
+    file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    for(size_t i = 0; i < zones.size(); i++) {
+      const auto &[thread_id, zone] = zones[i];
+      file << (i == 0 ? "\n" : ",\n")
+           << "{\"name\":\"" << zone.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << thread_id
+           << ",\"ts\":" << static_cast<f64>(zone.begin_ns - origin_ns)*1e-3
+           << ",\"dur\":" << static_cast<f64>(zone.end_ns - zone.begin_ns)*1e-3 << "}";
+    }
+    file << "\n]}\n";
+
+    std::cout << "CPU trace of " << zones.size() << " zones written to " << path << std::endl;
+  }
+
+  private:
+  [[nodiscard]]
+  static CpuZoneRing &thread_ring(void) {
+    thread_local CpuZoneRing *ring = register_thread();
+    return *ring;
+  }
+
+  [[nodiscard]]
+  static CpuZoneRing *register_thread(void) {
+    std::lock_guard<std::mutex> lock{registry_mutex()};
+    std::unique_ptr<CpuZoneRing> &ring = rings().emplace_back(std::make_unique<CpuZoneRing>());
+    ring->thread_id = static_cast<u32>(rings().size() - 1);
+    return ring.get();
+  }
+
+  [[nodiscard]]
+  static std::mutex &registry_mutex(void) {
+    static std::mutex mutex;
+    return mutex;
+  }
+
+  [[nodiscard]]
+  static std::vector<std::unique_ptr<CpuZoneRing>> &rings(void) {
+    static std::vector<std::unique_ptr<CpuZoneRing>> registered;
+    return registered;
+  }
+};
+
+// Times its enclosing scope on the calling thread.
+struct CpuZone {
+  public:
+  explicit CpuZone(const char *name) : name{name}, begin_ns{CpuProfiler::now_ns()} {}
+
+  ~CpuZone(void) {
+    CpuProfiler::record(name, begin_ns, CpuProfiler::now_ns());
+  }
+
+  CpuZone(const CpuZone &) = delete;
+  CpuZone &operator=(const CpuZone &) = delete;
+
+  private:
+  const char *name;
+  u64 begin_ns;
+};
+
+}
+
+#define TMX_ZONE_CONCAT_(a, b) a##b
+#define TMX_ZONE_CONCAT(a, b) TMX_ZONE_CONCAT_(a, b)
+
+#if TMX_CPU_PROFILER
+#define TMX_ZONE(name) ::tmx::CpuZone TMX_ZONE_CONCAT(tmx_zone_, __LINE__){name}
+#else
+#define TMX_ZONE(name) do {} while(0)
+#endif
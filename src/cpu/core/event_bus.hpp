@@ -1,9 +1,12 @@
 #pragma once
 
+#include "cpu_profiler.hpp"
+
 #include <any>
 #include <typeindex>
 #include <functional>
 #include <unordered_map>
+#include <vector>
 
 namespace tmx {
   struct EventBus {
@@ -16,12 +19,31 @@ namespace tmx {
 	  callbacks[typeid(EventType)] = [caller, callerFn](const std::any &event) { (caller->*callerFn)(event); };
 	}
 
+	// Observers see an event before its one callback, e.g. ReplayRecorder.
+	template<typename EventType, typename CallerType>
+	void observe(CallerType *caller, void (CallerType::* callerFn)(const std::any &event)) {
+	  observers[typeid(EventType)].push_back([caller, callerFn](const std::any &event) { (caller->*callerFn)(event); });
+	}
+
+	// EventType::NAME labels the zone, typeid names are mangled.
 	template<typename EventType>
 	void notify(const EventType &event) {
-	  (callbacks[typeid(EventType)])(event);
+	  TMX_ZONE(EventType::NAME);
+	  if(!observers.empty()) {
+	    auto it = observers.find(typeid(EventType));
+	    if(it != observers.end()) {
+	      for(const auto &observer : it->second) observer(event);
+	    }
+	  }
+	  // Events nobody subscribed to, e.g. remeshes in a headless bench, are dropped.
+	  auto callback = callbacks.find(typeid(EventType));
+	  if(callback != callbacks.end()) {
+	    callback->second(event);
+	  }
 	}
 
 	private:
 	std::unordered_map< std::type_index, std::function<void(const std::any &)> > callbacks;
+	std::unordered_map< std::type_index, std::vector< std::function<void(const std::any &)> > > observers;
   };
 }
\ No newline at end of file
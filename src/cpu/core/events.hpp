@@ -2,16 +2,49 @@
 
 #include <push.inl>
 
+// Events carry a NAME for their EventBus::notify zones in CPU traces.
 struct IsosurfaceGenerationEvent {
+  static constexpr const char *NAME = "IsosurfaceGenerationEvent";
+
   int3 progress;
 };
 
 struct IsosurfaceMeshingEvent {
+  static constexpr const char *NAME = "IsosurfaceMeshingEvent";
+
   int3 progress;
 };
 
+// Host views of the meshing output after a meshing pass has completed.
+// chunks is null when every chunk was remeshed.
+struct IsosurfaceRemeshedEvent {
+  static constexpr const char *NAME = "IsosurfaceRemeshedEvent";
+
+  const int4 *chunks;
+  u32 chunk_count;
+  const float4 *vertices;
+  const uint2 *chunk_draw_info;
+  const VkDrawIndirectCommand *indirect;
+};
+
+enum BrushShape {
+  BRUSH_SHAPE_SPHERE,
+  BRUSH_SHAPE_BOX,
+};
+
+enum BrushOperation {
+  BRUSH_OPERATION_ADD,
+  BRUSH_OPERATION_REMOVE,
+};
+
 struct IsosurfaceModificationInitialEvent {
+  static constexpr const char *NAME = "IsosurfaceModificationInitialEvent";
+
   double2 cursor_pos;
+  BrushShape shape;
+  BrushOperation operation;
+  f32 radius;
+  f32 smoothing;
 };
 
 struct Ray {
@@ -20,5 +53,11 @@ struct Ray {
 };
 
 struct IsosurfaceModificationEvent {
+  static constexpr const char *NAME = "IsosurfaceModificationEvent";
+
   Ray ray;
+  BrushShape shape;
+  BrushOperation operation;
+  f32 radius;
+  f32 smoothing;
 };
\ No newline at end of file
@@ -0,0 +1,172 @@
+#pragma once
+
+#include <push.inl>
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+namespace tmx {
+
+// Chunk and world dimensions chosen at startup. apply() publishes them to
+// the COUNT_* globals in push.inl before any terrain system is created,
+// ComputePipeline passes the same values to the shaders as specialization
+// constants, so resizing chunks needs neither a C++ nor a SPIR-V rebuild.
+struct GridConfig {
+  int3 voxels_per_chunk{8};
+  int3 chunks_per_axis{8};
+
+  // Invocations of the chunk kernels' workgroups, 0 picks one per voxel
+  // up to DEFAULT_WORKGROUP_SIZE. Smaller workgroups loop over the chunk.
+  u32 workgroup_size{0};
+
+  // Offsets the density noise, every seed is a different world.
+  u32 seed{0};
+
+  // --autotune times the candidate sizes on this device before starting,
+  // see Autotuner. Stored results never override sizes set by arguments.
+  bool autotune{false};
+  bool sizes_from_args{false};
+
+  // Largest chunk side, generation keeps a class per 2^3 box of a chunk in
+  // shared memory. Meshes of chunks above 8^3 may span several allocator
+  // pages, see atomicMalloc.
+  static constexpr i32 MAX_CHUNK_VOXELS = 32;
+
+  // Marching cubes emits up to 5 triangles per cell.
+  static constexpr u32 MAX_CELL_VERTICES = 15;
+
+  // --chunk-voxels N[,N,N] --world-chunks N[,N,N] --workgroup-size N
+  // --seed N --autotune, arguments meant for others are skipped.
+  [[nodiscard]]
+  static GridConfig from_args(const int argc, const char *const *argv) {
+    GridConfig config{};
+    for(int i = 1; i < argc; i++) {
+      const std::string arg{argv[i]};
+      if(arg == "--autotune") {
+        config.autotune = true;
+        continue;
+      }
+      if(arg != "--chunk-voxels" && arg != "--world-chunks" && arg != "--workgroup-size" && arg != "--seed") {
+        continue;
+      }
+      if(i + 1 >= argc) {
+        throw std::runtime_error("Missing value for " + arg + "!");
+      }
+
+      const std::string value{argv[++i]};
+      if(arg == "--chunk-voxels") config.voxels_per_chunk = parse_int3(arg, value);
+      if(arg == "--world-chunks") config.chunks_per_axis = parse_int3(arg, value);
+      if(arg == "--workgroup-size") config.workgroup_size = static_cast<u32>(parse_int(arg, value));
+      if(arg == "--seed") config.seed = static_cast<u32>(parse_int(arg, value));
+      config.sizes_from_args |= arg != "--world-chunks" && arg != "--seed";
+    }
+    return config;
+  }
+
+  // Validates the configuration against the device and publishes it along
+  // with the subgroup size the shaders are specialized for.
+  void apply(const VkPhysicalDeviceLimits &limits, const u32 subgroup_size) const {
+    for(i32 axis = 0; axis < 3; axis++) {
+      const i32 side = voxels_per_chunk[axis];
+      if(side < COUNT_BRICK_VOXELS || side > MAX_CHUNK_VOXELS || side % COUNT_BRICK_VOXELS != 0) {
+        throw std::runtime_error(
+          "Chunks need a multiple of " + std::to_string(COUNT_BRICK_VOXELS) +
+          " up to " + std::to_string(MAX_CHUNK_VOXELS) + " voxels per axis!"
+        );
+      }
+      if(chunks_per_axis[axis] < 1) {
+        throw std::runtime_error("The world needs at least one chunk per axis!");
+      }
+    }
+
+#if VOXEL_LAYOUT == VOXEL_LAYOUT_MORTON
+    if(!cubic_power_of_two(voxels_per_chunk) || !cubic_power_of_two(chunks_per_axis)) {
+      throw std::runtime_error("The Morton voxel layout needs cubic power of two chunks and worlds!");
+    }
+#endif
+
+    // Every chunk may own an indirect draw command, all drawn by one call.
+    const i64 chunk_count = i64{chunks_per_axis.x}*chunks_per_axis.y*chunks_per_axis.z;
+    if(chunk_count > i64{limits.maxDrawIndirectCount}) {
+      throw std::runtime_error("The device draws at most " + std::to_string(limits.maxDrawIndirectCount) + " chunks per indirect call!");
+    }
+
+    const u32 voxel_count = static_cast<u32>(voxels_per_chunk.x*voxels_per_chunk.y*voxels_per_chunk.z);
+    // A chunk's mesh is one contiguous run of pages of the vertex buffer.
+    if(u64{voxel_count}*MAX_CELL_VERTICES > u64{ALLOCATOR_MAX_ALLOCATIONS}*ALLOCATOR_PAGE_SIZE) {
+      throw std::runtime_error("Chunks of " + std::to_string(voxel_count) + " voxels may mesh to more vertices than the vertex buffer holds!");
+    }
+
+    const u32 workgroup = workgroup_size != 0 ?
+      workgroup_size :
+      glm::min(glm::min(voxel_count, static_cast<u32>(DEFAULT_WORKGROUP_SIZE)), limits.maxComputeWorkGroupInvocations);
+    if(workgroup == 0 || workgroup > limits.maxComputeWorkGroupInvocations || workgroup > limits.maxComputeWorkGroupSize[0]) {
+      throw std::runtime_error(
+        "Workgroups need between 1 and " + std::to_string(limits.maxComputeWorkGroupInvocations) + " invocations!"
+      );
+    }
+
+    // Generation's box classes and the brick min/max reduction.
+    const u32 bricks = voxel_count / (COUNT_BRICK_VOXELS*COUNT_BRICK_VOXELS*COUNT_BRICK_VOXELS);
+    const u32 shared_bytes = voxel_count/8*sizeof(i32) + bricks*2*sizeof(u32);
+    if(shared_bytes > limits.maxComputeSharedMemorySize) {
+      throw std::runtime_error("Chunks of " + std::to_string(voxel_count) + " voxels exceed the device's shared memory!");
+    }
+
+    COUNT_VOXELS_X = voxels_per_chunk.x;
+    COUNT_VOXELS_Y = voxels_per_chunk.y;
+    COUNT_VOXELS_Z = voxels_per_chunk.z;
+    COUNT_CHUNKS_X = chunks_per_axis.x;
+    COUNT_CHUNKS_Y = chunks_per_axis.y;
+    COUNT_CHUNKS_Z = chunks_per_axis.z;
+    WORKGROUP_SIZE = workgroup;
+    SUBGROUP_SIZE = subgroup_size;
+    DENSITY_SEED = seed;
+
+    std::cout << "GRID "
+              << COUNT_VOXELS_X << "x" << COUNT_VOXELS_Y << "x" << COUNT_VOXELS_Z << " voxels per chunk, "
+              << COUNT_CHUNKS_X << "x" << COUNT_CHUNKS_Y << "x" << COUNT_CHUNKS_Z << " chunks, "
+              << WORKGROUP_SIZE << " invocations per workgroup, subgroups of " << SUBGROUP_SIZE << ", seed " << DENSITY_SEED << std::endl;
+  }
+
+  private:
+  [[nodiscard]]
+  static i32 parse_int(const std::string &arg, const std::string &value) {
+    char *end{nullptr};
+    const long parsed = std::strtol(value.c_str(), &end, 10);
+    if(end == value.c_str() || *end != '\0' || parsed < 0 || parsed > INT32_MAX) {
+      throw std::runtime_error("Invalid value " + value + " for " + arg + "!");
+    }
+    return static_cast<i32>(parsed);
+  }
+
+  // Either one value for every axis or three comma separated ones.
+  [[nodiscard]]
+  static int3 parse_int3(const std::string &arg, const std::string &value) {
+    const size_t first = value.find(',');
+    if(first == std::string::npos) {
+      return int3{parse_int(arg, value)};
+    }
+    const size_t second = value.find(',', first + 1);
+    if(second == std::string::npos) {
+      throw std::runtime_error("Invalid value " + value + " for " + arg + "!");
+    }
+    return int3{
+      parse_int(arg, value.substr(0, first)),
+      parse_int(arg, value.substr(first + 1, second - first - 1)),
+      parse_int(arg, value.substr(second + 1)),
+    };
+  }
+
+  [[nodiscard]]
+  static bool cubic_power_of_two(const int3 v) {
+    return v.x == v.y && v.x == v.z && (v.x & (v.x - 1)) == 0;
+  }
+};
+
+}
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <types.inl>
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <limits>
+#include <ostream>
+
+// Sub-buckets per power of two are 2^(LATENCY_HISTOGRAM_SUB_BUCKET_BITS - 1),
+// so a recorded value is off by less than 1/128 of itself.
+#define LATENCY_HISTOGRAM_SUB_BUCKET_BITS (8)
+// Values are recorded in microseconds and clamped below 2^32 us, 71 minutes.
+#define LATENCY_HISTOGRAM_VALUE_BITS (32)
+
+namespace tmx {
+
+// HDR style histogram, linear up to 2^SUB_BUCKET_BITS us and log-linear
+// above, with the same relative precision from microseconds to minutes.
+// Recording is a bit scan and an increment, cheap enough for every frame.
+struct LatencyHistogram {
+  public:
+  static constexpr u32 SUB_BUCKETS = 1u << LATENCY_HISTOGRAM_SUB_BUCKET_BITS;
+  static constexpr u32 HALF_SUB_BUCKETS = SUB_BUCKETS/2;
+  static constexpr u32 BUCKET_COUNT =
+    SUB_BUCKETS + (LATENCY_HISTOGRAM_VALUE_BITS - LATENCY_HISTOGRAM_SUB_BUCKET_BITS)*HALF_SUB_BUCKETS;
+
+  void record(const f64 ms) {
+    const f64 us = std::clamp(ms*1000.0, 0.0, static_cast<f64>(MAX_US));
+    const u64 value = static_cast<u64>(std::llround(us));
+    buckets[bucket_index(value)]++;
+    samples++;
+    sum_us += value;
+    min_us = std::min(min_us, value);
+    max_us = std::max(max_us, value);
+  }
+
+  void reset(void) {
+    buckets.fill(0);
+    samples = 0;
+    sum_us = 0;
+    min_us = std::numeric_limits<u64>::max();
+    max_us = 0;
+  }
+
+  [[nodiscard]] inline
+  u64 count(void) const { return samples; }
+
+  [[nodiscard]] inline
+  f64 min_ms(void) const { return samples == 0 ? 0.0 : min_us*1e-3; }
+
+  [[nodiscard]] inline
+  f64 max_ms(void) const { return max_us*1e-3; }
+
+  [[nodiscard]] inline
+  f64 mean_ms(void) const { return samples == 0 ? 0.0 : static_cast<f64>(sum_us)/samples*1e-3; }
+
+  // The highest value equivalent to the sample of rank ceil(q*count), so a
+  // percentile never reads lower than what was recorded.
+  [[nodiscard]]
+  f64 percentile_ms(const f64 q) const {
+    if(samples == 0) {
+      return 0.0;
+    }
+    const u64 rank = std::max<u64>(1, static_cast<u64>(std::ceil(std::clamp(q, 0.0, 1.0)*samples)));
+    u64 seen{0};
+    for(u32 i = 0; i < BUCKET_COUNT; i++) {
+      seen += buckets[i];
+      if(seen >= rank) {
+        return std::min(bucket_highest(i), max_us)*1e-3;
+      }
+    }
+    return max_ms();
+  }
+
+  // count, min, mean, max, the percentiles, and every non-empty bucket as
+  // [highest ms, count], enough to merge runs offline.
+  void write_json(std::ostream &out) const {
+    out << "{\"count\":" << samples
+        << ",\"min_ms\":" << min_ms()
+        << ",\"mean_ms\":" << mean_ms()
+        << ",\"max_ms\":" << max_ms()
+        << ",\"p50_ms\":" << percentile_ms(0.5)
+        << ",\"p90_ms\":" << percentile_ms(0.9)
+        << ",\"p99_ms\":" << percentile_ms(0.99)
+        << ",\"p99_9_ms\":" << percentile_ms(0.999)
+        << ",\"buckets\":[";
+    bool first{true};
+    for(u32 i = 0; i < BUCKET_COUNT; i++) {
+      if(buckets[i] == 0) {
+        continue;
+      }
+      out << (first ? "" : ",") << "[" << bucket_highest(i)*1e-3 << "," << buckets[i] << "]";
+      first = false;
+    }
+    out << "]}";
+  }
+
+  private:
+  static constexpr u64 MAX_US = (u64{1} << LATENCY_HISTOGRAM_VALUE_BITS) - 1;
+
+  // Values of 2^n and up keep their top SUB_BUCKET_BITS bits.
+  [[nodiscard]]
+  static u32 bucket_index(const u64 value) {
+    if(value < SUB_BUCKETS) {
+      return static_cast<u32>(value);
+    }
+    const u32 shift = static_cast<u32>(std::bit_width(value)) - LATENCY_HISTOGRAM_SUB_BUCKET_BITS;
+    const u32 top = static_cast<u32>(value >> shift);
+    return SUB_BUCKETS + (shift - 1)*HALF_SUB_BUCKETS + (top - HALF_SUB_BUCKETS);
+  }
+
+  [[nodiscard]]
+  static u64 bucket_highest(const u32 index) {
+    if(index < SUB_BUCKETS) {
+      return index;
+    }
+    const u32 shift = (index - SUB_BUCKETS)/HALF_SUB_BUCKETS + 1;
+    const u64 top = (index - SUB_BUCKETS)%HALF_SUB_BUCKETS + HALF_SUB_BUCKETS;
+    return ((top + 1) << shift) - 1;
+  }
+
+  std::array<u64, BUCKET_COUNT> buckets{};
+  u64 samples{0};
+  u64 sum_us{0};
+  u64 min_us{std::numeric_limits<u64>::max()};
+  u64 max_us{0};
+};
+
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+#include <system_error>
+
+// assets/bin of the source tree, set by CMakeLists.txt. Builds without it
+// fall back to the old location relative to the build directory.
+#ifndef TMX_ASSET_DIR
+#define TMX_ASSET_DIR "../../../assets/bin"
+#endif
+
+// The build directory, set by CMakeLists.txt. Builds without it write to
+// the working directory.
+#ifndef TMX_CACHE_DIR
+#define TMX_CACHE_DIR "."
+#endif
+
+namespace tmx {
+
+  // Where the lookup tables and golden hashes are read from. The
+  // TMX_ASSET_DIR environment variable overrides the configured directory,
+  // e.g. for installed binaries or CI workspaces.
+  [[nodiscard]] inline
+  std::string asset_dir(void) {
+    const char *dir = std::getenv("TMX_ASSET_DIR");
+    return dir != nullptr && *dir != '\0' ? std::string{dir} : std::string{TMX_ASSET_DIR};
+  }
+
+  [[nodiscard]] inline
+  std::string asset_path(const std::string &name) {
+    return asset_dir() + "/" + name;
+  }
+
+  // Where caches, traces and results are written, outside the source tree
+  // so runs leave the checkout clean. The TMX_CACHE_DIR environment
+  // variable overrides the configured directory.
+  [[nodiscard]] inline
+  std::string cache_dir(void) {
+    const char *dir = std::getenv("TMX_CACHE_DIR");
+    return dir != nullptr && *dir != '\0' ? std::string{dir} : std::string{TMX_CACHE_DIR};
+  }
+
+  // Creates the directory on first use, failures surface when the file is
+  // opened.
+  [[nodiscard]] inline
+  std::string cache_path(const std::string &name) {
+    const std::string dir = cache_dir();
+    std::error_code error;
+    std::filesystem::create_directories(dir, error);
+    return dir + "/" + name;
+  }
+
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <types.inl>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace tmx {
+
+  // Fixed set of workers that split index ranges between themselves and
+  // the calling thread. One parallel_for runs at a time.
+  struct ThreadPool {
+    public:
+    explicit ThreadPool(u32 worker_count = std::max(std::thread::hardware_concurrency(), 2u) - 1) {
+      for(u32 i = 0; i < worker_count; i++) {
+        workers.emplace_back([this](){ worker_loop(); });
+      }
+    }
+
+    ~ThreadPool(void) {
+      {
+        std::lock_guard<std::mutex> lock{mutex};
+        stopping = true;
+      }
+      wake.notify_all();
+      for(auto &worker : workers) {
+        worker.join();
+      }
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Calls fn(begin, end) over [0, count) in ranges of at most grain
+    // indices, returns once every range has been processed.
+    void parallel_for(const u32 count, const u32 grain, const std::function<void(u32, u32)> &fn) {
+      if(count == 0) {
+        return;
+      }
+
+      if(workers.empty() || count <= grain) {
+        fn(0, count);
+        return;
+      }
+
+      std::lock_guard<std::mutex> submit_lock{submit_mutex};
+
+      {
+        std::lock_guard<std::mutex> lock{mutex};
+        job = &fn;
+        job_count = count;
+        job_grain = std::max(grain, 1u);
+        next.store(0, std::memory_order_relaxed);
+        active = static_cast<u32>(workers.size());
+        generation++;
+      }
+      wake.notify_all();
+
+      run(fn, count, job_grain);
+
+      std::unique_lock<std::mutex> lock{mutex};
+      done.wait(lock, [this](){ return active == 0; });
+      job = nullptr;
+    }
+
+    [[nodiscard]] inline
+    u32 size(void) const { return static_cast<u32>(workers.size()) + 1; }
+
+    private:
+    void run(const std::function<void(u32, u32)> &fn, const u32 count, const u32 grain) {
+      for(;;) {
+        const u32 begin = next.fetch_add(grain, std::memory_order_relaxed);
+        if(begin >= count) {
+          break;
+        }
+        fn(begin, std::min(begin + grain, count));
+      }
+    }
+
+    void worker_loop(void) {
+      u64 seen{0};
+      std::unique_lock<std::mutex> lock{mutex};
+
+      for(;;) {
+        wake.wait(lock, [&](){ return stopping || generation != seen; });
+        if(stopping) {
+          return;
+        }
+
+        seen = generation;
+        const std::function<void(u32, u32)> *fn = job;
+        const u32 count = job_count;
+        const u32 grain = job_grain;
+
+        lock.unlock();
+        run(*fn, count, grain);
+        lock.lock();
+
+        if(--active == 0) {
+          done.notify_one();
+        }
+      }
+    }
+
+    std::vector<std::thread> workers;
+    std::mutex submit_mutex;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+
+    const std::function<void(u32, u32)> *job{nullptr};
+    u32 job_count{0};
+    u32 job_grain{1};
+    std::atomic<u32> next{0};
+    u32 active{0};
+    u64 generation{0};
+    bool stopping{false};
+  };
+
+}
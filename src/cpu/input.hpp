@@ -57,14 +57,22 @@ namespace tmx {
 
     void process_events(void) {
       glfwPollEvents();
-      for(i32 i = 0; i < 3; i++){
-        if(buttons[GLFW_MOUSE_BUTTON_LEFT] == ACTION_PRESS) {
+      // Left mouse button removes terrain, right mouse button adds it.
+      for(i32 button : {GLFW_MOUSE_BUTTON_LEFT, GLFW_MOUSE_BUTTON_RIGHT}) {
+        if(buttons[button] == ACTION_PRESS) {
           mouse_repeat_frequency += *pdelta;
           if(mouse_repeat_frequency > 225.0) {
 
             mouse_repeat_frequency = 0.0;
             pEventBus->notify<IsosurfaceModificationInitialEvent>(
-              IsosurfaceModificationInitialEvent{cursor_pos});
+              IsosurfaceModificationInitialEvent{
+                .cursor_pos = cursor_pos,
+                .shape = brush_shape,
+                .operation = button == GLFW_MOUSE_BUTTON_LEFT ? BRUSH_OPERATION_REMOVE : BRUSH_OPERATION_ADD,
+                .radius = brush_radius,
+                .smoothing = brush_smoothing,
+              }
+            );
 
           }
         }
@@ -72,7 +80,24 @@ namespace tmx {
     }
 
     void key_callback(i32 key, i32 scancode, i32 action, i32 mods) {
+      if(action == ACTION_RELEASE) return;
+
       switch(key) {
+        case GLFW_KEY_1:
+          brush_shape = BRUSH_SHAPE_SPHERE;
+          break;
+        case GLFW_KEY_2:
+          brush_shape = BRUSH_SHAPE_BOX;
+          break;
+        case GLFW_KEY_3:
+          brush_smoothing = brush_smoothing > 0.0f ? 0.0f : 2.0f;
+          break;
+        case GLFW_KEY_LEFT_BRACKET:
+          brush_radius = glm::max(brush_radius - 0.5f, 1.0f);
+          break;
+        case GLFW_KEY_RIGHT_BRACKET:
+          brush_radius = glm::min(brush_radius + 0.5f, 32.0f);
+          break;
         case GLFW_KEY_UNKNOWN:
         default:
           break;
@@ -94,5 +119,8 @@ namespace tmx {
     double2 cursor_pos;
     i32 buttons[3]{ACTION_NONE, ACTION_NONE, ACTION_NONE};
     f32 mouse_repeat_frequency{0.0};
+    BrushShape brush_shape{BRUSH_SHAPE_SPHERE};
+    f32 brush_radius{3.0};
+    f32 brush_smoothing{0.0};
   };
 }
\ No newline at end of file
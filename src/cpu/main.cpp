@@ -1,7 +1,11 @@
 #include "application.hpp"
 
-int main() {
-  tmx::Application application{};
+int main(int argc, char **argv) {
+  tmx::Application application{
+    tmx::GridConfig::from_args(argc, argv),
+    tmx::ReplayConfig::from_args(argc, argv),
+    tmx::Application::dag_path_from_args(argc, argv),
+  };
   application.run();
 
   return 0;
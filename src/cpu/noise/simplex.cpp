@@ -0,0 +1 @@
+#include "simplex.hpp"
\ No newline at end of file
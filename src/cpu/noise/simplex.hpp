@@ -0,0 +1,98 @@
+#pragma once
+
+#include <types.inl>
+
+#include <glm/glm.hpp>
+
+namespace tmx {
+
+  // CPU port of snoise(float3) in src/gpu/noise.glsl (Ashima Arts, MIT).
+  // Kept in single precision with the same constants so both sides agree
+  // to within rounding; swizzles are spelled out.
+  namespace simplex {
+
+    inline float3 mod289(const float3 x) {
+      return x - glm::floor(x * (1.0f / 289.0f)) * 289.0f;
+    }
+
+    inline float4 mod289(const float4 x) {
+      return x - glm::floor(x * (1.0f / 289.0f)) * 289.0f;
+    }
+
+    inline float4 permute(const float4 x) {
+      return mod289(((x*34.0f)+10.0f)*x);
+    }
+
+    inline float4 taylor_inv_sqrt(const float4 r) {
+      return 1.79284291400159f - 0.85373472095314f * r;
+    }
+
+    inline f32 snoise(const float3 v) {
+      const float2 C{1.0f/6.0f, 1.0f/3.0f};
+      const float4 D{0.0f, 0.5f, 1.0f, 2.0f};
+
+      // First corner
+      float3 i = glm::floor(v + glm::dot(v, float3{C.y}));
+      const float3 x0 = v - i + glm::dot(i, float3{C.x});
+
+      // Other corners
+      const float3 g = glm::step(float3{x0.y, x0.z, x0.x}, x0);
+      const float3 l = 1.0f - g;
+      const float3 i1 = glm::min(g, float3{l.z, l.x, l.y});
+      const float3 i2 = glm::max(g, float3{l.z, l.x, l.y});
+
+      const float3 x1 = x0 - i1 + C.x;
+      const float3 x2 = x0 - i2 + C.y;
+      const float3 x3 = x0 - D.y;
+
+      // Permutations
+      i = mod289(i);
+      const float4 p = permute(permute(permute(
+          i.z + float4{0.0f, i1.z, i2.z, 1.0f})
+          + i.y + float4{0.0f, i1.y, i2.y, 1.0f})
+          + i.x + float4{0.0f, i1.x, i2.x, 1.0f});
+
+      // Gradients: 7x7 points over a square, mapped onto an octahedron.
+      const f32 n_ = 0.142857142857f;
+      const float3 ns = n_ * float3{D.w, D.y, D.z} - float3{D.x, D.z, D.x};
+
+      const float4 j = p - 49.0f * glm::floor(p * ns.z * ns.z);
+
+      const float4 x_ = glm::floor(j * ns.z);
+      const float4 y_ = glm::floor(j - 7.0f * x_);
+
+      const float4 x = x_ * ns.x + ns.y;
+      const float4 y = y_ * ns.x + ns.y;
+      const float4 h = 1.0f - glm::abs(x) - glm::abs(y);
+
+      const float4 b0{x.x, x.y, y.x, y.y};
+      const float4 b1{x.z, x.w, y.z, y.w};
+
+      const float4 s0 = glm::floor(b0)*2.0f + 1.0f;
+      const float4 s1 = glm::floor(b1)*2.0f + 1.0f;
+      const float4 sh = -glm::step(h, float4{0.0f});
+
+      const float4 a0 = float4{b0.x, b0.z, b0.y, b0.w} + float4{s0.x, s0.z, s0.y, s0.w}*float4{sh.x, sh.x, sh.y, sh.y};
+      const float4 a1 = float4{b1.x, b1.z, b1.y, b1.w} + float4{s1.x, s1.z, s1.y, s1.w}*float4{sh.z, sh.z, sh.w, sh.w};
+
+      float3 p0{a0.x, a0.y, h.x};
+      float3 p1{a0.z, a0.w, h.y};
+      float3 p2{a1.x, a1.y, h.z};
+      float3 p3{a1.z, a1.w, h.w};
+
+      // Normalise gradients
+      const float4 norm = taylor_inv_sqrt(float4{glm::dot(p0, p0), glm::dot(p1, p1), glm::dot(p2, p2), glm::dot(p3, p3)});
+      p0 *= norm.x;
+      p1 *= norm.y;
+      p2 *= norm.z;
+      p3 *= norm.w;
+
+      // Mix final noise value
+      float4 m = glm::max(0.5f - float4{glm::dot(x0, x0), glm::dot(x1, x1), glm::dot(x2, x2), glm::dot(x3, x3)}, 0.0f);
+      m = m * m;
+      return 105.0f * glm::dot(m*m, float4{glm::dot(p0, x0), glm::dot(p1, x1), glm::dot(p2, x2), glm::dot(p3, x3)});
+    }
+
+  }
+
+}
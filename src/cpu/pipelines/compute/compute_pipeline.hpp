@@ -1,39 +1,39 @@
 #pragma once
 
 #include <push.inl>
+#include "../../core/cpu_profiler.hpp"
 #include "../../core/utils.hpp"
+#include "../../vk/context.hpp"
+#include "../shader_module.hpp"
 
 #include <vulkan/vulkan.h>
 
+#include <array>
 #include <vector>
 #include <string>
-#include <fstream>
+#include <future>
 
 namespace tmx {
 
   struct ComputePipeline {
     public:
-    ComputePipeline(const std::string &shader_file_name, const size_t push_constant_size, VkDevice &device)
-                  : push_constant_size{push_constant_size}, device{device} {
-      std::string f = "../../../spv/" + shader_file_name + ".comp.spv";
-      auto compute_code = read_file(f);
-      VkShaderModule shader_module;
-      create_shader_module(compute_code, &shader_module);
+    ComputePipeline(const std::string &shader_file_name, const size_t push_constant_size, Context *context)
+                  : push_constant_size{push_constant_size}, device{context->get_device()} {
+      TMX_ZONE("ComputePipeline");
+      VkShaderModule shader_module = create_shader_module(device, shader_file_name + ".comp");
       
-      VkPipelineShaderStageRequiredSubgroupSizeCreateInfo required_subgroup_size_info{
-        .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_REQUIRED_SUBGROUP_SIZE_CREATE_INFO,
-        .pNext = nullptr,
-        .requiredSubgroupSize = static_cast<u32>(32),
-      };
-
-      VkPipelineShaderStageCreateInfo shader_stage_create_info{
-        .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
-        .pNext = &required_subgroup_size_info,
-        .flags = 0,
-        .stage = VK_SHADER_STAGE_COMPUTE_BIT,
-        .module = shader_module,
-        .pName = "main",
-        .pSpecializationInfo = nullptr,
+      // Every shader sees the grid configuration, constants a shader does
+      // not declare are ignored. Indexed by the SPEC_* ids in push.inl.
+      const SpecializationData specialization_data{
+        static_cast<u32>(COUNT_VOXELS_X),
+        static_cast<u32>(COUNT_VOXELS_Y),
+        static_cast<u32>(COUNT_VOXELS_Z),
+        static_cast<u32>(COUNT_CHUNKS_X),
+        static_cast<u32>(COUNT_CHUNKS_Y),
+        static_cast<u32>(COUNT_CHUNKS_Z),
+        WORKGROUP_SIZE,
+        SUBGROUP_SIZE,
+        DENSITY_SEED,
       };
 
       VkPushConstantRange range{
@@ -54,37 +54,42 @@ namespace tmx {
 
       VK_CHECK(vkCreatePipelineLayout(device, &layout_create_info, nullptr, &pipeline_layout));
 
-      VkComputePipelineCreateInfo create_info{
-        .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
-        .pNext = nullptr,
-        .flags = VK_PIPELINE_CREATE_DISPATCH_BASE,
-        .stage = shader_stage_create_info,
-        .layout = pipeline_layout,
-        .basePipelineHandle = VK_NULL_HANDLE,
-        .basePipelineIndex = 0,
-      };
-
-      VK_CHECK(
-        vkCreateComputePipelines(
-                device,
-                nullptr,
-                1,
-                &create_info,
-                nullptr,
-                &pipeline
-        )
+      // Compiles on its own thread, so the pipelines a system declares build
+      // at once. The first bind waits for it.
+      compiling = std::async(
+        std::launch::async,
+        &ComputePipeline::create_pipeline,
+        this,
+        shader_module,
+        specialization_data,
+        context->get_shader_subgroup_size(),
+        context->subgroup_size_control,
+        context->get_pipeline_cache()
       );
-
-      vkDestroyShaderModule(device, shader_module, nullptr);
     };
 
     ~ComputePipeline() {
+      // A pipeline that was never bound may still be compiling.
+      if(compiling.valid()) {
+        try {
+          pipeline = compiling.get();
+        }
+        catch(const std::exception &) {}
+      }
       vkDestroyPipelineLayout(device, pipeline_layout, nullptr);
       vkDestroyPipeline(device, pipeline, nullptr);
     }
 
+    [[nodiscard]]
+    VkPipeline get_pipeline(void) {
+      if(compiling.valid()) {
+        pipeline = compiling.get();
+      }
+      return pipeline;
+    }
+
     void cmd_bind_pipeline(VkCommandBuffer command_buffer) {
-      vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+      vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, get_pipeline());
     }
 
     void cmd_dispatch(
@@ -114,7 +119,7 @@ namespace tmx {
       const void *push
     ) {
       
-      vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+      vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, get_pipeline());
 
       vkCmdPushConstants(
         command_buffer,
@@ -139,7 +144,7 @@ namespace tmx {
       const void *push
     ) {
       
-      vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+      vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, get_pipeline());
 
       vkCmdPushConstants(
         command_buffer,
@@ -154,41 +159,85 @@ namespace tmx {
     }
 
     private:
-    std::vector<char> read_file(const std::string &filename) {
-      std::ifstream file(filename, std::ios::ate | std::ios::binary);
+    // One u32 per SPEC_* constant.
+    using SpecializationData = std::array<u32, 9>;
+
+    VkPipeline create_pipeline(
+      VkShaderModule shader_module,
+      const SpecializationData specialization_data,
+      const u32 subgroup_size,
+      const bool subgroup_size_control,
+      VkPipelineCache pipeline_cache
+    ) {
+      TMX_ZONE("ComputePipeline::create_pipeline");
 
-      if (!file.is_open()) {
-        throw std::runtime_error(
-          std::string{"Failed to open compute shader file "} + std::string{filename} + std::string{" !"}
-        );
-      }
+      // Pins the subgroup size the shaders are specialized for where the
+      // device allows it, elsewhere they follow gl_SubgroupSize.
+      VkPipelineShaderStageRequiredSubgroupSizeCreateInfo required_subgroup_size_info{
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_REQUIRED_SUBGROUP_SIZE_CREATE_INFO,
+        .pNext = nullptr,
+        .requiredSubgroupSize = subgroup_size,
+      };
 
-      size_t file_size = (size_t) file.tellg();
-      std::vector<char> buffer(file_size);
+      constexpr u32 specialization_count = static_cast<u32>(std::tuple_size_v<SpecializationData>);
 
-      file.seekg(0);
-      file.read(buffer.data(), file_size);
+      VkSpecializationMapEntry specialization_entries[specialization_count];
+      for(u32 id = 0; id < specialization_count; id++) {
+        specialization_entries[id] = VkSpecializationMapEntry{
+          .constantID = id,
+          .offset = id*static_cast<u32>(sizeof(u32)),
+          .size = sizeof(u32),
+        };
+      }
 
-      file.close();
+      VkSpecializationInfo specialization_info{
+        .mapEntryCount = specialization_count,
+        .pMapEntries = specialization_entries,
+        .dataSize = sizeof(specialization_data),
+        .pData = specialization_data.data(),
+      };
 
-      return buffer;
-    }
+      VkPipelineShaderStageCreateInfo shader_stage_create_info{
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+        .pNext = subgroup_size_control ? &required_subgroup_size_info : nullptr,
+        .flags = 0,
+        .stage = VK_SHADER_STAGE_COMPUTE_BIT,
+        .module = shader_module,
+        .pName = "main",
+        .pSpecializationInfo = &specialization_info,
+      };
 
-    void create_shader_module(const std::vector<char> &code, VkShaderModule *module) {
-      VkShaderModuleCreateInfo shader_module_create_info{
-        .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+      VkComputePipelineCreateInfo create_info{
+        .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
         .pNext = nullptr,
-        .flags = 0,
-        .codeSize = code.size(),
-        .pCode = reinterpret_cast<const u32 *>(code.data()),
+        .flags = VK_PIPELINE_CREATE_DISPATCH_BASE,
+        .stage = shader_stage_create_info,
+        .layout = pipeline_layout,
+        .basePipelineHandle = VK_NULL_HANDLE,
+        .basePipelineIndex = 0,
       };
 
-      VK_CHECK(vkCreateShaderModule(device, &shader_module_create_info, nullptr, module));
+      VkPipeline created{VK_NULL_HANDLE};
+      const VkResult create_result =
+        vkCreateComputePipelines(
+                device,
+                pipeline_cache,
+                1,
+                &create_info,
+                nullptr,
+                &created
+        );
+
+      vkDestroyShaderModule(device, shader_module, nullptr);
+      VK_CHECK(create_result);
+
+      return created;
     }
 
     VkDevice &device;
     VkPipelineLayout pipeline_layout;
-    VkPipeline pipeline;
+    VkPipeline pipeline{VK_NULL_HANDLE};
+    std::future<VkPipeline> compiling;
     const size_t push_constant_size;
   };
 }
\ No newline at end of file
@@ -1,12 +1,15 @@
 #pragma once
 
+#include "../../core/cpu_profiler.hpp"
 #include "../../core/utils.hpp"
 #include "../../vk/context.hpp"
+#include "../shader_module.hpp"
 
 #include <vulkan/vulkan.h>
 
 #include <vector>
-#include <fstream>
+#include <future>
+#include <string>
 
 namespace tmx {
 
@@ -17,12 +20,14 @@ namespace tmx {
     const VkFormat swapchain_format;
     const VkFormat depth_format;
     const VkBool32 enable_blending;
+    // Context::get_pipeline_cache, or none.
+    VkPipelineCache pipeline_cache{VK_NULL_HANDLE};
   };
 
   struct GraphicsPipeline {
     public:
     GraphicsPipeline(const TmxGraphicsPipelineCreateInfo &create_info) : device{create_info.device} {
-      
+      TMX_ZONE("GraphicsPipeline");
       push_constant_size = create_info.push_constant_size;
 
       VkPushConstantRange push_constant_range{
@@ -43,13 +48,58 @@ namespace tmx {
 
       VK_CHECK(vkCreatePipelineLayout(device, &pipeline_layout_create_info, nullptr, &pipeline_layout));
 
-      std::string vertex_shader_file = "../../../spv/" + create_info.shader_file_name + ".vert.spv";
-      std::string fragment_shader_file = "../../../spv/" + create_info.shader_file_name + ".frag.spv";
-      auto vertex_shader_code = read_file(vertex_shader_file);
-      auto fragment_shader_code = read_file(fragment_shader_file);
+      VkShaderModule vertex_shader_module = create_shader_module(device, create_info.shader_file_name + ".vert");
+      VkShaderModule fragment_shader_module = create_shader_module(device, create_info.shader_file_name + ".frag");
+
+      // Compiles on its own thread, so pipelines created back to back build
+      // at once. The first get_pipeline waits for it.
+      compiling = std::async(
+        std::launch::async,
+        &GraphicsPipeline::create_pipeline,
+        this,
+        vertex_shader_module,
+        fragment_shader_module,
+        create_info.swapchain_format,
+        create_info.depth_format,
+        create_info.enable_blending,
+        create_info.pipeline_cache
+      );
+    }
 
-      VkShaderModule vertex_shader_module = create_shader_module(vertex_shader_code);
-      VkShaderModule fragment_shader_module = create_shader_module(fragment_shader_code);
+    ~GraphicsPipeline(void) {
+      // A pipeline that was never bound may still be compiling.
+      if(compiling.valid()) {
+        try {
+          pipeline = compiling.get();
+        }
+        catch(const std::exception &) {}
+      }
+      vkDestroyPipelineLayout(device, pipeline_layout, nullptr);
+      vkDestroyPipeline(device, pipeline, nullptr);
+    }
+
+    GraphicsPipeline(const GraphicsPipeline&) = delete;
+    GraphicsPipeline& operator=(const GraphicsPipeline&) = delete;
+
+    VkPipelineLayout get_pipeline_layout() { return pipeline_layout; }
+    VkPipeline get_pipeline() {
+      if(compiling.valid()) {
+        pipeline = compiling.get();
+      }
+      return pipeline;
+    }
+    u32 get_push_constant_size() { return push_constant_size; }
+
+    private:
+    VkPipeline create_pipeline(
+      VkShaderModule vertex_shader_module,
+      VkShaderModule fragment_shader_module,
+      const VkFormat swapchain_format,
+      const VkFormat depth_format,
+      const VkBool32 enable_blending,
+      VkPipelineCache pipeline_cache
+    ) {
+      TMX_ZONE("GraphicsPipeline::create_pipeline");
 
       VkPipelineShaderStageCreateInfo vertex_shader_stage_info{
         .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
@@ -139,7 +189,7 @@ namespace tmx {
       };
 
       VkPipelineColorBlendAttachmentState color_blend_attachment_state{
-        .blendEnable = create_info.enable_blending,
+        .blendEnable = enable_blending,
         .srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA,
         .dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA,
         .colorBlendOp = VK_BLEND_OP_ADD,
@@ -168,8 +218,8 @@ namespace tmx {
         .sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR,
         .pNext = nullptr,
         .colorAttachmentCount = 1,
-        .pColorAttachmentFormats = &create_info.swapchain_format,
-        .depthAttachmentFormat = create_info.depth_format,
+        .pColorAttachmentFormats = &swapchain_format,
+        .depthAttachmentFormat = depth_format,
         .stencilAttachmentFormat = VK_FORMAT_UNDEFINED
       };
 
@@ -209,61 +259,19 @@ namespace tmx {
         .basePipelineIndex = -1,
       };
 
-      VK_CHECK(vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipeline_create_info, nullptr, &pipeline));
+      VkPipeline created{VK_NULL_HANDLE};
+      const VkResult create_result = vkCreateGraphicsPipelines(device, pipeline_cache, 1, &pipeline_create_info, nullptr, &created);
 
       vkDestroyShaderModule(device, vertex_shader_module, nullptr);
       vkDestroyShaderModule(device, fragment_shader_module, nullptr);
+      VK_CHECK(create_result);
 
-    }
-
-    ~GraphicsPipeline(void) {
-      vkDestroyPipelineLayout(device, pipeline_layout, nullptr);
-      vkDestroyPipeline(device, pipeline, nullptr);
-    }
-
-    GraphicsPipeline(const GraphicsPipeline&) = delete;
-    GraphicsPipeline& operator=(const GraphicsPipeline&) = delete;
-
-    VkPipelineLayout get_pipeline_layout() { return pipeline_layout; }
-    VkPipeline get_pipeline() { return pipeline; }
-    u32 get_push_constant_size() { return push_constant_size; }
-
-    private:
-    std::vector<char> read_file(const std::string &filename) {
-      std::ifstream file(filename, std::ios::ate | std::ios::binary);
-
-      if (!file.is_open()) {
-        throw std::runtime_error(
-          std::string{"Failed to open graphics shader file "} + std::string{filename} + std::string{" !"}
-        );
-      }
-
-      u32 file_size = static_cast<u32>(file.tellg());
-      std::vector<char> buffer(file_size);
-
-      file.seekg(0);
-      file.read(buffer.data(), file_size);
-      file.close();
-
-      return buffer;
-    }
-
-    VkShaderModule create_shader_module(const std::vector<char> &code) {
-      VkShaderModuleCreateInfo shader_module_create_info{
-        .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
-        .pNext = nullptr,
-        .codeSize = code.size(),
-        .pCode = reinterpret_cast<const u32 *>(code.data()),
-      };
-
-      VkShaderModule shader_module;
-      VK_CHECK(vkCreateShaderModule(device, &shader_module_create_info, nullptr, &shader_module));
-
-      return shader_module;
+      return created;
     }
 
     VkPipelineLayout pipeline_layout;
-    VkPipeline pipeline;
+    VkPipeline pipeline{VK_NULL_HANDLE};
+    std::future<VkPipeline> compiling;
     u32 push_constant_size;
     VkDevice &device;
   };
@@ -0,0 +1 @@
+#include "shader_module.hpp"
\ No newline at end of file
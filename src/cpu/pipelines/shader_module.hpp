@@ -0,0 +1,47 @@
+#pragma once
+
+#include <types.inl>
+
+#include "../core/utils.hpp"
+
+#include <embedded_spirv.hpp>
+
+#include <vulkan/vulkan.h>
+
+#include <span>
+#include <stdexcept>
+#include <string>
+
+namespace tmx {
+
+  // SPIR-V cmake/shaders.cmake compiled into the binary, named after the
+  // shader source, e.g. isosurface_meshing.comp or voxel.vert.
+  [[nodiscard]] inline
+  std::span<const u32> find_spirv(const std::string &name) {
+    for(const EmbeddedSpirv &spirv : EMBEDDED_SPIRV) {
+      if(spirv.name == name) {
+        return spirv.code;
+      }
+    }
+    throw std::runtime_error("No embedded SPIR-V for shader " + name + "!");
+  }
+
+  [[nodiscard]] inline
+  VkShaderModule create_shader_module(VkDevice device, const std::string &name) {
+    const std::span<const u32> code = find_spirv(name);
+
+    VkShaderModuleCreateInfo shader_module_create_info{
+      .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+      .pNext = nullptr,
+      .flags = 0,
+      .codeSize = code.size_bytes(),
+      .pCode = code.data(),
+    };
+
+    VkShaderModule shader_module;
+    VK_CHECK(vkCreateShaderModule(device, &shader_module_create_info, nullptr, &shader_module));
+
+    return shader_module;
+  }
+
+}
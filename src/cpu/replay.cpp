@@ -0,0 +1 @@
+#include "replay.hpp"
\ No newline at end of file
@@ -0,0 +1,319 @@
+#pragma once
+
+#include "core/components.hpp"
+#include "core/event_bus.hpp"
+#include "core/events.hpp"
+#include "core/grid_config.hpp"
+#include "core/paths.hpp"
+
+#include "vk/gpu_profiler.hpp"
+
+#include "camera.hpp"
+
+#include <any>
+#include <array>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace tmx {
+
+// --record PATH logs a session, --replay PATH plays one back at its fixed
+// timestep and writes per frame timings to --replay-timings PATH.
+// --headless replays offscreen, without a window, and --validation turns
+// the validation layers on for it, they would skew the timings otherwise.
+struct ReplayConfig {
+  std::string record_path{};
+  std::string replay_path{};
+  std::string timings_path{cache_path("replay_timings.csv")};
+  bool headless{false};
+  bool validation{false};
+
+  // Frame time stored with a recording, replays advance by exactly this much.
+  static constexpr f32 DEFAULT_TIMESTEP_MS = 1000.0f/60.0f;
+
+  [[nodiscard]] inline
+  bool recording(void) const { return !record_path.empty(); }
+
+  [[nodiscard]] inline
+  bool replaying(void) const { return !replay_path.empty(); }
+
+  // Arguments meant for others are skipped, like GridConfig::from_args.
+  [[nodiscard]]
+  static ReplayConfig from_args(const int argc, const char *const *argv) {
+    ReplayConfig config{};
+    for(int i = 1; i < argc; i++) {
+      const std::string arg{argv[i]};
+      if(arg == "--headless") {
+        config.headless = true;
+        continue;
+      }
+      if(arg == "--validation") {
+        config.validation = true;
+        continue;
+      }
+      if(arg != "--record" && arg != "--replay" && arg != "--replay-timings") {
+        continue;
+      }
+      if(i + 1 >= argc) {
+        throw std::runtime_error("Missing value for " + arg + "!");
+      }
+
+      const std::string value{argv[++i]};
+      if(arg == "--record") config.record_path = value;
+      if(arg == "--replay") config.replay_path = value;
+      if(arg == "--replay-timings") config.timings_path = value;
+    }
+
+    if(config.recording() && config.replaying()) {
+      throw std::runtime_error("--record and --replay are exclusive!");
+    }
+    if(config.headless && !config.replaying()) {
+      throw std::runtime_error("--headless needs a --replay file to drive the camera!");
+    }
+    return config;
+  }
+};
+
+// The camera after a frame's input and the brush strokes issued during it,
+// edits[first_edit .. first_edit + edit_count).
+struct ReplayFrame {
+  float3 translation;
+  float3 rotation;
+  u32 first_edit;
+  u32 edit_count;
+};
+
+// A recorded session. Brush strokes are stored as the world space rays
+// Camera derives from the cursor, so a replay edits the same voxels
+// whatever the window size, headless included.
+struct Replay {
+  static constexpr u32 FILE_MAGIC = 0x524D5854; // "TMXR"
+  static constexpr u32 FILE_VERSION = 1;
+
+  f32 timestep_ms{ReplayConfig::DEFAULT_TIMESTEP_MS};
+  int3 voxels_per_chunk{0};
+  int3 chunks_per_axis{0};
+  u32 seed{0};
+  std::vector<ReplayFrame> frames;
+  std::vector<IsosurfaceModificationEvent> edits;
+
+  // 32 bit words in host order: magic, version, timestep, grid, seed, frame
+  // and edit counts, then 7 words per frame and 10 per edit.
+  void save(const std::string &path) const {
+    std::ofstream file(path, std::ios::binary);
+    if(!file.is_open()) {
+      throw std::runtime_error("Failed to open " + path + " for writing!");
+    }
+    write(file, FILE_MAGIC);
+    write(file, FILE_VERSION);
+    write(file, timestep_ms);
+    write(file, voxels_per_chunk);
+    write(file, chunks_per_axis);
+    write(file, seed);
+    write(file, static_cast<u32>(frames.size()));
+    write(file, static_cast<u32>(edits.size()));
+    for(const ReplayFrame &frame : frames) {
+      write(file, frame.translation);
+      write(file, frame.rotation);
+      write(file, frame.edit_count);
+    }
+    for(const IsosurfaceModificationEvent &edit : edits) {
+      write(file, edit.ray.pos);
+      write(file, edit.ray.dir);
+      write(file, static_cast<u32>(edit.shape));
+      write(file, static_cast<u32>(edit.operation));
+      write(file, edit.radius);
+      write(file, edit.smoothing);
+    }
+    std::cout << "Recorded " << frames.size() << " frames and " << edits.size() << " edits to " << path << std::endl;
+  }
+
+  [[nodiscard]]
+  static Replay load(const std::string &path) {
+    std::ifstream file(path, std::ios::binary);
+    if(!file.is_open()) {
+      throw std::runtime_error("Failed to open " + path + "!");
+    }
+    if(read<u32>(file) != FILE_MAGIC || read<u32>(file) != FILE_VERSION) {
+      throw std::runtime_error(path + " is not a replay of this version!");
+    }
+
+    Replay replay{};
+    replay.timestep_ms = read<f32>(file);
+    replay.voxels_per_chunk = read<int3>(file);
+    replay.chunks_per_axis = read<int3>(file);
+    replay.seed = read<u32>(file);
+    const u32 frame_count = read<u32>(file);
+    const u32 edit_count = read<u32>(file);
+    if(!file) {
+      throw std::runtime_error(path + " is truncated!");
+    }
+
+    replay.frames.resize(frame_count);
+    u32 first_edit{0};
+    for(ReplayFrame &frame : replay.frames) {
+      frame.translation = read<float3>(file);
+      frame.rotation = read<float3>(file);
+      frame.edit_count = read<u32>(file);
+      frame.first_edit = first_edit;
+      first_edit += frame.edit_count;
+    }
+    if(first_edit != edit_count) {
+      throw std::runtime_error(path + " has inconsistent edit counts!");
+    }
+
+    replay.edits.resize(edit_count);
+    for(IsosurfaceModificationEvent &edit : replay.edits) {
+      edit.ray.pos = read<float3>(file);
+      edit.ray.dir = read<float3>(file);
+      edit.shape = static_cast<BrushShape>(read<u32>(file));
+      edit.operation = static_cast<BrushOperation>(read<u32>(file));
+      edit.radius = read<f32>(file);
+      edit.smoothing = read<f32>(file);
+    }
+    if(!file) {
+      throw std::runtime_error(path + " is truncated!");
+    }
+
+    std::cout << "Replaying " << frame_count << " frames and " << edit_count << " edits from " << path << std::endl;
+    return replay;
+  }
+
+  // Edits only land on the same voxels in the world they were recorded in.
+  void check_grid(const GridConfig &grid_config) const {
+    if(voxels_per_chunk != grid_config.voxels_per_chunk ||
+       chunks_per_axis != grid_config.chunks_per_axis ||
+       seed != grid_config.seed) {
+      std::cout << "WARNING: the replay was recorded with a different grid or seed" << std::endl;
+    }
+  }
+
+  private:
+  template<typename T>
+  static void write(std::ofstream &file, const T &value) {
+    file.write(reinterpret_cast<const char *>(&value), sizeof(T));
+  }
+
+  template<typename T>
+  [[nodiscard]]
+  static T read(std::ifstream &file) {
+    T value{};
+    file.read(reinterpret_cast<char *>(&value), sizeof(T));
+    return value;
+  }
+};
+
+// Observes the brush strokes Camera turns into rays and stores them with the
+// camera transform of every frame.
+struct ReplayRecorder {
+  public:
+  ReplayRecorder(EventBus *event_bus, const GridConfig &grid_config) {
+    replay.voxels_per_chunk = grid_config.voxels_per_chunk;
+    replay.chunks_per_axis = grid_config.chunks_per_axis;
+    replay.seed = grid_config.seed;
+    event_bus->observe<IsosurfaceModificationEvent>(this, &ReplayRecorder::modification);
+  }
+
+  void modification(const std::any &e) {
+    replay.edits.push_back(std::any_cast<const IsosurfaceModificationEvent &>(e));
+  }
+
+  // Called once the frame's input moved the camera.
+  void end_frame(const TransformComponent &transform) {
+    const u32 recorded = static_cast<u32>(replay.edits.size());
+    replay.frames.push_back(ReplayFrame{
+      .translation = transform.translation,
+      .rotation = transform.rotation,
+      .first_edit = first_edit,
+      .edit_count = recorded - first_edit,
+    });
+    first_edit = recorded;
+  }
+
+  void save(const std::string &path) const {
+    replay.save(path);
+  }
+
+  private:
+  Replay replay{};
+  u32 first_edit{0};
+};
+
+// Drives Camera and the brush from a Replay in place of Input, and keeps
+// the host time of each frame for export_csv.
+struct ReplayPlayer {
+  public:
+  ReplayPlayer(Replay replay, EventBus *event_bus) : replay{std::move(replay)}, event_bus{event_bus} {
+    cpu_ms.reserve(this->replay.frames.size());
+  }
+
+  [[nodiscard]] inline
+  bool finished(void) const { return next_frame >= replay.frames.size(); }
+
+  [[nodiscard]] inline
+  f64 get_timestep_ms(void) const { return replay.timestep_ms; }
+
+  [[nodiscard]] inline
+  const Replay &get_replay(void) const { return replay; }
+
+  // Issues the frame's brush strokes, then moves the camera where the
+  // recording had it after its input.
+  void play_frame(Camera &camera) {
+    const ReplayFrame &frame = replay.frames[next_frame++];
+    for(u32 i = 0; i < frame.edit_count; i++) {
+      event_bus->notify<IsosurfaceModificationEvent>(replay.edits[frame.first_edit + i]);
+    }
+    camera.transform.translation = frame.translation;
+    camera.transform.rotation = frame.rotation;
+  }
+
+  void end_frame(const f64 ms) {
+    cpu_ms.push_back(ms);
+  }
+
+  // One row per replayed frame. A frame's edits are recorded before
+  // Context::rendering_begin_command_buffers moves the profiler on, so
+  // they are sampled under the previous profiler frame.
+  void export_csv(const std::string &path, const std::vector<GpuPassSample> &gpu_history) const {
+    std::vector< std::array<f64, GPU_PASS_COUNT> > gpu_ms(cpu_ms.size(), std::array<f64, GPU_PASS_COUNT>{});
+    for(const GpuPassSample &sample : gpu_history) {
+      const u64 frame = sample.pass == GPU_PASS_EDITS ? sample.frame + 1 : sample.frame;
+      if(frame >= 1 && frame <= gpu_ms.size()) {
+        gpu_ms[frame - 1][sample.pass] += sample.ms;
+      }
+    }
+
+    std::ofstream file(path);
+    if(!file.is_open()) {
+      throw std::runtime_error("Failed to open " + path + " for writing!");
+    }
+    file << "frame,edits,cpu_ms";
+    for(u32 pass = 0; pass < GPU_PASS_COUNT; pass++) {
+      file << "," << GPU_PASS_NAMES[pass] << "_ms";
+    }
+    file << ",gpu_ms\n";
+    for(size_t i = 0; i < cpu_ms.size(); i++) {
+      f64 gpu_total{0.0};
+      file << i + 1 << "," << replay.frames[i].edit_count << "," << cpu_ms[i];
+      for(u32 pass = 0; pass < GPU_PASS_COUNT; pass++) {
+        file << "," << gpu_ms[i][pass];
+        gpu_total += gpu_ms[i][pass];
+      }
+      file << "," << gpu_total << "\n";
+    }
+    std::cout << "Replay timings of " << cpu_ms.size() << " frames written to " << path << std::endl;
+  }
+
+  private:
+  Replay replay;
+  EventBus *event_bus;
+  size_t next_frame{0};
+  std::vector<f64> cpu_ms;
+};
+
+}
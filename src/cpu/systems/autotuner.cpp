@@ -0,0 +1 @@
+#include "autotuner.hpp"
\ No newline at end of file
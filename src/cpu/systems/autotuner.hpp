@@ -0,0 +1,215 @@
+#pragma once
+
+#include <push.inl>
+
+#include "../core/event_bus.hpp"
+#include "../core/events.hpp"
+#include "../core/grid_config.hpp"
+#include "../core/paths.hpp"
+#include "../vk/context.hpp"
+#include "../vk/timestamp_timer.hpp"
+#include "resource_manager.hpp"
+#include "terrain_system.hpp"
+
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace tmx {
+
+struct AutotuneResult {
+  int3 voxels_per_chunk;
+  u32  workgroup_size;
+  f64  generation_ms;
+  f64  meshing_ms;
+};
+
+// Picks the chunk and workgroup size for the device. --autotune generates
+// and meshes a fixed world for every candidate, timed with GPU timestamps,
+// and stores the fastest under the device's UUID. Later runs load it unless
+// the command line sets the sizes itself.
+struct Autotuner {
+  public:
+  // Side of the tuning world in voxels, a whole number of chunks for every
+  // candidate side. Meshes of the larger sides span several allocator pages.
+  static constexpr i32 WORLD_VOXELS = 128;
+  static constexpr i32 CHUNK_SIDES[] = {8, 16, 32};
+  static constexpr u32 WORKGROUP_SIZES[] = {64, 128, 256, 512, 1024};
+  static constexpr u32 REPEATS = 2;
+
+  static constexpr const char *RESULTS_FILE = "autotune.txt";
+
+  Autotuner(Context *vk_context, GraphicsPipeline *pipeline, ResourceManager *resource_manager)
+    : vk_context{vk_context}, pipeline{pipeline}, resource_manager{resource_manager} {}
+
+  [[nodiscard]]
+  GridConfig select(const GridConfig &config) {
+    if(config.autotune) {
+      const AutotuneResult result = run();
+      save(cache_path(RESULTS_FILE), vk_context->get_device_uuid(), result);
+      return tuned(config, result);
+    }
+    if(config.sizes_from_args) {
+      return config;
+    }
+
+    const std::optional<AutotuneResult> stored = load(cache_path(RESULTS_FILE), vk_context->get_device_uuid());
+    if(!stored.has_value()) {
+      return config;
+    }
+
+    // Results stored by an older build may break its checks.
+    const GridConfig stored_config = tuned(config, stored.value());
+    try {
+      stored_config.apply(vk_context->get_limits(), vk_context->get_shader_subgroup_size());
+    }
+    catch(const std::runtime_error &error) {
+      std::cout << "AUTOTUNE ignoring stored settings for " << vk_context->get_device_name() << ": " << error.what() << std::endl;
+      return config;
+    }
+    std::cout << "AUTOTUNE using stored settings for " << vk_context->get_device_name() << std::endl;
+    return stored_config;
+  }
+
+  // Times every candidate the device can run, the grid globals are left
+  // at the last candidate's values.
+  [[nodiscard]]
+  AutotuneResult run(void) {
+    std::optional<AutotuneResult> best;
+
+    for(const i32 side : CHUNK_SIDES) {
+    for(const u32 workgroup_size : WORKGROUP_SIZES) {
+      const GridConfig candidate{
+        .voxels_per_chunk = int3{side},
+        .chunks_per_axis = int3{WORLD_VOXELS / side},
+        .workgroup_size = workgroup_size,
+      };
+      if(workgroup_size > static_cast<u32>(side*side*side)) {
+        continue;
+      }
+      try {
+        candidate.apply(vk_context->get_limits(), vk_context->get_shader_subgroup_size());
+      }
+      catch(const std::runtime_error &error) {
+        std::cout << "AUTOTUNE skipping " << side << "^3 x " << workgroup_size << ": " << error.what() << std::endl;
+        continue;
+      }
+
+      // A candidate whose terrain does not fit is skipped, not timed.
+      AutotuneResult result{};
+      try {
+        result = measure(candidate);
+      }
+      catch(const std::runtime_error &error) {
+        vkDeviceWaitIdle(vk_context->get_device());
+        std::cout << "AUTOTUNE skipping " << side << "^3 x " << workgroup_size << ": " << error.what() << std::endl;
+        continue;
+      }
+      std::cout << "AUTOTUNE " << side << "^3 chunks, " << workgroup_size << " invocations: "
+                << result.generation_ms << " ms generation, " << result.meshing_ms << " ms meshing" << std::endl;
+
+      if(!best.has_value() ||
+         result.generation_ms + result.meshing_ms < best->generation_ms + best->meshing_ms) {
+        best = result;
+      }
+    }
+    }
+
+    if(!best.has_value()) {
+      throw std::runtime_error("No autotuning candidate runs on this device!");
+    }
+    std::cout << "AUTOTUNE best " << best->voxels_per_chunk.x << "^3 chunks, "
+              << best->workgroup_size << " invocations" << std::endl;
+    return best.value();
+  }
+
+  // Lines of "uuid x y z workgroup generation_ms meshing_ms".
+  [[nodiscard]]
+  static std::optional<AutotuneResult> load(const std::string &path, const std::string &uuid) {
+    std::ifstream file(path);
+    std::string line;
+    while(std::getline(file, line)) {
+      std::istringstream fields(line);
+      std::string line_uuid;
+      AutotuneResult result{};
+      if(fields >> line_uuid >> result.voxels_per_chunk.x >> result.voxels_per_chunk.y >> result.voxels_per_chunk.z
+                >> result.workgroup_size >> result.generation_ms >> result.meshing_ms && line_uuid == uuid) {
+        return result;
+      }
+    }
+    return std::nullopt;
+  }
+
+  // Replaces the device's line and keeps every other device's.
+  static void save(const std::string &path, const std::string &uuid, const AutotuneResult &result) {
+    std::vector<std::string> lines;
+    {
+      std::ifstream file(path);
+      std::string line;
+      while(std::getline(file, line)) {
+        if(line.rfind(uuid + " ", 0) != 0) {
+          lines.push_back(line);
+        }
+      }
+    }
+
+    std::ofstream file(path, std::ios::trunc);
+    if(!file.is_open()) {
+      throw std::runtime_error("Failed to open " + path + " for writing!");
+    }
+    for(const std::string &line : lines) {
+      file << line << "\n";
+    }
+    file << uuid << " "
+         << result.voxels_per_chunk.x << " " << result.voxels_per_chunk.y << " " << result.voxels_per_chunk.z << " "
+         << result.workgroup_size << " " << result.generation_ms << " " << result.meshing_ms << "\n";
+  }
+
+  // The tuned sizes, with as many chunks as keep the world's extent.
+  [[nodiscard]]
+  static GridConfig tuned(GridConfig config, const AutotuneResult &result) {
+    const int3 world_voxels = config.chunks_per_axis*config.voxels_per_chunk;
+    config.voxels_per_chunk = result.voxels_per_chunk;
+    config.chunks_per_axis = glm::max((world_voxels + result.voxels_per_chunk - 1) / result.voxels_per_chunk, int3{1});
+    config.workgroup_size = result.workgroup_size;
+    return config;
+  }
+
+  private:
+  // Best of REPEATS fresh worlds, so every run pays the same first-touch costs.
+  [[nodiscard]]
+  AutotuneResult measure(const GridConfig &candidate) {
+    AutotuneResult result{
+      .voxels_per_chunk = candidate.voxels_per_chunk,
+      .workgroup_size = WORKGROUP_SIZE,
+      .generation_ms = std::numeric_limits<f64>::max(),
+      .meshing_ms = std::numeric_limits<f64>::max(),
+    };
+
+    for(u32 repeat = 0; repeat < REPEATS; repeat++) {
+      EventBus event_bus{};
+
+      TimestampTimer generation_timer{vk_context, 1};
+      TimestampTimer meshing_timer{vk_context, static_cast<u32>(COUNT_CHUNKS_Y*COUNT_CHUNKS_Z)};
+
+      TerrainManager terrain{vk_context, &event_bus, pipeline, resource_manager};
+      terrain.set_timers(&generation_timer, &meshing_timer);
+      event_bus.notify<IsosurfaceGenerationEvent>(IsosurfaceGenerationEvent{.progress = int3{0}});
+      event_bus.notify<IsosurfaceMeshingEvent>(IsosurfaceMeshingEvent{.progress = int3{0}});
+
+      result.generation_ms = glm::min(result.generation_ms, generation_timer.resolve_ms());
+      result.meshing_ms = glm::min(result.meshing_ms, meshing_timer.resolve_ms());
+    }
+    return result;
+  }
+
+  Context *vk_context;
+  GraphicsPipeline *pipeline;
+  ResourceManager *resource_manager;
+};
+
+}
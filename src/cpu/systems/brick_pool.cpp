@@ -0,0 +1 @@
+#include "brick_pool.hpp"
\ No newline at end of file
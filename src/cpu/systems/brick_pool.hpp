@@ -0,0 +1,80 @@
+#pragma once
+
+#include <push.inl>
+
+#include <glm/glm.hpp>
+
+#include <optional>
+#include <vector>
+
+namespace tmx {
+
+// Host side of the sparse voxel store: a free list of chunk-sized bricks
+// in the voxel pool and the page table that maps chunks onto them.
+// Chunks without a brick hold a uniform sentinel instead.
+struct BrickPool {
+  public:
+  BrickPool(u32 *page_table, const u32 capacity) : page_table{page_table}, capacity{capacity} {
+    free_slots.reserve(capacity);
+    for(u32 slot = capacity; slot-- > 0;) {
+      free_slots.push_back(slot);
+    }
+    for(u32 chunk = 0; chunk < COUNT_CHUNKS; chunk++) {
+      page_table[chunk] = PAGE_UNIFORM_OUTSIDE;
+    }
+  }
+
+  ~BrickPool(void) = default;
+
+  // Gives the chunk a brick if it does not have one yet.
+  // Returns the brick, or nullopt when the pool is exhausted.
+  std::optional<u32> make_resident(const int3 chunk) {
+    u32 &page = page_table[chunk2idx(chunk)];
+    if(page_resident(page)) {
+      return page;
+    }
+    if(free_slots.empty()) {
+      return std::nullopt;
+    }
+    page = free_slots.back();
+    free_slots.pop_back();
+    return page;
+  }
+
+  // Releases the chunk's brick, its voxels become sentinel's uniform density.
+  void make_uniform(const int3 chunk, const u32 sentinel) {
+    u32 &page = page_table[chunk2idx(chunk)];
+    if(page_resident(page)) {
+      free_slots.push_back(page);
+    }
+    page = sentinel;
+  }
+
+  // Adds the slots [capacity, new_capacity) once the voxel pool has been
+  // reallocated to hold them. Resident bricks keep their slots.
+  void grow(const u32 new_capacity) {
+    for(u32 slot = new_capacity; slot-- > capacity;) {
+      free_slots.push_back(slot);
+    }
+    capacity = glm::max(capacity, new_capacity);
+  }
+
+  [[nodiscard]] inline
+  u32 page(const int3 chunk) const { return page_table[chunk2idx(chunk)]; }
+
+  [[nodiscard]] inline
+  u32 resident_count(void) const { return capacity - static_cast<u32>(free_slots.size()); }
+
+  [[nodiscard]] inline
+  u32 free_count(void) const { return static_cast<u32>(free_slots.size()); }
+
+  [[nodiscard]] inline
+  u32 slot_count(void) const { return capacity; }
+
+  private:
+  u32 *page_table;
+  u32 capacity;
+  std::vector<u32> free_slots;
+};
+
+}
@@ -0,0 +1 @@
+#include "chunk_stats.hpp"
\ No newline at end of file
@@ -0,0 +1,169 @@
+#pragma once
+
+#include <push.inl>
+
+#include <algorithm>
+#include <array>
+#include <fstream>
+#include <iostream>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace tmx {
+
+// Percentiles of one ChunkStat counter over the chunks it applies to,
+// generation counters over generated chunks, meshing ones over meshed.
+struct ChunkStatPercentiles {
+  const char *name;
+  u32 chunks;
+  u32 p50;
+  u32 p90;
+  u32 p99;
+  u32 max;
+  // The chunk holding max, to find in the heatmap.
+  int3 max_chunk;
+};
+
+// Turns the per chunk counters of TerrainManager::get_chunk_stats into
+// percentiles and a legacy VTK volume, one point per chunk, for heatmaps
+// in ParaView or VisIt.
+struct ChunkStatsReport {
+  public:
+  static constexpr u32 COUNTER_COUNT = 9;
+
+  ChunkStatsReport(const ChunkStat *stats, const int3 chunks_per_axis) : chunks_per_axis{chunks_per_axis} {
+    const u32 chunk_count = static_cast<u32>(chunks_per_axis.x*chunks_per_axis.y*chunks_per_axis.z);
+    this->stats.assign(stats, stats + chunk_count);
+  }
+
+  [[nodiscard]]
+  std::array<ChunkStatPercentiles, COUNTER_COUNT> percentiles(void) const {
+    std::array<ChunkStatPercentiles, COUNTER_COUNT> result{};
+    for(u32 counter = 0; counter < COUNTER_COUNT; counter++) {
+      const bool meshing = counter >= MESHING_COUNTERS;
+      std::vector<u32> values;
+      u32 max_index{0};
+      for(u32 i = 0; i < stats.size(); i++) {
+        if((meshing ? stats[i].meshings : stats[i].generations) == 0) {
+          continue;
+        }
+        const u32 value = get(stats[i], counter);
+        if(values.empty() || value > get(stats[max_index], counter)) {
+          max_index = i;
+        }
+        values.push_back(value);
+      }
+
+      ChunkStatPercentiles &p = result[counter];
+      p.name = COUNTER_NAMES[counter];
+      p.chunks = static_cast<u32>(values.size());
+      if(values.empty()) {
+        continue;
+      }
+      std::sort(values.begin(), values.end());
+      p.p50 = values[values.size()*50/100];
+      p.p90 = values[values.size()*90/100];
+      p.p99 = values[values.size()*99/100];
+      p.max = values.back();
+      p.max_chunk = idx2chunk(max_index);
+    }
+    return result;
+  }
+
+  void print_report(void) const {
+    for(const ChunkStatPercentiles &p : percentiles()) {
+      if(p.chunks == 0) {
+        continue;
+      }
+      std::cout << "CHUNK " << p.name << ": " << p.p50 << " p50, " << p.p90 << " p90, " << p.p99 << " p99, "
+                << p.max << " max at (" << p.max_chunk.x << ", " << p.max_chunk.y << ", " << p.max_chunk.z << ") over "
+                << p.chunks << " chunks" << std::endl;
+    }
+  }
+
+  // One JSON object of counter name to percentiles, for the benchmarks.
+  void write_json(std::ostream &out) const {
+    out << "{";
+    bool first{true};
+    for(const ChunkStatPercentiles &p : percentiles()) {
+      out << (first ? "" : ",") << "\"" << p.name << "\":{"
+          << "\"chunks\":" << p.chunks
+          << ",\"p50\":" << p.p50
+          << ",\"p90\":" << p.p90
+          << ",\"p99\":" << p.p99
+          << ",\"max\":" << p.max
+          << ",\"max_chunk\":[" << p.max_chunk.x << "," << p.max_chunk.y << "," << p.max_chunk.z << "]}";
+      first = false;
+    }
+    out << "}";
+  }
+
+  // STRUCTURED_POINTS with x fastest, every counter a scalar field.
+  void export_vtk(const std::string &path) const {
+    std::ofstream file(path, std::ios::trunc);
+    if(!file.is_open()) {
+      throw std::runtime_error("Failed to open " + path + " for writing!");
+    }
+
+    const int3 voxels_per_chunk{COUNT_VOXELS_X, COUNT_VOXELS_Y, COUNT_VOXELS_Z};
+    file << "# vtk DataFile Version 3.0\n"
+         << "tmx chunk stats\n"
+         << "ASCII\n"
+         << "DATASET STRUCTURED_POINTS\n"
+         << "DIMENSIONS " << chunks_per_axis.x << " " << chunks_per_axis.y << " " << chunks_per_axis.z << "\n"
+         << "ORIGIN " << voxels_per_chunk.x/2 << " " << voxels_per_chunk.y/2 << " " << voxels_per_chunk.z/2 << "\n"
+         << "SPACING " << voxels_per_chunk.x << " " << voxels_per_chunk.y << " " << voxels_per_chunk.z << "\n"
+         << "POINT_DATA " << stats.size() << "\n";
+
+    for(u32 counter = 0; counter < COUNTER_COUNT; counter++) {
+      file << "SCALARS " << COUNTER_NAMES[counter] << " unsigned_int 1\n"
+           << "LOOKUP_TABLE default\n";
+      for(i32 z = 0; z < chunks_per_axis.z; z++) {
+      for(i32 y = 0; y < chunks_per_axis.y; y++) {
+      for(i32 x = 0; x < chunks_per_axis.x; x++) {
+        file << get(stats[chunk2idx(int3{x, y, z})], counter) << (x + 1 < chunks_per_axis.x ? " " : "\n");
+      }
+      }
+      }
+    }
+    std::cout << "Chunk stats of " << stats.size() << " chunks written to " << path << std::endl;
+  }
+
+  private:
+  // Counters from here on belong to meshing.
+  static constexpr u32 MESHING_COUNTERS = 3;
+
+  inline static const char *const COUNTER_NAMES[COUNTER_COUNT] = {
+    "generations",
+    "noise_voxels",
+    "generation_clocks",
+    "meshings",
+    "nonempty_cells",
+    "vertices",
+    "alloc_spins",
+    "alloc_probes",
+    "meshing_clocks",
+  };
+
+  [[nodiscard]]
+  static u32 get(const ChunkStat &stat, const u32 counter) {
+    switch(counter) {
+      case 0: return stat.generations;
+      case 1: return stat.noise_voxels;
+      case 2: return stat.generation_clocks;
+      case 3: return stat.meshings;
+      case 4: return stat.nonempty_cells;
+      case 5: return stat.vertices;
+      case 6: return stat.alloc_spins;
+      case 7: return stat.alloc_probes;
+      default: return stat.meshing_clocks;
+    }
+  }
+
+  std::vector<ChunkStat> stats;
+  int3 chunks_per_axis;
+};
+
+}
@@ -0,0 +1 @@
+#include "cpu_mesher.hpp"
\ No newline at end of file
@@ -0,0 +1,254 @@
+#pragma once
+
+#include <push.inl>
+
+#include "../core/thread_pool.hpp"
+#include "../core/paths.hpp"
+#include "density_bounds.hpp"
+
+#include <glm/glm.hpp>
+
+#include <array>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace tmx {
+
+// One chunk of the CPU world. Chunks that cannot hold surface keep a
+// uniform sentinel page and no voxels, like the GPU brick pool.
+struct CpuChunk {
+  u32 page{PAGE_UNIFORM_OUTSIDE};
+  std::vector<DensityCode> voxels;
+  std::vector<float4> vertices;
+};
+
+// Generates and meshes the world on the CPU with the same density, chunk
+// skipping and marching cubes tables as the compute shaders, for machines
+// without a usable GPU and as a reference for the GPU output. Vertices
+// match emit_cell(), each chunk lists its cells in idx2voxel order.
+struct CpuMesher {
+  public:
+  static constexpr const char *LUT_FILE = "MarchingCubesLUT.bin";
+  static constexpr const char *VERTEX_COUNT_LUT_FILE = "MarchingCubesVertexCountLUT.bin";
+
+  // Side of the boxes generation bounds before evaluating their voxels,
+  // BOX_VOXELS in isosurface_generation.comp.
+  static constexpr i32 BOX_VOXELS = 2;
+
+  explicit CpuMesher(ThreadPool *thread_pool = nullptr) : thread_pool{thread_pool} {
+    const std::vector<char> configurations = read_file(asset_path(LUT_FILE));
+    const std::vector<char> vertex_counts = read_file(asset_path(VERTEX_COUNT_LUT_FILE));
+    if(configurations.size() < 256*15 || vertex_counts.size() < 256) {
+      throw std::runtime_error("The marching cubes tables are truncated!");
+    }
+
+    for(u32 i = 0; i < 256*15; i++) {
+      lut_configurations[i] = static_cast<i8>(configurations[i]);
+    }
+    for(u32 i = 0; i < 256; i++) {
+      lut_vertex_counts[i] = static_cast<u8>(vertex_counts[i]);
+    }
+  }
+
+  // Fills every chunk of the current grid, see GridConfig::apply.
+  void generate(void) {
+    chunks.assign(COUNT_CHUNKS, CpuChunk{});
+    for_each_chunk([this](const u32 index) { generate_chunk(idx2chunk(index)); });
+  }
+
+  // Meshes every chunk, generate() has to have run on the same grid.
+  void mesh(void) {
+    for_each_chunk([this](const u32 index) { mesh_chunk(idx2chunk(index)); });
+  }
+
+  // Stored density of a world-space voxel, load_density() in density.glsl.
+  [[nodiscard]]
+  f32 load_density(const int3 voxel) const {
+    if(!voxel_in_world(voxel)) return static_cast<f32>(DENSITY_OUTSIDE_WORLD);
+    const CpuChunk &chunk = chunks[chunk2idx(voxel_chunk(voxel))];
+    if(!page_resident(chunk.page)) return page_uniform_density(chunk.page);
+    return decode_density(chunk.voxels[voxel2idx(voxel_local(voxel))]);
+  }
+
+  [[nodiscard]] inline
+  const CpuChunk &chunk(const int3 chunk_pos) const { return chunks[chunk2idx(chunk_pos)]; }
+
+  [[nodiscard]]
+  u32 resident_count(void) const {
+    u32 count{0};
+    for(const CpuChunk &chunk : chunks) {
+      count += page_resident(chunk.page) ? 1 : 0;
+    }
+    return count;
+  }
+
+  [[nodiscard]]
+  u64 vertex_count(void) const {
+    u64 count{0};
+    for(const CpuChunk &chunk : chunks) {
+      count += chunk.vertices.size();
+    }
+    return count;
+  }
+
+  // Bytes held by voxels and vertices.
+  [[nodiscard]]
+  u64 size_bytes(void) const {
+    u64 bytes{0};
+    for(const CpuChunk &chunk : chunks) {
+      bytes += chunk.voxels.capacity()*sizeof(DensityCode) + chunk.vertices.capacity()*sizeof(float4);
+    }
+    return bytes;
+  }
+
+  private:
+  template<typename Fn>
+  void for_each_chunk(Fn &&fn) {
+    const auto range = [&fn](const u32 begin, const u32 end) {
+      for(u32 i = begin; i < end; i++) {
+        fn(i);
+      }
+    };
+    if(thread_pool != nullptr) {
+      thread_pool->parallel_for(COUNT_CHUNKS, 1, range);
+    }
+    else {
+      range(0, COUNT_CHUNKS);
+    }
+  }
+
+  void generate_chunk(const int3 chunk_pos) {
+    CpuChunk &chunk = chunks[chunk2idx(chunk_pos)];
+
+    const i32 density_class = DensityBounds::classify_chunk(chunk_pos);
+    if(density_class != DENSITY_CLASS_SURFACE) {
+      chunk.page = density_class == DENSITY_CLASS_INSIDE ? PAGE_UNIFORM_INSIDE : PAGE_UNIFORM_OUTSIDE;
+      return;
+    }
+
+    const int3 chunk_origin = chunk_pos*int3{COUNT_VOXELS_X, COUNT_VOXELS_Y, COUNT_VOXELS_Z};
+    chunk.page = 0;
+    chunk.voxels.resize(COUNT_VOXELS);
+
+    for(i32 bz = 0; bz < COUNT_VOXELS_Z; bz += BOX_VOXELS) {
+    for(i32 by = 0; by < COUNT_VOXELS_Y; by += BOX_VOXELS) {
+    for(i32 bx = 0; bx < COUNT_VOXELS_X; bx += BOX_VOXELS) {
+      const int3 box_pos = chunk_origin + int3{bx, by, bz};
+      const i32 box_class = DensityBounds::classify_bound(box_pos, box_pos + BOX_VOXELS - 1);
+
+      for(i32 z = 0; z < BOX_VOXELS; z++) {
+      for(i32 y = 0; y < BOX_VOXELS; y++) {
+      for(i32 x = 0; x < BOX_VOXELS; x++) {
+        const int3 local{bx + x, by + y, bz + z};
+        chunk.voxels[voxel2idx(local)] = encode_density(
+          box_class == DENSITY_CLASS_OUTSIDE ?  static_cast<f32>(DENSITY_BAND) :
+          box_class == DENSITY_CLASS_INSIDE  ? -static_cast<f32>(DENSITY_BAND) :
+          DensityBounds::evaluate(float3{chunk_origin + local}));
+      }
+      }
+      }
+    }
+    }
+    }
+
+    // The bound is conservative, release chunks that turned out uniform.
+    for(const f32 band : {static_cast<f32>(DENSITY_BAND), -static_cast<f32>(DENSITY_BAND)}) {
+      const DensityCode code = encode_density(band);
+      bool uniform{true};
+      for(const DensityCode voxel : chunk.voxels) {
+        uniform &= voxel == code;
+      }
+      if(uniform) {
+        chunk.page = band > 0.0f ? PAGE_UNIFORM_OUTSIDE : PAGE_UNIFORM_INSIDE;
+        chunk.voxels = {};
+        return;
+      }
+    }
+  }
+
+  // Cells read the chunk's voxels and those of its upper neighbours, they
+  // are all empty when every one of those chunks holds the same sentinel.
+  [[nodiscard]]
+  bool cells_uniform(const int3 chunk_pos) const {
+    u32 first{PAGE_UNIFORM_OUTSIDE};
+    for(i32 i = 0; i < 8; i++) {
+      const int3 neighbour = chunk_pos + int3{i & 1, (i >> 1) & 1, (i >> 2) & 1};
+      const bool in_world = glm::all(glm::lessThan(neighbour, int3{COUNT_CHUNKS_X, COUNT_CHUNKS_Y, COUNT_CHUNKS_Z}));
+      const u32 page = in_world ? chunks[chunk2idx(neighbour)].page : PAGE_UNIFORM_OUTSIDE;
+      if(page_resident(page) || (i > 0 && page != first)) {
+        return false;
+      }
+      first = i == 0 ? page : first;
+    }
+    return true;
+  }
+
+  void mesh_chunk(const int3 chunk_pos) {
+    CpuChunk &chunk = chunks[chunk2idx(chunk_pos)];
+    chunk.vertices.clear();
+    if(cells_uniform(chunk_pos)) {
+      return;
+    }
+
+    const int3 chunk_origin = chunk_pos*int3{COUNT_VOXELS_X, COUNT_VOXELS_Y, COUNT_VOXELS_Z};
+    for(u32 c = 0; c < static_cast<u32>(COUNT_VOXELS); c++) {
+      const int3 voxel_pos = chunk_origin + idx2voxel(c);
+
+      std::array<f32, 8> corner_density;
+      i32 voxel_index{0};
+      for(i32 i = 0; i < 8; i++) {
+        corner_density[i] = load_density(voxel_pos + POINTS[i]);
+        if(corner_density[i] < 0.0f) voxel_index |= 1 << i;
+      }
+      if(voxel_index == 0 || voxel_index == 255) {
+        continue;
+      }
+
+      const u32 vertex_count = lut_vertex_counts[voxel_index];
+      for(u32 i = 0; i < vertex_count; i++) {
+        const i32 t = lut_configurations[i + voxel_index*15];
+        if(t < 0) break;
+
+        const i32 e0 = EDGES[t].x;
+        const i32 e1 = EDGES[t].y;
+        const f32 d0 = corner_density[e0];
+        const f32 d1 = corner_density[e1];
+        const float3 vertex = glm::mix(float3{voxel_pos + POINTS[e0]}, float3{voxel_pos + POINTS[e1]}, d0 / (d0 - d1));
+        chunk.vertices.push_back(float4{vertex, static_cast<f32>(voxel_index)/255.0f});
+      }
+    }
+  }
+
+  [[nodiscard]]
+  static std::vector<char> read_file(const std::string &path) {
+    std::ifstream file(path, std::ios::ate | std::ios::binary);
+    if(!file.is_open()) {
+      throw std::runtime_error("Failed to open " + path + "!");
+    }
+    std::vector<char> bytes(static_cast<size_t>(file.tellg()));
+    file.seekg(0);
+    file.read(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+    return bytes;
+  }
+
+  // The tables TerrainManager uploads for the meshing shader.
+  inline static const int2 EDGES[12] = {
+    int2{0, 1}, int2{1, 2}, int2{2, 3}, int2{3, 0},
+    int2{4, 5}, int2{5, 6}, int2{6, 7}, int2{7, 4},
+    int2{0, 4}, int2{1, 5}, int2{2, 6}, int2{3, 7},
+  };
+
+  inline static const int3 POINTS[8] = {
+    int3{0, 0, 0}, int3{0, 0, 1}, int3{1, 0, 1}, int3{1, 0, 0},
+    int3{0, 1, 0}, int3{0, 1, 1}, int3{1, 1, 1}, int3{1, 1, 0},
+  };
+
+  ThreadPool *thread_pool;
+  std::vector<CpuChunk> chunks;
+  std::array<i32, 256*15> lut_configurations{};
+  std::array<u32, 256> lut_vertex_counts{};
+};
+
+}
@@ -0,0 +1 @@
+#include "density_bounds.hpp"
\ No newline at end of file
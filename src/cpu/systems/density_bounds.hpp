@@ -0,0 +1,129 @@
+#pragma once
+
+#include <push.inl>
+
+#include "../noise/simplex.hpp"
+
+#include <glm/glm.hpp>
+
+namespace tmx {
+
+// CPU mirror of fbm(), evaluate() and fbm_bound() in density.glsl, used to
+// prove that a chunk cannot contain the surface before any of its voxels are
+// generated.
+// A region's bound is its value at the center plus the FBM's Lipschitz
+// constant times its radius; regions that straddle zero are split down to
+// MIN_BOX_VOXELS before giving up.
+struct DensityBounds {
+  public:
+  static constexpr i32 MIN_BOX_VOXELS = 2;
+
+  // Slack for rounding differences between this port and the GPU noise.
+  static constexpr f32 MARGIN = 1e-3f;
+
+  [[nodiscard]]
+  static f32 fbm(const float3 world_pos) {
+    f32 density{0.0f};
+    for(i32 i = 0; i < DENSITY_OCTAVES; i++) {
+      density += simplex::snoise(density_seed_offset(DENSITY_SEED) + world_pos * static_cast<f32>(DENSITY_FREQUENCY) * OCTAVE_SCALE[i] + OCTAVE_OFFSET[i]) * OCTAVE_AMPLITUDE[i];
+    }
+    return density;
+  }
+
+  // Distance estimate in voxels, evaluate() in density.glsl.
+  [[nodiscard]]
+  static f32 evaluate(const float3 world_pos) {
+    return glm::clamp(
+      fbm(world_pos) / static_cast<f32>(DENSITY_LIPSCHITZ),
+      -static_cast<f32>(DENSITY_BAND),
+      static_cast<f32>(DENSITY_BAND)
+    );
+  }
+
+  [[nodiscard]]
+  static float2 fbm_bound(const float3 center, const f32 radius) {
+    float2 bound{0.0f};
+    for(i32 i = 0; i < DENSITY_OCTAVES; i++) {
+      const f32 frequency = static_cast<f32>(DENSITY_FREQUENCY) * OCTAVE_SCALE[i];
+      const f32 n = simplex::snoise(density_seed_offset(DENSITY_SEED) + center * frequency + OCTAVE_OFFSET[i]);
+      const f32 reach = static_cast<f32>(SNOISE_LIPSCHITZ) * frequency * radius;
+      bound += OCTAVE_AMPLITUDE[i] * float2{
+        glm::max(n - reach, -static_cast<f32>(SNOISE_AMPLITUDE)),
+        glm::min(n + reach,  static_cast<f32>(SNOISE_AMPLITUDE)),
+      };
+    }
+    return bound;
+  }
+
+  // Classifies the voxels in [lo, hi] (inclusive, world space) from a
+  // single bound over the whole region. By default a region is only
+  // uniform when every voxel is stored clamped to the density band, pass
+  // a threshold of 0 to classify by sign alone.
+  [[nodiscard]]
+  static i32 classify_bound(const int3 lo, const int3 hi, const f32 threshold = static_cast<f32>(DENSITY_SATURATION)) {
+    const float3 center = float3{lo + hi} * 0.5f;
+    const f32 radius = glm::length(float3{hi - lo}) * 0.5f;
+    const float2 bound = fbm_bound(center, radius);
+
+    if(bound.x > threshold + MARGIN) return DENSITY_CLASS_OUTSIDE;
+    if(bound.y < -threshold - MARGIN) return DENSITY_CLASS_INSIDE;
+    return DENSITY_CLASS_SURFACE;
+  }
+
+  // Classifies the voxels in [lo, hi] (inclusive, world space).
+  [[nodiscard]]
+  static i32 classify(const int3 lo, const int3 hi, const f32 threshold = static_cast<f32>(DENSITY_SATURATION)) {
+    const i32 bound_class = classify_bound(lo, hi, threshold);
+    if(bound_class != DENSITY_CLASS_SURFACE) return bound_class;
+
+    const int3 extent = hi - lo + 1;
+    if(glm::all(glm::lessThanEqual(extent, int3{MIN_BOX_VOXELS}))) {
+      return DENSITY_CLASS_SURFACE;
+    }
+
+    // Split every axis longer than the minimum box in half.
+    i32 result{-1};
+    for(i32 i = 0; i < 8; i++) {
+      int3 child_lo{lo}, child_hi{hi};
+      bool skip{false};
+      for(i32 a = 0; a < 3; a++) {
+        const bool upper = (i >> a) & 1;
+        if(extent[a] <= MIN_BOX_VOXELS) {
+          skip |= upper;
+          continue;
+        }
+        const i32 mid = lo[a] + extent[a]/2;
+        child_lo[a] = upper ? mid : lo[a];
+        child_hi[a] = upper ? hi[a] : mid - 1;
+      }
+      if(skip) continue;
+
+      const i32 child = classify(child_lo, child_hi, threshold);
+      if(child == DENSITY_CLASS_SURFACE || (result >= 0 && child != result)) {
+        return DENSITY_CLASS_SURFACE;
+      }
+      result = child;
+    }
+
+    return result;
+  }
+
+  // A chunk is uniform when the sign cannot change within one voxel of it.
+  // No edge that crosses the surface then touches its voxels, so storing
+  // them as the clamped band value moves no vertex, and far more chunks
+  // pass than when every voxel has to be proven clamped.
+  [[nodiscard]] inline
+  static i32 classify_chunk(const int3 chunk) {
+    const int3 voxels_per_chunk{COUNT_VOXELS_X, COUNT_VOXELS_Y, COUNT_VOXELS_Z};
+    const int3 lo = chunk*voxels_per_chunk;
+    return classify(lo - 1, lo + voxels_per_chunk, 0.0f);
+  }
+
+  private:
+  // Kept in sync with the octave tables in density.glsl.
+  static constexpr f32 OCTAVE_SCALE[DENSITY_OCTAVES]     = {1.0f, 2.0f, 4.0f, 16.0f};
+  static constexpr f32 OCTAVE_OFFSET[DENSITY_OCTAVES]    = {0.0f, 2.85f, 7.45f, 24.95f};
+  static constexpr f32 OCTAVE_AMPLITUDE[DENSITY_OCTAVES] = {1.0f, 0.5f, 0.25f, 0.0625f};
+};
+
+}
@@ -0,0 +1 @@
+#include "terrain_collision.hpp"
\ No newline at end of file
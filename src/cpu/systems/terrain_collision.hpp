@@ -0,0 +1,796 @@
+#pragma once
+
+#include <push.inl>
+
+#include "../core/event_bus.hpp"
+#include "../core/events.hpp"
+#include "../core/thread_pool.hpp"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <bit>
+#include <limits>
+#include <span>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#define TMX_COLLISION_SSE
+#endif
+
+namespace tmx {
+
+struct RaycastQuery {
+  float3 origin;
+  float3 dir;
+  f32 max_distance;
+};
+
+struct SphereOverlapQuery {
+  float3 center;
+  f32 radius;
+};
+
+// Capsule between a and b translated by displacement.
+struct CapsuleSweepQuery {
+  float3 a;
+  float3 b;
+  f32 radius;
+  float3 displacement;
+};
+
+// t is the ray distance for raycasts, the fraction of the displacement
+// for sweeps and the penetration depth for overlaps.
+struct CollisionHit {
+  float3 position;
+  float3 normal;
+  int3 chunk;
+  f32 t;
+  bool hit;
+};
+
+// Four triangles in SoA layout, stored as v0 and the edges v1 - v0, v2 - v0.
+// Unused lanes are degenerate and masked out by count.
+struct alignas(16) TrianglePacket {
+  f32 v0[3][4];
+  f32 e1[3][4];
+  f32 e2[3][4];
+  u32 count;
+  u32 pad[3];
+};
+
+// Inner nodes keep their left child right after themselves and the right
+// child in offset. Leaves reference count packets starting at offset.
+struct BvhNode {
+  float3 lo;
+  u32 offset;
+  float3 hi;
+  u32 count;
+};
+
+struct ChunkBvh {
+  std::vector<BvhNode> nodes;
+  std::vector<TrianglePacket> packets;
+  // Source triangle of every packet lane, INVALID_TRIANGLE for padding.
+  std::vector<u32> order;
+  u32 triangle_count{0};
+
+  [[nodiscard]] inline
+  bool empty(void) const { return triangle_count == 0; }
+};
+
+// CPU collision against the meshed terrain. Every chunk owns a triangle BVH
+// built from the marching cubes output; remeshed chunks are refit when their
+// triangle count is unchanged and rebuilt otherwise. Queries are batched and
+// split across the thread pool; updates must not overlap with queries.
+struct TerrainCollision {
+  public:
+  static constexpr u32 INVALID_TRIANGLE = 0xFFFFFFFF;
+  static constexpr u32 LEAF_TRIANGLES = 8;
+  static constexpr u32 QUERY_GRAIN = 64;
+
+  TerrainCollision(EventBus *event_bus, ThreadPool *thread_pool) : thread_pool{thread_pool} {
+    chunks.resize(COUNT_CHUNKS);
+    if(event_bus != nullptr) {
+      event_bus->add<IsosurfaceRemeshedEvent>(this, &TerrainCollision::remeshed);
+    }
+  }
+
+  ~TerrainCollision(void) = default;
+
+  void remeshed(const std::any &e) {
+    const auto &event = std::any_cast<const IsosurfaceRemeshedEvent &>(e);
+    const u32 count = event.chunks != nullptr ? event.chunk_count : COUNT_CHUNKS;
+
+    thread_pool->parallel_for(count, 4, [&](u32 begin, u32 end) {
+      for(u32 i = begin; i < end; i++) {
+        const int3 chunk = event.chunks != nullptr ? int3{event.chunks[i]} : idx2chunk(i);
+        const uint2 info = event.chunk_draw_info[chunk2idx(chunk)];
+        if(info.x == 0 || info.y == 0) {
+          update_chunk(chunk, nullptr, 0);
+        }
+        else {
+          update_chunk(chunk, event.vertices + event.indirect[info.x - 1].firstVertex, info.y);
+        }
+      }
+    });
+  }
+
+  // Replaces the triangles of one chunk with vertex_count/3 triangles.
+  void update_chunk(const int3 chunk, const float4 *vertices, const u32 vertex_count) {
+    ChunkBvh &bvh = chunks[chunk2idx(chunk)];
+    const u32 triangle_count = vertex_count / 3;
+
+    if(triangle_count == 0) {
+      bvh = ChunkBvh{};
+      return;
+    }
+
+    if(triangle_count == bvh.triangle_count) {
+      refit(bvh, vertices);
+    }
+    else {
+      rebuild(bvh, vertices, triangle_count);
+    }
+  }
+
+  void raycast(std::span<const RaycastQuery> queries, std::span<CollisionHit> hits) const {
+    thread_pool->parallel_for(static_cast<u32>(queries.size()), QUERY_GRAIN, [&](u32 begin, u32 end) {
+      for(u32 i = begin; i < end; i++) {
+        hits[i] = raycast(queries[i]);
+      }
+    });
+  }
+
+  void overlap_sphere(std::span<const SphereOverlapQuery> queries, std::span<CollisionHit> hits) const {
+    thread_pool->parallel_for(static_cast<u32>(queries.size()), QUERY_GRAIN, [&](u32 begin, u32 end) {
+      for(u32 i = begin; i < end; i++) {
+        hits[i] = overlap_sphere(queries[i]);
+      }
+    });
+  }
+
+  void sweep_capsule(std::span<const CapsuleSweepQuery> queries, std::span<CollisionHit> hits) const {
+    thread_pool->parallel_for(static_cast<u32>(queries.size()), QUERY_GRAIN, [&](u32 begin, u32 end) {
+      for(u32 i = begin; i < end; i++) {
+        hits[i] = sweep_capsule(queries[i]);
+      }
+    });
+  }
+
+  [[nodiscard]]
+  CollisionHit raycast(const RaycastQuery &query) const {
+    CollisionHit result{};
+    const float3 dir = glm::normalize(query.dir);
+    const float3 inv_dir = 1.0f / dir;
+
+    f32 t_enter{0.0f}, t_exit{query.max_distance};
+    if(!clip(query.origin, inv_dir, float3{0.0f}, float3{world_voxels}, t_enter, t_exit)) {
+      return result;
+    }
+
+    // Triangles never leave the box of the chunk that meshed them,
+    // so the first chunk along the ray with a hit holds the closest one.
+    const float3 chunk_size{voxels_per_chunk};
+    const float3 entry = query.origin + dir*t_enter;
+    int3 chunk = glm::clamp(int3{glm::floor(entry / chunk_size)}, int3{0}, chunks_per_axis - 1);
+    const int3 step = int3{glm::sign(dir)};
+    float3 t_max{std::numeric_limits<f32>::max()};
+    for(i32 a = 0; a < 3; a++) {
+      if(step[a] == 0) continue;
+      const f32 boundary = (chunk[a] + (step[a] > 0 ? 1 : 0))*chunk_size[a];
+      t_max[a] = (boundary - query.origin[a])*inv_dir[a];
+    }
+    const float3 t_delta = glm::abs(chunk_size*inv_dir);
+
+    while(glm::all(glm::greaterThanEqual(chunk, int3{0})) && glm::all(glm::lessThan(chunk, chunks_per_axis))) {
+      const ChunkBvh &bvh = chunks[chunk2idx(chunk)];
+      f32 t_best = t_exit;
+      u32 packet{0}, lane{0};
+      if(!bvh.empty() && raycast_bvh(bvh, query.origin, dir, inv_dir, t_best, packet, lane)) {
+        const TrianglePacket &p = bvh.packets[packet];
+        float3 n = glm::cross(edge(p.e1, lane), edge(p.e2, lane));
+        n = glm::normalize(glm::dot(n, dir) > 0.0f ? -n : n);
+        return CollisionHit{query.origin + dir*t_best, n, chunk, t_best, true};
+      }
+
+      const i32 a = t_max.x < t_max.y ? (t_max.x < t_max.z ? 0 : 2) : (t_max.y < t_max.z ? 1 : 2);
+      if(t_max[a] > t_exit) {
+        break;
+      }
+      t_max[a] += t_delta[a];
+      chunk[a] += step[a];
+    }
+
+    return result;
+  }
+
+  [[nodiscard]]
+  CollisionHit overlap_sphere(const SphereOverlapQuery &query) const {
+    CollisionHit result{};
+    f32 best = query.radius*query.radius;
+
+    const float3 lo = query.center - query.radius;
+    const float3 hi = query.center + query.radius;
+
+    for_each_triangle(lo, hi, [&](const int3 chunk, const TrianglePacket &p, const u32 mask) {
+      u32 lanes = mask & plane_mask(p, query.center, query.radius);
+      while(lanes != 0) {
+        const u32 lane = first_lane(lanes);
+        lanes &= lanes - 1;
+
+        const float3 a = edge(p.v0, lane);
+        const float3 point = closest_point_triangle(query.center, a, a + edge(p.e1, lane), a + edge(p.e2, lane));
+        const float3 delta = query.center - point;
+        const f32 distance2 = glm::dot(delta, delta);
+        if(distance2 <= best) {
+          best = distance2;
+          result = CollisionHit{point, contact_normal(delta, p, lane), chunk, 0.0f, true};
+        }
+      }
+    });
+
+    if(result.hit) {
+      result.t = query.radius - glm::sqrt(best);
+    }
+    return result;
+  }
+
+  // Conservative advancement: the capsule moves by the current separation
+  // each step, which cannot tunnel through static triangles.
+  [[nodiscard]]
+  CollisionHit sweep_capsule(const CapsuleSweepQuery &query) const {
+    constexpr i32 MAX_ITERATIONS = 32;
+    constexpr f32 EPSILON = 1e-3f;
+
+    CollisionHit result{};
+    const float3 lo = glm::min(glm::min(query.a, query.b), glm::min(query.a, query.b) + query.displacement) - query.radius;
+    const float3 hi = glm::max(glm::max(query.a, query.b), glm::max(query.a, query.b) + query.displacement) + query.radius;
+
+    struct Candidate { float3 a, b, c; int3 chunk; };
+    std::vector<Candidate> candidates;
+    for_each_triangle(lo, hi, [&](const int3 chunk, const TrianglePacket &p, u32 lanes) {
+      while(lanes != 0) {
+        const u32 lane = first_lane(lanes);
+        lanes &= lanes - 1;
+        const float3 a = edge(p.v0, lane);
+        candidates.push_back(Candidate{a, a + edge(p.e1, lane), a + edge(p.e2, lane), chunk});
+      }
+    });
+
+    if(candidates.empty()) {
+      return result;
+    }
+
+    const f32 length = glm::length(query.displacement);
+    f32 t{0.0f};
+    for(i32 iteration = 0; iteration < MAX_ITERATIONS; iteration++) {
+      const float3 s0 = query.a + query.displacement*t;
+      const float3 s1 = query.b + query.displacement*t;
+
+      f32 separation{std::numeric_limits<f32>::max()};
+      float3 on_segment{0.0f}, on_triangle{0.0f};
+      const Candidate *closest{nullptr};
+      for(const Candidate &candidate : candidates) {
+        float3 ps, pt;
+        const f32 d = segment_triangle_distance(s0, s1, candidate.a, candidate.b, candidate.c, ps, pt);
+        if(d < separation) {
+          separation = d;
+          on_segment = ps;
+          on_triangle = pt;
+          closest = &candidate;
+        }
+      }
+
+      separation -= query.radius;
+      if(separation <= EPSILON) {
+        float3 n = on_segment - on_triangle;
+        const f32 n_length = glm::length(n);
+        if(n_length > 0.0f) {
+          n /= n_length;
+        }
+        else {
+          n = glm::normalize(glm::cross(closest->b - closest->a, closest->c - closest->a));
+          if(glm::dot(n, query.displacement) > 0.0f) n = -n;
+        }
+        return CollisionHit{on_triangle, n, closest->chunk, t, true};
+      }
+
+      if(length == 0.0f) {
+        break;
+      }
+
+      t += separation / length;
+      if(t > 1.0f) {
+        break;
+      }
+    }
+
+    return result;
+  }
+
+  [[nodiscard]] inline
+  const ChunkBvh &get_chunk(const int3 chunk) const {
+    return chunks[chunk2idx(chunk)];
+  }
+
+  private:
+  struct Triangle {
+    float3 v[3];
+  };
+
+  static void gather(const float4 *vertices, const u32 triangle_count, std::vector<Triangle> &triangles) {
+    triangles.resize(triangle_count);
+    for(u32 i = 0; i < triangle_count; i++) {
+      for(u32 j = 0; j < 3; j++) {
+        triangles[i].v[j] = float3{vertices[i*3 + j]};
+      }
+    }
+  }
+
+  static void rebuild(ChunkBvh &bvh, const float4 *vertices, const u32 triangle_count) {
+    std::vector<Triangle> triangles;
+    gather(vertices, triangle_count, triangles);
+
+    std::vector<float3> centroids(triangle_count);
+    std::vector<u32> indices(triangle_count);
+    for(u32 i = 0; i < triangle_count; i++) {
+      centroids[i] = (triangles[i].v[0] + triangles[i].v[1] + triangles[i].v[2]) / 3.0f;
+      indices[i] = i;
+    }
+
+    bvh.nodes.clear();
+    bvh.order.clear();
+    bvh.triangle_count = triangle_count;
+    build_node(bvh, indices, centroids, 0, triangle_count);
+
+    bvh.packets.resize(bvh.order.size() / 4);
+    fill_packets(bvh, triangles);
+    refit_nodes(bvh);
+  }
+
+  // Median split on the longest centroid axis.
+  static u32 build_node(ChunkBvh &bvh, std::vector<u32> &indices, const std::vector<float3> &centroids, const u32 begin, const u32 end) {
+    const u32 node_index = static_cast<u32>(bvh.nodes.size());
+    bvh.nodes.push_back(BvhNode{});
+
+    if(end - begin <= LEAF_TRIANGLES) {
+      const u32 first_packet = static_cast<u32>(bvh.order.size() / 4);
+      bvh.order.insert(bvh.order.end(), indices.begin() + begin, indices.begin() + end);
+      while(bvh.order.size() % 4 != 0) {
+        bvh.order.push_back(INVALID_TRIANGLE);
+      }
+      bvh.nodes[node_index].offset = first_packet;
+      bvh.nodes[node_index].count = static_cast<u32>(bvh.order.size() / 4) - first_packet;
+      return node_index;
+    }
+
+    float3 lo{std::numeric_limits<f32>::max()}, hi{std::numeric_limits<f32>::lowest()};
+    for(u32 i = begin; i < end; i++) {
+      lo = glm::min(lo, centroids[indices[i]]);
+      hi = glm::max(hi, centroids[indices[i]]);
+    }
+    const float3 extent = hi - lo;
+    const i32 axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+
+    const u32 mid = (begin + end) / 2;
+    std::nth_element(
+      indices.begin() + begin,
+      indices.begin() + mid,
+      indices.begin() + end,
+      [&](u32 a, u32 b) { return centroids[a][axis] < centroids[b][axis]; }
+    );
+
+    build_node(bvh, indices, centroids, begin, mid);
+    const u32 right = build_node(bvh, indices, centroids, mid, end);
+    bvh.nodes[node_index].offset = right;
+    bvh.nodes[node_index].count = 0;
+    return node_index;
+  }
+
+  static void refit(ChunkBvh &bvh, const float4 *vertices) {
+    std::vector<Triangle> triangles;
+    gather(vertices, bvh.triangle_count, triangles);
+    fill_packets(bvh, triangles);
+    refit_nodes(bvh);
+  }
+
+  static void fill_packets(ChunkBvh &bvh, const std::vector<Triangle> &triangles) {
+    for(u32 p = 0; p < bvh.packets.size(); p++) {
+      TrianglePacket &packet = bvh.packets[p];
+      packet = TrianglePacket{};
+      for(u32 lane = 0; lane < 4; lane++) {
+        const u32 triangle = bvh.order[p*4 + lane];
+        if(triangle == INVALID_TRIANGLE) {
+          continue;
+        }
+        const Triangle &t = triangles[triangle];
+        for(u32 a = 0; a < 3; a++) {
+          packet.v0[a][lane] = t.v[0][a];
+          packet.e1[a][lane] = t.v[1][a] - t.v[0][a];
+          packet.e2[a][lane] = t.v[2][a] - t.v[0][a];
+        }
+        packet.count = lane + 1;
+      }
+    }
+  }
+
+  // Children always follow their parent, so a reverse sweep is bottom-up.
+  static void refit_nodes(ChunkBvh &bvh) {
+    for(u32 n = static_cast<u32>(bvh.nodes.size()); n-- > 0;) {
+      BvhNode &node = bvh.nodes[n];
+      if(node.count == 0) {
+        node.lo = glm::min(bvh.nodes[n + 1].lo, bvh.nodes[node.offset].lo);
+        node.hi = glm::max(bvh.nodes[n + 1].hi, bvh.nodes[node.offset].hi);
+        continue;
+      }
+
+      node.lo = float3{std::numeric_limits<f32>::max()};
+      node.hi = float3{std::numeric_limits<f32>::lowest()};
+      for(u32 p = node.offset; p < node.offset + node.count; p++) {
+        const TrianglePacket &packet = bvh.packets[p];
+        for(u32 lane = 0; lane < packet.count; lane++) {
+          const float3 a = edge(packet.v0, lane);
+          const float3 b = a + edge(packet.e1, lane);
+          const float3 c = a + edge(packet.e2, lane);
+          node.lo = glm::min(node.lo, glm::min(a, glm::min(b, c)));
+          node.hi = glm::max(node.hi, glm::max(a, glm::max(b, c)));
+        }
+      }
+    }
+  }
+
+  bool raycast_bvh(
+    const ChunkBvh &bvh,
+    const float3 origin,
+    const float3 dir,
+    const float3 inv_dir,
+    f32 &t_best,
+    u32 &hit_packet,
+    u32 &hit_lane
+  ) const {
+    u32 stack[64];
+    u32 top{0};
+    stack[top++] = 0;
+    bool hit{false};
+
+    while(top > 0) {
+      const u32 node_index = stack[--top];
+      const BvhNode &node = bvh.nodes[node_index];
+      f32 t_enter{0.0f}, t_exit{t_best};
+      if(!clip(origin, inv_dir, node.lo, node.hi, t_enter, t_exit)) {
+        continue;
+      }
+
+      if(node.count == 0) {
+        stack[top++] = node.offset;
+        stack[top++] = node_index + 1;
+        continue;
+      }
+
+      for(u32 p = node.offset; p < node.offset + node.count; p++) {
+        i32 lane = intersect_packet(bvh.packets[p], origin, dir, t_best);
+        if(lane >= 0) {
+          hit = true;
+          hit_packet = p;
+          hit_lane = static_cast<u32>(lane);
+        }
+      }
+    }
+
+    return hit;
+  }
+
+  // Moller-Trumbore against four triangles. Returns the closest lane that
+  // hits before t_best and updates t_best, or -1.
+  static i32 intersect_packet(const TrianglePacket &p, const float3 origin, const float3 dir, f32 &t_best) {
+#if defined(TMX_COLLISION_SSE)
+    const __m128 dx = _mm_set1_ps(dir.x), dy = _mm_set1_ps(dir.y), dz = _mm_set1_ps(dir.z);
+    const __m128 e1x = _mm_load_ps(p.e1[0]), e1y = _mm_load_ps(p.e1[1]), e1z = _mm_load_ps(p.e1[2]);
+    const __m128 e2x = _mm_load_ps(p.e2[0]), e2y = _mm_load_ps(p.e2[1]), e2z = _mm_load_ps(p.e2[2]);
+
+    // pvec = dir x e2
+    const __m128 px = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y));
+    const __m128 py = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z));
+    const __m128 pz = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x));
+    const __m128 det = dot3(e1x, e1y, e1z, px, py, pz);
+    const __m128 inv_det = _mm_div_ps(_mm_set1_ps(1.0f), det);
+
+    const __m128 tx = _mm_sub_ps(_mm_set1_ps(origin.x), _mm_load_ps(p.v0[0]));
+    const __m128 ty = _mm_sub_ps(_mm_set1_ps(origin.y), _mm_load_ps(p.v0[1]));
+    const __m128 tz = _mm_sub_ps(_mm_set1_ps(origin.z), _mm_load_ps(p.v0[2]));
+    const __m128 u = _mm_mul_ps(dot3(tx, ty, tz, px, py, pz), inv_det);
+
+    // qvec = tvec x e1
+    const __m128 qx = _mm_sub_ps(_mm_mul_ps(ty, e1z), _mm_mul_ps(tz, e1y));
+    const __m128 qy = _mm_sub_ps(_mm_mul_ps(tz, e1x), _mm_mul_ps(tx, e1z));
+    const __m128 qz = _mm_sub_ps(_mm_mul_ps(tx, e1y), _mm_mul_ps(ty, e1x));
+    const __m128 v = _mm_mul_ps(dot3(dx, dy, dz, qx, qy, qz), inv_det);
+    const __m128 t = _mm_mul_ps(dot3(e2x, e2y, e2z, qx, qy, qz), inv_det);
+
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 abs_det = _mm_andnot_ps(_mm_set1_ps(-0.0f), det);
+    __m128 mask = _mm_cmpgt_ps(abs_det, _mm_set1_ps(1e-8f));
+    mask = _mm_and_ps(mask, _mm_cmpge_ps(u, zero));
+    mask = _mm_and_ps(mask, _mm_cmpge_ps(v, zero));
+    mask = _mm_and_ps(mask, _mm_cmple_ps(_mm_add_ps(u, v), _mm_set1_ps(1.0f)));
+    mask = _mm_and_ps(mask, _mm_cmpge_ps(t, zero));
+    mask = _mm_and_ps(mask, _mm_cmplt_ps(t, _mm_set1_ps(t_best)));
+
+    u32 lanes = static_cast<u32>(_mm_movemask_ps(mask)) & ((1u << p.count) - 1);
+    if(lanes == 0) {
+      return -1;
+    }
+
+    alignas(16) f32 ts[4];
+    _mm_store_ps(ts, t);
+#else
+    u32 lanes{0};
+    f32 ts[4];
+    for(u32 lane = 0; lane < p.count; lane++) {
+      const float3 e1 = edge(p.e1, lane);
+      const float3 e2 = edge(p.e2, lane);
+      const float3 pvec = glm::cross(dir, e2);
+      const f32 det = glm::dot(e1, pvec);
+      if(glm::abs(det) <= 1e-8f) continue;
+      const f32 inv_det = 1.0f / det;
+      const float3 tvec = origin - edge(p.v0, lane);
+      const f32 u = glm::dot(tvec, pvec)*inv_det;
+      const float3 qvec = glm::cross(tvec, e1);
+      const f32 v = glm::dot(dir, qvec)*inv_det;
+      ts[lane] = glm::dot(e2, qvec)*inv_det;
+      if(u >= 0.0f && v >= 0.0f && u + v <= 1.0f && ts[lane] >= 0.0f && ts[lane] < t_best) {
+        lanes |= 1u << lane;
+      }
+    }
+    if(lanes == 0) {
+      return -1;
+    }
+#endif
+
+    i32 closest{-1};
+    while(lanes != 0) {
+      const u32 lane = first_lane(lanes);
+      lanes &= lanes - 1;
+      if(ts[lane] < t_best) {
+        t_best = ts[lane];
+        closest = static_cast<i32>(lane);
+      }
+    }
+    return closest;
+  }
+
+  // Lanes whose triangle plane lies within radius of the center.
+  static u32 plane_mask(const TrianglePacket &p, const float3 center, const f32 radius) {
+#if defined(TMX_COLLISION_SSE)
+    const __m128 e1x = _mm_load_ps(p.e1[0]), e1y = _mm_load_ps(p.e1[1]), e1z = _mm_load_ps(p.e1[2]);
+    const __m128 e2x = _mm_load_ps(p.e2[0]), e2y = _mm_load_ps(p.e2[1]), e2z = _mm_load_ps(p.e2[2]);
+
+    const __m128 nx = _mm_sub_ps(_mm_mul_ps(e1y, e2z), _mm_mul_ps(e1z, e2y));
+    const __m128 ny = _mm_sub_ps(_mm_mul_ps(e1z, e2x), _mm_mul_ps(e1x, e2z));
+    const __m128 nz = _mm_sub_ps(_mm_mul_ps(e1x, e2y), _mm_mul_ps(e1y, e2x));
+
+    const __m128 cx = _mm_sub_ps(_mm_set1_ps(center.x), _mm_load_ps(p.v0[0]));
+    const __m128 cy = _mm_sub_ps(_mm_set1_ps(center.y), _mm_load_ps(p.v0[1]));
+    const __m128 cz = _mm_sub_ps(_mm_set1_ps(center.z), _mm_load_ps(p.v0[2]));
+
+    // (c.n)^2 <= r^2 |n|^2 avoids normalising n.
+    const __m128 d = dot3(cx, cy, cz, nx, ny, nz);
+    const __m128 n2 = dot3(nx, ny, nz, nx, ny, nz);
+    const __m128 mask = _mm_cmple_ps(_mm_mul_ps(d, d), _mm_mul_ps(_mm_set1_ps(radius*radius), n2));
+    return static_cast<u32>(_mm_movemask_ps(mask)) & ((1u << p.count) - 1);
+#else
+    u32 lanes{0};
+    for(u32 lane = 0; lane < p.count; lane++) {
+      const float3 n = glm::cross(edge(p.e1, lane), edge(p.e2, lane));
+      const f32 d = glm::dot(center - edge(p.v0, lane), n);
+      if(d*d <= radius*radius*glm::dot(n, n)) {
+        lanes |= 1u << lane;
+      }
+    }
+    return lanes;
+#endif
+  }
+
+#if defined(TMX_COLLISION_SSE)
+  static inline __m128 dot3(__m128 ax, __m128 ay, __m128 az, __m128 bx, __m128 by, __m128 bz) {
+    return _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax, bx), _mm_mul_ps(ay, by)), _mm_mul_ps(az, bz));
+  }
+#endif
+
+  // Calls fn(chunk, packet, lane_mask) for every packet in a leaf overlapping [lo, hi].
+  template<typename Fn>
+  void for_each_triangle(const float3 lo, const float3 hi, Fn &&fn) const {
+    const int3 chunk_lo = glm::max(int3{glm::floor(lo / float3{voxels_per_chunk})}, int3{0});
+    const int3 chunk_hi = glm::min(int3{glm::floor(hi / float3{voxels_per_chunk})}, chunks_per_axis - 1);
+
+    for(i32 z = chunk_lo.z; z <= chunk_hi.z; z++) {
+    for(i32 y = chunk_lo.y; y <= chunk_hi.y; y++) {
+    for(i32 x = chunk_lo.x; x <= chunk_hi.x; x++) {
+      const int3 chunk{x, y, z};
+      const ChunkBvh &bvh = chunks[chunk2idx(chunk)];
+      if(bvh.empty()) continue;
+
+      u32 stack[64];
+      u32 top{0};
+      stack[top++] = 0;
+      while(top > 0) {
+        const u32 node_index = stack[--top];
+        const BvhNode &node = bvh.nodes[node_index];
+        if(glm::any(glm::greaterThan(node.lo, hi)) || glm::any(glm::lessThan(node.hi, lo))) {
+          continue;
+        }
+
+        if(node.count == 0) {
+          stack[top++] = node.offset;
+          stack[top++] = node_index + 1;
+          continue;
+        }
+
+        for(u32 p = node.offset; p < node.offset + node.count; p++) {
+          const TrianglePacket &packet = bvh.packets[p];
+          fn(chunk, packet, (1u << packet.count) - 1);
+        }
+      }
+    }
+    }
+    }
+  }
+
+  static float3 contact_normal(const float3 delta, const TrianglePacket &p, const u32 lane) {
+    const f32 length = glm::length(delta);
+    if(length > 0.0f) {
+      return delta / length;
+    }
+    return glm::normalize(glm::cross(edge(p.e1, lane), edge(p.e2, lane)));
+  }
+
+  // Ericson, Real-Time Collision Detection 5.1.5.
+  static float3 closest_point_triangle(const float3 p, const float3 a, const float3 b, const float3 c) {
+    const float3 ab = b - a, ac = c - a, ap = p - a;
+    const f32 d1 = glm::dot(ab, ap), d2 = glm::dot(ac, ap);
+    if(d1 <= 0.0f && d2 <= 0.0f) return a;
+
+    const float3 bp = p - b;
+    const f32 d3 = glm::dot(ab, bp), d4 = glm::dot(ac, bp);
+    if(d3 >= 0.0f && d4 <= d3) return b;
+
+    const f32 vc = d1*d4 - d3*d2;
+    if(vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f) return a + ab*(d1 / (d1 - d3));
+
+    const float3 cp = p - c;
+    const f32 d5 = glm::dot(ab, cp), d6 = glm::dot(ac, cp);
+    if(d6 >= 0.0f && d5 <= d6) return c;
+
+    const f32 vb = d5*d2 - d1*d6;
+    if(vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f) return a + ac*(d2 / (d2 - d6));
+
+    const f32 va = d3*d6 - d5*d4;
+    if(va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f) return b + (c - b)*((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+
+    const f32 denom = 1.0f / (va + vb + vc);
+    return a + ab*(vb*denom) + ac*(vc*denom);
+  }
+
+  // Ericson, Real-Time Collision Detection 5.1.9.
+  static f32 closest_segment_segment(const float3 p1, const float3 q1, const float3 p2, const float3 q2, float3 &c1, float3 &c2) {
+    const float3 d1 = q1 - p1, d2 = q2 - p2, r = p1 - p2;
+    const f32 a = glm::dot(d1, d1), e = glm::dot(d2, d2), f = glm::dot(d2, r);
+    f32 s{0.0f}, t{0.0f};
+
+    if(a <= 1e-12f && e <= 1e-12f) {
+      c1 = p1;
+      c2 = p2;
+      return glm::length(c1 - c2);
+    }
+
+    if(a <= 1e-12f) {
+      t = glm::clamp(f / e, 0.0f, 1.0f);
+    }
+    else {
+      const f32 c = glm::dot(d1, r);
+      if(e <= 1e-12f) {
+        s = glm::clamp(-c / a, 0.0f, 1.0f);
+      }
+      else {
+        const f32 b = glm::dot(d1, d2);
+        const f32 denom = a*e - b*b;
+        s = denom != 0.0f ? glm::clamp((b*f - c*e) / denom, 0.0f, 1.0f) : 0.0f;
+        t = (b*s + f) / e;
+        if(t < 0.0f) {
+          t = 0.0f;
+          s = glm::clamp(-c / a, 0.0f, 1.0f);
+        }
+        else if(t > 1.0f) {
+          t = 1.0f;
+          s = glm::clamp((b - c) / a, 0.0f, 1.0f);
+        }
+      }
+    }
+
+    c1 = p1 + d1*s;
+    c2 = p2 + d2*t;
+    return glm::length(c1 - c2);
+  }
+
+  // Distance between a segment and a triangle with the closest pair of points.
+  static f32 segment_triangle_distance(
+    const float3 s0,
+    const float3 s1,
+    const float3 a,
+    const float3 b,
+    const float3 c,
+    float3 &on_segment,
+    float3 &on_triangle
+  ) {
+    // Segment crossing the triangle.
+    const float3 e1 = b - a, e2 = c - a, d = s1 - s0;
+    const float3 pvec = glm::cross(d, e2);
+    const f32 det = glm::dot(e1, pvec);
+    if(glm::abs(det) > 1e-8f) {
+      const f32 inv_det = 1.0f / det;
+      const float3 tvec = s0 - a;
+      const f32 u = glm::dot(tvec, pvec)*inv_det;
+      const float3 qvec = glm::cross(tvec, e1);
+      const f32 v = glm::dot(d, qvec)*inv_det;
+      const f32 t = glm::dot(e2, qvec)*inv_det;
+      if(u >= 0.0f && v >= 0.0f && u + v <= 1.0f && t >= 0.0f && t <= 1.0f) {
+        on_segment = on_triangle = s0 + d*t;
+        return 0.0f;
+      }
+    }
+
+    f32 best;
+    on_segment = s0;
+    on_triangle = closest_point_triangle(s0, a, b, c);
+    best = glm::length(on_segment - on_triangle);
+
+    const float3 q = closest_point_triangle(s1, a, b, c);
+    if(glm::length(s1 - q) < best) {
+      best = glm::length(s1 - q);
+      on_segment = s1;
+      on_triangle = q;
+    }
+
+    const float3 edges[3][2] = {{a, b}, {b, c}, {c, a}};
+    for(const auto &e : edges) {
+      float3 cs, ct;
+      const f32 distance = closest_segment_segment(s0, s1, e[0], e[1], cs, ct);
+      if(distance < best) {
+        best = distance;
+        on_segment = cs;
+        on_triangle = ct;
+      }
+    }
+
+    return best;
+  }
+
+  static bool clip(const float3 origin, const float3 inv_dir, const float3 lo, const float3 hi, f32 &t_enter, f32 &t_exit) {
+    const float3 t0 = (lo - origin)*inv_dir;
+    const float3 t1 = (hi - origin)*inv_dir;
+    const float3 t_small = glm::min(t0, t1);
+    const float3 t_large = glm::max(t0, t1);
+    t_enter = glm::max(t_enter, glm::max(t_small.x, glm::max(t_small.y, t_small.z)));
+    t_exit = glm::min(t_exit, glm::min(t_large.x, glm::min(t_large.y, t_large.z)));
+    return t_enter <= t_exit;
+  }
+
+  static inline float3 edge(const f32 (&v)[3][4], const u32 lane) {
+    return float3{v[0][lane], v[1][lane], v[2][lane]};
+  }
+
+  static inline u32 first_lane(const u32 lanes) {
+    return static_cast<u32>(std::countr_zero(lanes));
+  }
+
+  ThreadPool *thread_pool;
+  std::vector<ChunkBvh> chunks;
+
+  const int3 voxels_per_chunk{COUNT_VOXELS_X, COUNT_VOXELS_Y, COUNT_VOXELS_Z};
+  const int3 chunks_per_axis{COUNT_CHUNKS_X, COUNT_CHUNKS_Y, COUNT_CHUNKS_Z};
+  const int3 world_voxels{chunks_per_axis*voxels_per_chunk};
+};
+
+}
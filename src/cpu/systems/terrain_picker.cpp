@@ -0,0 +1 @@
+#include "terrain_picker.hpp"
\ No newline at end of file
@@ -0,0 +1,306 @@
+#pragma once
+
+#include <push.inl>
+
+#include "../core/events.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cmath>
+#include <limits>
+#include <optional>
+
+namespace tmx {
+
+struct TerrainHit {
+  float3 position;
+  float3 normal;
+  int3 chunk;
+  f32 distance;
+};
+
+// Min/max density over every voxel read by the cells of a chunk or brick,
+// including the +1 border shared with the next one.
+struct ChunkSummary {
+  f32 min;
+  f32 max;
+
+  [[nodiscard]] inline
+  bool empty(void) const { return min >= 0.0f; }
+
+  [[nodiscard]] inline
+  bool solid(void) const { return max < 0.0f; }
+
+  [[nodiscard]] inline
+  bool uniform(void) const { return empty() || solid(); }
+};
+
+// Ray queries against the host mirror of the density store.
+// A 3D DDA steps through chunks, then bricks, then cells, skipping uniform
+// regions using the min/max summaries written by the GPU, and refines the
+// crossing on the trilinear density field.
+struct TerrainPicker {
+  public:
+  TerrainPicker(const DensityCode *voxels, const u32 *page_table, const float2 *summaries)
+    : voxels{voxels}, page_table{page_table}, summaries{summaries} {}
+
+  ~TerrainPicker(void) = default;
+
+  [[nodiscard]]
+  std::optional<TerrainHit> pick(const Ray &ray, const f32 max_distance = std::numeric_limits<f32>::max()) const {
+    const float3 dir = glm::normalize(ray.dir);
+    const float3 inv_dir = inverse_direction(dir);
+
+    // The sampled lattice spans [0, world_voxels - 1].
+    f32 t_enter{0.0f}, t_exit{max_distance};
+    if(!clip(ray.pos, inv_dir, float3{0.0f}, float3{world_voxels - 1}, t_enter, t_exit)) {
+      return std::nullopt;
+    }
+
+    const int3 bricks_per_chunk{COUNT_BRICKS_X, COUNT_BRICKS_Y, COUNT_BRICKS_Z};
+    const Traversal traversal{ray.pos, dir, inv_dir};
+
+    return traverse(traversal, t_enter, t_exit, int3{0}, chunks_per_axis - 1, voxels_per_chunk,
+      [&](const int3 chunk, const f32 t0, const f32 t1, const float3 entry_normal) -> std::optional<TerrainHit> {
+        const ChunkSummary summary = region_summary(chunk, voxels_per_chunk);
+        if(summary.empty()) return std::nullopt;
+        if(summary.solid()) return TerrainHit{ray.pos + dir*t0, entry_normal, chunk, t0};
+
+        const int3 brick_lo = chunk*bricks_per_chunk;
+        return traverse(traversal, t0, t1, brick_lo, brick_lo + bricks_per_chunk - 1, int3{COUNT_BRICK_VOXELS},
+          [&](const int3 brick, const f32 b0, const f32 b1, const float3 brick_normal) -> std::optional<TerrainHit> {
+            const ChunkSummary brick_summary = region_summary(brick, int3{COUNT_BRICK_VOXELS});
+            if(brick_summary.empty()) return std::nullopt;
+            if(brick_summary.solid()) return TerrainHit{ray.pos + dir*b0, brick_normal, chunk, b0};
+
+            const int3 cell_lo = brick*COUNT_BRICK_VOXELS;
+            const int3 cell_hi = glm::min(cell_lo + COUNT_BRICK_VOXELS, world_voxels - 1) - 1;
+            return traverse(traversal, b0, b1, cell_lo, cell_hi, int3{1},
+              [&](const int3 cell, const f32 c0, const f32 c1, const float3) -> std::optional<TerrainHit> {
+                std::optional<f32> root = cell_root(ray.pos, dir, c0, c1, cell);
+                if(!root.has_value()) return std::nullopt;
+                const float3 p = ray.pos + dir*root.value();
+                return TerrainHit{p, normal(p), chunk, root.value()};
+              }
+            );
+          }
+        );
+      }
+    );
+  }
+
+  // Summary of the cells of a chunk, see region_summary.
+  [[nodiscard]] inline
+  ChunkSummary get_summary(const int3 chunk) const {
+    return region_summary(chunk, voxels_per_chunk);
+  }
+
+  // Stored density of a world-space voxel.
+  [[nodiscard]] inline
+  f32 voxel(const int3 v) const {
+    if(!voxel_in_world(v)) {
+      return DENSITY_OUTSIDE_WORLD;
+    }
+    const u32 page = page_table[chunk2idx(voxel_chunk(v))];
+    return page_resident(page) ? decode_density(voxels[pool_index(page, voxel_local(v))]) : page_uniform_density(page);
+  }
+
+  private:
+  struct Traversal {
+    float3 origin;
+    float3 dir;
+    float3 inv_dir;
+  };
+
+  // Combines the summaries of a region and its +1 neighbours, which hold the
+  // border voxels its cells read. Region size picks the chunk or brick level.
+  [[nodiscard]]
+  ChunkSummary region_summary(const int3 region, const int3 size) const {
+    const bool chunk_level = size == voxels_per_chunk;
+    const int3 regions_per_axis = world_voxels / size;
+    const int3 bricks_per_chunk{COUNT_BRICKS_X, COUNT_BRICKS_Y, COUNT_BRICKS_Z};
+
+    ChunkSummary summary{std::numeric_limits<f32>::max(), std::numeric_limits<f32>::lowest()};
+    for(i32 i = 0; i < 8; i++) {
+      const int3 n = region + int3{i & 1, (i >> 1) & 1, (i >> 2) & 1};
+      float2 s{static_cast<f32>(DENSITY_OUTSIDE_WORLD)};
+      if(all_in(n, regions_per_axis)) {
+        s = chunk_level ?
+          summaries[summary_chunk_index(n)] :
+          summaries[summary_brick_index(n / bricks_per_chunk, n % bricks_per_chunk)];
+      }
+      summary.min = glm::min(summary.min, s.x);
+      summary.max = glm::max(summary.max, s.y);
+    }
+    return summary;
+  }
+
+  // DDA over the grid of size-sized regions in [lo, hi] between t_begin and
+  // t_end, visit(region, t0, t1, entry_normal) returns the first hit.
+  template<typename Visit>
+  std::optional<TerrainHit> traverse(
+    const Traversal &r,
+    const f32 t_begin,
+    const f32 t_end,
+    const int3 lo,
+    const int3 hi,
+    const int3 size,
+    Visit &&visit
+  ) const {
+    const float3 cell_size{size};
+    const float3 entry = r.origin + r.dir*t_begin;
+    int3 cell = glm::clamp(int3{glm::floor(entry / cell_size)}, lo, hi);
+    const int3 step = int3{glm::sign(r.dir)};
+    float3 t_max = next_boundary(r.origin, r.dir, r.inv_dir, float3{cell}*cell_size, cell_size, step);
+    const float3 t_delta = glm::abs(cell_size*r.inv_dir);
+
+    f32 t = t_begin;
+    i32 last_axis = -1;
+    while(t <= t_end && glm::all(glm::greaterThanEqual(cell, lo)) && glm::all(glm::lessThanEqual(cell, hi))) {
+      const f32 t_next = glm::min(glm::min(t_max.x, t_max.y), glm::min(t_max.z, t_end));
+      const float3 entry_normal = last_axis < 0 ? -r.dir : -float3{axis(last_axis)}*float3{step};
+
+      std::optional<TerrainHit> hit = visit(cell, t, t_next, entry_normal);
+      if(hit.has_value()) {
+        return hit;
+      }
+
+      last_axis = min_axis(t_max);
+      t = t_max[last_axis];
+      t_max[last_axis] += t_delta[last_axis];
+      cell[last_axis] += step[last_axis];
+    }
+
+    return std::nullopt;
+  }
+
+  // First zero crossing of the trilinear field inside a cell along [t0, t1].
+  std::optional<f32> cell_root(const float3 origin, const float3 dir, f32 t0, f32 t1, const int3 cell) const {
+    f32 lo{std::numeric_limits<f32>::max()}, hi{std::numeric_limits<f32>::lowest()};
+    for(i32 i = 0; i < 8; i++) {
+      const f32 d = voxel(cell + int3{i & 1, (i >> 1) & 1, (i >> 2) & 1});
+      lo = glm::min(lo, d);
+      hi = glm::max(hi, d);
+    }
+    if(lo >= 0.0f || hi < 0.0f) {
+      return lo >= 0.0f ? std::nullopt : std::optional<f32>{t0};
+    }
+
+    // The segment can enter and leave the surface within one cell,
+    // so look for the first sign change over a few sub-steps.
+    constexpr i32 SUBSTEPS = 4;
+    f32 a = t0;
+    if(trilinear(origin + dir*a) < 0.0f) {
+      return a;
+    }
+    for(i32 i = 1; i <= SUBSTEPS; i++) {
+      f32 b = glm::mix(t0, t1, static_cast<f32>(i) / SUBSTEPS);
+      if(trilinear(origin + dir*b) < 0.0f) {
+        for(i32 j = 0; j < 8; j++) {
+          const f32 m = 0.5f*(a + b);
+          if(trilinear(origin + dir*m) < 0.0f) b = m; else a = m;
+        }
+        return b;
+      }
+      a = b;
+    }
+
+    return std::nullopt;
+  }
+
+  [[nodiscard]]
+  f32 trilinear(const float3 p) const {
+    const int3 base = int3{glm::floor(p)};
+    const float3 f = p - float3{base};
+
+    const f32 c000 = voxel(base + int3{0, 0, 0});
+    const f32 c100 = voxel(base + int3{1, 0, 0});
+    const f32 c010 = voxel(base + int3{0, 1, 0});
+    const f32 c110 = voxel(base + int3{1, 1, 0});
+    const f32 c001 = voxel(base + int3{0, 0, 1});
+    const f32 c101 = voxel(base + int3{1, 0, 1});
+    const f32 c011 = voxel(base + int3{0, 1, 1});
+    const f32 c111 = voxel(base + int3{1, 1, 1});
+
+    const f32 c00 = glm::mix(c000, c100, f.x);
+    const f32 c10 = glm::mix(c010, c110, f.x);
+    const f32 c01 = glm::mix(c001, c101, f.x);
+    const f32 c11 = glm::mix(c011, c111, f.x);
+
+    return glm::mix(glm::mix(c00, c10, f.y), glm::mix(c01, c11, f.y), f.z);
+  }
+
+  // Densities increase away from the surface, so the gradient points outwards.
+  [[nodiscard]]
+  float3 normal(const float3 p) const {
+    constexpr f32 h = 0.5f;
+    const float3 gradient{
+      trilinear(p + float3{h, 0, 0}) - trilinear(p - float3{h, 0, 0}),
+      trilinear(p + float3{0, h, 0}) - trilinear(p - float3{0, h, 0}),
+      trilinear(p + float3{0, 0, h}) - trilinear(p - float3{0, 0, h}),
+    };
+    const f32 length = glm::length(gradient);
+    return length > 0.0f ? gradient / length : float3{0.0f, 1.0f, 0.0f};
+  }
+
+  // Axis aligned rays would give infinite t-deltas and 0*inf NaNs in clip,
+  // a huge finite inverse never picks that axis while keeping the sums finite.
+  static float3 inverse_direction(const float3 dir) {
+    constexpr f32 EPSILON = 1e-8f;
+    constexpr f32 LARGE = 1e30f;
+    float3 inv_dir;
+    for(i32 a = 0; a < 3; a++) {
+      inv_dir[a] = std::abs(dir[a]) < EPSILON ? (std::signbit(dir[a]) ? -LARGE : LARGE) : 1.0f / dir[a];
+    }
+    return inv_dir;
+  }
+
+  static bool clip(const float3 origin, const float3 inv_dir, const float3 lo, const float3 hi, f32 &t_enter, f32 &t_exit) {
+    const float3 t0 = (lo - origin)*inv_dir;
+    const float3 t1 = (hi - origin)*inv_dir;
+    const float3 t_small = glm::min(t0, t1);
+    const float3 t_large = glm::max(t0, t1);
+    t_enter = glm::max(t_enter, glm::max(t_small.x, glm::max(t_small.y, t_small.z)));
+    t_exit = glm::min(t_exit, glm::min(t_large.x, glm::min(t_large.y, t_large.z)));
+    return t_enter <= t_exit;
+  }
+
+  static float3 next_boundary(
+    const float3 origin,
+    const float3 dir,
+    const float3 inv_dir,
+    const float3 cell_origin,
+    const float3 cell_size,
+    const int3 step
+  ) {
+    float3 t_max{std::numeric_limits<f32>::max()};
+    for(i32 a = 0; a < 3; a++) {
+      if(step[a] == 0) continue;
+      const f32 boundary = cell_origin[a] + (step[a] > 0 ? cell_size[a] : 0.0f);
+      t_max[a] = (boundary - origin[a])*inv_dir[a];
+    }
+    return t_max;
+  }
+
+  static inline i32 min_axis(const float3 t) {
+    return t.x < t.y ? (t.x < t.z ? 0 : 2) : (t.y < t.z ? 1 : 2);
+  }
+
+  static inline int3 axis(const i32 a) {
+    return int3{a == 0, a == 1, a == 2};
+  }
+
+  static inline bool all_in(const int3 c, const int3 dim) {
+    return glm::all(glm::greaterThanEqual(c, int3{0})) && glm::all(glm::lessThan(c, dim));
+  }
+
+  const DensityCode *voxels;
+  const u32 *page_table;
+  const float2 *summaries;
+
+  const int3 voxels_per_chunk{COUNT_VOXELS_X, COUNT_VOXELS_Y, COUNT_VOXELS_Z};
+  const int3 chunks_per_axis{COUNT_CHUNKS_X, COUNT_CHUNKS_Y, COUNT_CHUNKS_Z};
+  const int3 world_voxels{chunks_per_axis*voxels_per_chunk};
+};
+
+}
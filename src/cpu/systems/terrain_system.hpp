@@ -2,33 +2,55 @@
 
 #include <push.inl>
 
+#include "../core/cpu_profiler.hpp"
 #include "../core/event_bus.hpp"
 #include "../core/events.hpp"
+#include "../core/grid_config.hpp"
+#include "../core/paths.hpp"
 #include "../vk/buffer.hpp"
 #include "../pipelines/compute/compute_pipeline.hpp"
 #include "../vk/context.hpp"
+#include "../vk/timestamp_timer.hpp"
 #include "resource_manager.hpp"
+#include "terrain_picker.hpp"
+#include "density_bounds.hpp"
+#include "brick_pool.hpp"
+#include "voxel_dag.hpp"
 
 #include <glm/glm.hpp>
 
+#include <algorithm>
+#include <bit>
 #include <memory>
+#include <optional>
+#include <string>
+#include <vector>
 
 #define MAX_DISPATCHES_PER_FRAME (1)
 
+// Spare voxel pool bricks for edits that give uniform chunks voxels, a
+// fraction of the surface chunks but never fewer than the minimum.
+#define POOL_HEADROOM_DIVISOR (8u)
+#define MIN_POOL_HEADROOM     (64u)
+
 namespace tmx {
 
 struct TerrainManager {
   public:
+  // chunk_stats has generation and meshing fill a ChunkStat per chunk, at
+  // the cost of the counters and the shader clock variants.
   TerrainManager(
     Context* vk_context,
     EventBus* event_bus,
     GraphicsPipeline* pipeline,
-    ResourceManager* resource_manager
+    ResourceManager* resource_manager,
+    const bool chunk_stats = false
   ) : 
     vk_context{vk_context},
     event_bus{event_bus},
     pipeline{pipeline},
-    resource_manager{resource_manager} {
+    resource_manager{resource_manager},
+    chunk_stats{chunk_stats} {
 
     event_bus->add<IsosurfaceGenerationEvent>(this, &TerrainManager::generate_isosurface);
     event_bus->add<IsosurfaceMeshingEvent>(this, &TerrainManager::mesh_isosurface);
@@ -37,7 +59,7 @@ struct TerrainManager {
     compute_queue = vk_context->get_compute_queue();
 
 
-    std::ifstream file("../../../assets/bin/MarchingCubesLUT.bin", std::ios::ate | std::ios::binary);
+    std::ifstream file(asset_path("MarchingCubesLUT.bin"), std::ios::ate | std::ios::binary);
 
     if (!file.is_open()) {
       throw std::runtime_error("Failed to open MarchingCubesLUT.bin!");
@@ -63,7 +85,7 @@ struct TerrainManager {
     gpu_LUT->unmap_memory();
     delete[] mc_lut;
 
-    std::ifstream file2("../../../assets/bin/MarchingCubesVertexCountLUT.bin", std::ios::ate | std::ios::binary);
+    std::ifstream file2(asset_path("MarchingCubesVertexCountLUT.bin"), std::ios::ate | std::ios::binary);
 
     if (!file2.is_open()) {
       throw std::runtime_error("Failed to open MarchingCubesVertexCountLUT.bin!");
@@ -152,26 +174,47 @@ struct TerrainManager {
     /***********************************/
     /***********************************/
 	  
+    // Meshing hands out at most one draw command per chunk.
     gpu_indirect_cmds =
       resource_manager->create_buffer<VkDrawIndirectCommand>(
-        INT16_MAX*sizeof(VkDrawIndirectCommand),
+        sizeof(VkDrawIndirectCommand)*COUNT_CHUNKS,
         VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
         TMX_MEMORY_PROPERTY_UNIFIED,
         TMX_BUFFER_CREATE_MAPPED_BIT
       );
 
-    gpu_voxels =
-      resource_manager->create_buffer<f32>(
-        INT32_MAX-1,
+    gpu_page_table =
+      resource_manager->create_buffer<u32>(
+        sizeof(u32)*COUNT_CHUNKS,
         VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
         TMX_MEMORY_PROPERTY_UNIFIED,
         TMX_BUFFER_CREATE_MAPPED_BIT
       );
 
+    // The pool holds the chunks that can contain surface, so it scales
+    // with the surface area instead of the world volume. Edits that need
+    // more bricks grow it, see grow_voxel_pool.
+    chunk_classes = classify_chunks();
+    const u32 surface_chunks = static_cast<u32>(std::count(chunk_classes.begin(), chunk_classes.end(), DENSITY_CLASS_SURFACE));
+
+    // Each surface chunk may mesh to its largest possible mesh, which all
+    // have to fit the vertex buffer's pages together.
+    const u32 pages_per_chunk = (COUNT_VOXELS*GridConfig::MAX_CELL_VERTICES + ALLOCATOR_PAGE_SIZE - 1)/ALLOCATOR_PAGE_SIZE;
+    if(u64{surface_chunks}*pages_per_chunk > ALLOCATOR_MAX_ALLOCATIONS) {
+      throw std::runtime_error(
+        "Vertex buffer out of memory for " + std::to_string(surface_chunks) + " surface chunks of up to " +
+        std::to_string(pages_per_chunk) + " pages, it holds " + std::to_string(ALLOCATOR_MAX_ALLOCATIONS) + "!"
+      );
+    }
+
+    const u32 pool_capacity = glm::min<u32>(surface_chunks + glm::max(surface_chunks/POOL_HEADROOM_DIVISOR, MIN_POOL_HEADROOM), COUNT_CHUNKS);
+    gpu_voxels = create_voxel_pool(pool_capacity);
+    brick_pool = std::make_unique<BrickPool>(gpu_page_table->host_address(), pool_capacity);
+
 
     gpu_vertices =
       resource_manager->create_buffer<float4>(
-        INT32_MAX-1,
+        VERTEX_BUFFER_SIZE,
         VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
         TMX_MEMORY_PROPERTY_UNIFIED,
         TMX_BUFFER_CREATE_MAPPED_BIT
@@ -188,7 +231,7 @@ struct TerrainManager {
     for(u32 i = 0; i < ALLOCATOR_MAX_ALLOCATIONS; i++) {
       gpu_allocator->host_address()->free[i] = 0;
     }
-    gpu_allocator->host_address()->locked = 0;
+    gpu_allocator->host_address()->locked = UNLOCKED;
 
 
     gpu_chunk_draw_info =
@@ -209,6 +252,70 @@ struct TerrainManager {
       );
     memset(gpu_globals->host_address(), 0, sizeof(GpuGlobals));
 
+    gpu_summaries =
+      resource_manager->create_buffer<float2>(
+        sizeof(float2)*COUNT_SUMMARIES,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        TMX_MEMORY_PROPERTY_UNIFIED,
+        TMX_BUFFER_CREATE_MAPPED_BIT
+      );
+    // Straddles the surface until generated, so nothing is skipped early.
+    for(u32 i = 0; i < COUNT_SUMMARIES; i++) {
+      gpu_summaries->host_address()[i] = float2{-1.0f, 1.0f};
+    }
+
+    picker = std::make_unique<TerrainPicker>(
+      gpu_voxels->host_address(),
+      gpu_page_table->host_address(),
+      gpu_summaries->host_address()
+    );
+
+    gpu_edits =
+      resource_manager->create_buffer<SdfEdits>(
+        sizeof(SdfEdit)*MAX_SDF_EDITS_PER_FRAME,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        TMX_MEMORY_PROPERTY_UNIFIED,
+        TMX_BUFFER_CREATE_MAPPED_BIT
+      );
+
+    gpu_edit_chunks =
+      resource_manager->create_buffer<ChunkQueue>(
+        sizeof(uint4) + sizeof(int4)*COUNT_CHUNKS,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        TMX_MEMORY_PROPERTY_UNIFIED,
+        TMX_BUFFER_CREATE_MAPPED_BIT
+      );
+
+    gpu_dirty_chunks =
+      resource_manager->create_buffer<ChunkQueue>(
+        sizeof(uint4) + sizeof(int4)*COUNT_CHUNKS,
+        VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        TMX_MEMORY_PROPERTY_UNIFIED,
+        TMX_BUFFER_CREATE_MAPPED_BIT
+      );
+    gpu_dirty_chunks->host_address()->dispatch = uint3{0, 1, 1};
+
+    gpu_dirty_flags =
+      resource_manager->create_buffer<DirtyFlags>(
+        sizeof(u32)*COUNT_CHUNKS,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        TMX_MEMORY_PROPERTY_UNIFIED,
+        TMX_BUFFER_CREATE_MAPPED_BIT
+      );
+    memset(gpu_dirty_flags->host_address(), 0, sizeof(u32)*COUNT_CHUNKS);
+
+    if(chunk_stats) {
+      gpu_chunk_stats =
+        resource_manager->create_buffer<ChunkStat>(
+          sizeof(ChunkStat)*COUNT_CHUNKS,
+          VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+          TMX_MEMORY_PROPERTY_UNIFIED,
+          TMX_BUFFER_CREATE_MAPPED_BIT
+        );
+      memset(gpu_chunk_stats->host_address(), 0, sizeof(ChunkStat)*COUNT_CHUNKS);
+      std::cout << "Chunk stats " << (vk_context->shader_clock ? "with" : "without") << " shader clocks" << std::endl;
+    }
+
     std::cout << "Initialized terrain system." << std::endl;
 
   }
@@ -216,11 +323,13 @@ struct TerrainManager {
   ~TerrainManager(void) = default;
 
   void generate_isosurface(const std::any &e) {
+    TMX_ZONE("TerrainManager::generate_isosurface");
     const auto &event = std::any_cast<const IsosurfaceGenerationEvent &>(e);
-    isosurface_chunks_progress = chunks_per_axis;
-    return;
+    u32 skipped_chunks{0};
 
     VkCommandBuffer command_buffer = vk_context->begin_command_buffers<1>();
+    if(generation_timer) generation_timer->cmd_begin(command_buffer);
+    const u32 profiler_scope = vk_context->get_profiler().cmd_begin(command_buffer, GPU_PASS_GENERATION);
     
     isosurface_generation_pipeline.cmd_bind_pipeline(command_buffer);
 
@@ -237,11 +346,30 @@ struct TerrainManager {
         chunk_x++
        ) {
 
+      // Chunks proven to be entirely air or rock get no brick and are
+      // not generated, meshing then skips them through their summaries.
+      const int3 chunk{chunk_x, chunk_y, chunk_z};
+      const i32 density_class = chunk_classes[chunk2idx(chunk)];
+      if(density_class != DENSITY_CLASS_SURFACE) {
+        const u32 sentinel = density_class == DENSITY_CLASS_INSIDE ? PAGE_UNIFORM_INSIDE : PAGE_UNIFORM_OUTSIDE;
+        brick_pool->make_uniform(chunk, sentinel);
+        cmd_fill_uniform_summaries(command_buffer, chunk, page_uniform_density(sentinel));
+        skipped_chunks++;
+        continue;
+      }
+
+      if(!brick_pool->make_resident(chunk).has_value()) {
+        throw std::runtime_error("Voxel brick pool exhausted by chunks it was sized for!");
+      }
+
       IsosurfaceGenerationPush isosurface_generation_push {
         .pVoxels = SHADER_CAST(gpu_voxels->device_address()),
+        .pPageTable = SHADER_CAST(gpu_page_table->device_address()),
+        .pSummaries = SHADER_CAST(gpu_summaries->device_address()),
         .pChunkDrawInfo = SHADER_CAST(gpu_chunk_draw_info->device_address()),
         .pIndirect = SHADER_CAST(gpu_indirect_cmds->device_address()),
         .pGpuGlobals = SHADER_CAST(gpu_globals->device_address()),
+        .pChunkStats = gpu_chunk_stats ? SHADER_CAST(gpu_chunk_stats->device_address()) : 0,
         .chunk_pos = int4{chunk_x, chunk_y, chunk_z, 0},
       };
 
@@ -261,12 +389,22 @@ struct TerrainManager {
     isosurface_chunks_progress.y = chunks_per_axis.y;
     isosurface_chunks_progress.z = chunks_per_axis.z;
 	
+    vk_context->get_profiler().cmd_end(command_buffer, profiler_scope);
+    if(generation_timer) generation_timer->cmd_end(command_buffer);
     vk_context->end_command_buffer(command_buffer);
     vk_context->queue_submit(command_buffer, TmxSubmitInfo{compute_queue, 0, 0, 0, 0});
     vk_context->queue_wait_idle(compute_queue);
     vk_context->free_command_buffers<1>(&command_buffer);
 	
     if(isosurface_chunks_progress == chunks_per_axis) {
+      // The bound is conservative, some generated chunks turn out uniform.
+      for(u32 i = 0; i < COUNT_CHUNKS; i++) {
+        release_uniform_brick(idx2chunk(i));
+      }
+      std::cout << "ISOSURFACE skipped " << skipped_chunks << " of " << COUNT_CHUNKS << " bounded chunks" << std::endl;
+      std::cout << "ISOSURFACE " << brick_pool->resident_count() << " of " << brick_pool->slot_count() << " bricks resident, "
+                << u64{brick_pool->resident_count()}*COUNT_VOXELS*sizeof(DensityCode) << " of "
+                << gpu_voxels->allocation_size() << " voxel bytes in use" << std::endl;
       std::cout << "ISOSURFACE all finished\n" << std::endl;
     }
     else {
@@ -277,7 +415,9 @@ struct TerrainManager {
   }
   
   void mesh_isosurface(const std::any &e) {
+    TMX_ZONE("TerrainManager::mesh_isosurface");
     const auto &event = std::any_cast<const IsosurfaceMeshingEvent &>(e);
+    u32 skipped_chunks{0};
 
     for(i32 chunk_z = meshing_chunks_progress.z;
         chunk_z < chunks_per_axis.z;
@@ -289,6 +429,8 @@ struct TerrainManager {
        ) {
 
     VkCommandBuffer command_buffer = vk_context->begin_command_buffers<1>();
+    if(meshing_timer) meshing_timer->cmd_begin(command_buffer);
+    const u32 profiler_scope = vk_context->get_profiler().cmd_begin(command_buffer, GPU_PASS_MESHING);
     
     isosurface_meshing_pipeline.cmd_bind_pipeline(command_buffer);
 
@@ -297,25 +439,18 @@ struct TerrainManager {
         chunk_x++
        ) {
 
-      IsosurfaceMeshingPush isosurface_meshing_push {
-        .pAllocator = SHADER_CAST(gpu_allocator->device_address()),
-        .pMcPtrTable = SHADER_CAST(gpu_ptr_table->device_address()),
-        .pVertices = SHADER_CAST(gpu_vertices->device_address()),
-        .pVoxels = SHADER_CAST(gpu_voxels->device_address()),
-		    .pIndirect = SHADER_CAST(gpu_indirect_cmds->device_address()),
-		    .pGpuGlobals = SHADER_CAST(gpu_globals->device_address()),
-        .chunk_pos = int4{chunk_x, chunk_y, chunk_z, 0},
-      };
+      // Generation has finished, so the summaries are final and uniform
+      // chunks need no dispatch at all. They do not describe a DAG world.
+      if(!gpu_dag && picker->get_summary(int3{chunk_x, chunk_y, chunk_z}).uniform()) {
+        skipped_chunks++;
+        continue;
+      }
 
-      isosurface_meshing_pipeline.cmd_dispatch(
-        command_buffer,
-        1,
-        1,
-        1,
-        &isosurface_meshing_push
-      );
+      cmd_dispatch_meshing(command_buffer, int3{chunk_x, chunk_y, chunk_z});
 
     }
+      vk_context->get_profiler().cmd_end(command_buffer, profiler_scope);
+      if(meshing_timer) meshing_timer->cmd_end(command_buffer);
       vk_context->end_command_buffer(command_buffer);
       vk_context->queue_submit(
         command_buffer,
@@ -339,39 +474,13 @@ struct TerrainManager {
     meshing_chunks_progress.z = chunks_per_axis.z;
     
     if(meshing_chunks_progress == chunks_per_axis) {
+      const u32 dropped_meshes = take_dropped_meshes();
+      if(dropped_meshes > 0) {
+        throw std::runtime_error("Vertex buffer out of memory, " + std::to_string(dropped_meshes) + " chunk meshes did not fit!");
+      }
+      event_bus->notify(remeshed_event(nullptr, 0));
+      std::cout << "MESHING skipped " << skipped_chunks << " of " << COUNT_CHUNKS << " uniform chunks" << std::endl;
       std::cout << "MESHING all finished\n" << std::endl;
-      
-      VkCommandBuffer cmd_buf = vk_context->begin_command_buffers<1>();
-      isosurface_dc_pipeline.cmd_bind_pipeline(cmd_buf);
-
-      IsosurfaceDrawCollectionPush push{
-        .chunk_draw_info = SHADER_CAST(gpu_chunk_draw_info->device_address()),
-        .indirect = SHADER_CAST(gpu_indirect_cmds->device_address()),
-        .gpu_globals = SHADER_CAST(gpu_globals->device_address()),
-      };
-
-      isosurface_dc_pipeline.cmd_dispatch(
-        cmd_buf,
-        ((COUNT_CHUNKS_X+7)/8) * ((COUNT_CHUNKS_Y+7)/8) * ((COUNT_CHUNKS_Z+7)/8),
-        1,
-        1,
-        &push
-      );
-
-      vk_context->end_command_buffer(cmd_buf);
-      vk_context->queue_submit(
-        cmd_buf,
-        TmxSubmitInfo{
-          .queue = compute_queue,
-          .waitSemaphoreInfoCount = 0,
-          .pWaitSemaphoreInfos = nullptr,
-          .signalSemaphoreInfoCount = 0,
-          .pSignalSemaphoreInfos = nullptr,
-        }
-      );
-      vk_context->queue_wait_idle(compute_queue);
-      vk_context->free_command_buffers<1>(&cmd_buf);
-      
     }
     else {
       std::cout << "MESHING one finished" << std::endl;
@@ -382,16 +491,319 @@ struct TerrainManager {
 
 
   void modify_isosurface(const std::any &e) {
-    std::abort();
     const auto &event = std::any_cast<const IsosurfaceModificationEvent &>(e);
+
+    std::optional<TerrainHit> hit = picker->pick(event.ray);
+    if(!hit.has_value()) {
+      return;
+    }
+
+    queue_edit(
+      SdfEdit{
+        .center = hit.value().position,
+        .radius = event.radius,
+        .operation = static_cast<u32>(
+          event.operation == BRUSH_OPERATION_REMOVE ? SDF_OPERATION_SUBTRACT :
+          event.smoothing > 0.0f ? SDF_OPERATION_SMOOTH_UNION : SDF_OPERATION_UNION
+        ),
+        .shape = static_cast<u32>(event.shape == BRUSH_SHAPE_BOX ? SDF_SHAPE_BOX : SDF_SHAPE_SPHERE),
+        .smoothing = event.smoothing,
+        .pad = 0,
+      }
+    );
+  }
+
+  inline void queue_edit(const SdfEdit &edit) {
+    pending_edits.push_back(edit);
+  }
+
+  // Applies every edit queued this frame with a single dispatch over the
+  // touched chunks. The edit pass emits the chunks whose cells changed,
+  // which are then remeshed with one indirect dispatch.
+  void flush_edits(void) {
+    if(pending_edits.empty()) {
+      return;
+    }
+    TMX_ZONE("TerrainManager::flush_edits");
+
+    // Edits go to the voxel pool, which a DAG world is not backed by.
+    if(gpu_dag) {
+      std::cout << "Terrain is static while meshing from a DAG, dropping " << pending_edits.size() << " edits" << std::endl;
+      pending_edits.clear();
+      return;
+    }
+
+    const u32 edit_count = static_cast<u32>(glm::min<size_t>(pending_edits.size(), MAX_SDF_EDITS_PER_FRAME));
+    const int3 world_voxels = chunks_per_axis*int3{COUNT_VOXELS_X, COUNT_VOXELS_Y, COUNT_VOXELS_Z};
+    const int3 voxels_per_chunk{COUNT_VOXELS_X, COUNT_VOXELS_Y, COUNT_VOXELS_Z};
+
+    ChunkQueue *edit_chunks = gpu_edit_chunks->host_address();
+    u32 edit_chunk_count = 0;
+
+    for(u32 i = 0; i < edit_count; i++) {
+      const SdfEdit &edit = pending_edits[i];
+      memcpy(&gpu_edits->host_address()->value[i], &edit, sizeof(SdfEdit));
+
+      const f32 reach = edit.radius*(edit.shape == SDF_SHAPE_BOX ? glm::sqrt(3.0f) : 1.0f) + edit.smoothing + 1.0f;
+      const int3 lo = glm::max(int3{glm::floor(edit.center - reach)}, int3{0});
+      const int3 hi = glm::min(int3{glm::ceil(edit.center + reach)}, world_voxels - 1);
+      if(glm::any(glm::greaterThan(lo, hi))) {
+        continue;
+      }
+
+      const int3 chunk_lo = lo / voxels_per_chunk;
+      const int3 chunk_hi = hi / voxels_per_chunk;
+
+      for(i32 z = chunk_lo.z; z <= chunk_hi.z; z++) {
+      for(i32 y = chunk_lo.y; y <= chunk_hi.y; y++) {
+      for(i32 x = chunk_lo.x; x <= chunk_hi.x; x++) {
+        u8 &queued = edit_chunk_flags[chunk2idx(int3{x, y, z})];
+        if(!queued) {
+          queued = 1;
+          edit_chunks->chunks[edit_chunk_count++] = int4{x, y, z, 0};
+        }
+      }
+      }
+      }
+    }
+
+    pending_edits.erase(pending_edits.begin(), pending_edits.begin() + edit_count);
+
+    for(u32 i = 0; i < edit_chunk_count; i++) {
+      edit_chunk_flags[chunk2idx(int3{edit_chunks->chunks[i]})] = 0;
+    }
+
+    if(edit_chunk_count == 0) {
+      return;
+    }
+
+    gpu_dirty_chunks->host_address()->dispatch = uint3{0, 1, 1};
+
+    // In-flight frames may still be drawing from the pages being freed.
+    vk_context->queue_wait_idle(vk_context->get_graphics_queue());
+
+    // Nothing in flight reads the pool any more, so it can be reallocated.
+    u32 missing_bricks{0};
+    for(u32 i = 0; i < edit_chunk_count; i++) {
+      missing_bricks += !page_resident(brick_pool->page(int3{edit_chunks->chunks[i]}));
+    }
+    if(missing_bricks > brick_pool->free_count()) {
+      grow_voxel_pool(brick_pool->resident_count() + missing_bricks);
+    }
+
+    VkCommandBuffer command_buffer = vk_context->begin_command_buffers<1>();
+    const u32 profiler_scope = vk_context->get_profiler().cmd_begin(command_buffer, GPU_PASS_EDITS);
+
+    // Uniform chunks have no voxels to edit, so give each one a brick first.
+    // Chunks that still do not fit in the pool keep their sentinel and are dropped.
+    u32 resident_count{0};
+    for(u32 i = 0; i < edit_chunk_count; i++) {
+      const int4 chunk = edit_chunks->chunks[i];
+      if(!cmd_make_resident(command_buffer, int3{chunk})) {
+        std::cout << "Voxel pool exhausted, dropping edit to chunk (" << chunk.x << ", " << chunk.y << ", " << chunk.z << ")" << std::endl;
+        continue;
+      }
+      edit_chunks->chunks[resident_count++] = chunk;
+    }
+    edit_chunk_count = resident_count;
+
+    vk_context->cmd_memory_barrier(
+      command_buffer,
+      VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+      VK_ACCESS_2_TRANSFER_WRITE_BIT,
+      VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+      VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT
+    );
+
+    IsosurfaceEditPush isosurface_edit_push {
+      .pVoxels = SHADER_CAST(gpu_voxels->device_address()),
+      .pPageTable = SHADER_CAST(gpu_page_table->device_address()),
+      .pSummaries = SHADER_CAST(gpu_summaries->device_address()),
+      .pEdits = SHADER_CAST(gpu_edits->device_address()),
+      .pEditChunks = SHADER_CAST(gpu_edit_chunks->device_address()),
+      .pDirtyChunks = SHADER_CAST(gpu_dirty_chunks->device_address()),
+      .pDirtyFlags = SHADER_CAST(gpu_dirty_flags->device_address()),
+      .edit_count = edit_count,
+    };
+
+    isosurface_edit_pipeline.cmd_bind_pipeline(command_buffer);
+    isosurface_edit_pipeline.cmd_dispatch(
+      command_buffer,
+      edit_chunk_count,
+      1,
+      1,
+      &isosurface_edit_push
+    );
+
+    vk_context->cmd_memory_barrier(
+      command_buffer,
+      VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+      VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+      VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+      VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT
+    );
+
+    IsosurfaceMeshingPush isosurface_meshing_push = meshing_push(int3{0});
+    isosurface_meshing_push.pChunkQueue = SHADER_CAST(gpu_dirty_chunks->device_address());
+    isosurface_meshing_push.pDirtyFlags = SHADER_CAST(gpu_dirty_flags->device_address());
+
+    isosurface_meshing_pipeline.cmd_dispatch_indirect(
+      command_buffer,
+      gpu_dirty_chunks->vk_buffer(),
+      0,
+      &isosurface_meshing_push
+    );
+
+    vk_context->get_profiler().cmd_end(command_buffer, profiler_scope);
+    vk_context->end_command_buffer(command_buffer);
+    vk_context->queue_submit(
+      command_buffer,
+      TmxSubmitInfo{
+        .queue = compute_queue,
+        .waitSemaphoreInfoCount = 0,
+        .pWaitSemaphoreInfos = nullptr,
+        .signalSemaphoreInfoCount = 0,
+        .pSignalSemaphoreInfos = nullptr,
+      }
+    );
+    vk_context->queue_wait_idle(compute_queue);
+    vk_context->free_command_buffers<1>(&command_buffer);
+
+    const u32 dropped_meshes = take_dropped_meshes();
+    if(dropped_meshes > 0) {
+      std::cout << "Vertex buffer out of memory, " << dropped_meshes << " edited chunks left without a mesh" << std::endl;
+    }
+
+    // Carving out or filling in a whole chunk leaves nothing worth storing.
+    for(u32 i = 0; i < edit_chunk_count; i++) {
+      release_uniform_brick(int3{edit_chunks->chunks[i]});
+    }
+
+    const ChunkQueue *dirty_chunks = gpu_dirty_chunks->host_address();
+    event_bus->notify(remeshed_event(dirty_chunks->chunks, dirty_chunks->dispatch.x));
+  }
+
+  // Compresses the occupancy of the voxel pool into a DAG covering the world.
+  // Regions are bounded through the density summaries, so uniform chunks
+  // and bricks are never read voxel by voxel.
+  [[nodiscard]]
+  VoxelDag compress_terrain(void) const {
+    const int3 world_voxels = chunks_per_axis*int3{COUNT_VOXELS_X, COUNT_VOXELS_Y, COUNT_VOXELS_Z};
+    const int3 voxels_per_chunk{COUNT_VOXELS_X, COUNT_VOXELS_Y, COUNT_VOXELS_Z};
+    const float2 *summaries = gpu_summaries->host_address();
+
+    DagSource source {
+      .classify = [&](const int3 lo, const int3 hi) -> i32 {
+        if(glm::any(glm::greaterThanEqual(lo, world_voxels))) {
+          return DENSITY_CLASS_OUTSIDE;
+        }
+
+        // DAG leaves are exactly one summary brick.
+        float2 range{DENSITY_OUTSIDE_WORLD};
+        if(glm::all(glm::equal(hi - lo + 1, int3{COUNT_BRICK_VOXELS}))) {
+          range = summaries[summary_brick_index(lo / voxels_per_chunk, (lo % voxels_per_chunk) / COUNT_BRICK_VOXELS)];
+        }
+        else {
+          const int3 chunk_hi = glm::min(hi, world_voxels - 1) / voxels_per_chunk;
+          bool first = glm::all(glm::lessThan(hi, world_voxels));
+          for(i32 z = lo.z / COUNT_VOXELS_Z; z <= chunk_hi.z; z++) {
+          for(i32 y = lo.y / COUNT_VOXELS_Y; y <= chunk_hi.y; y++) {
+          for(i32 x = lo.x / COUNT_VOXELS_X; x <= chunk_hi.x; x++) {
+            const float2 summary = summaries[summary_chunk_index(int3{x, y, z})];
+            range = first ? summary : float2{glm::min(range.x, summary.x), glm::max(range.y, summary.y)};
+            first = false;
+          }
+          }
+          }
+        }
+
+        if(range.x >= 0.0f) return DENSITY_CLASS_OUTSIDE;
+        if(range.y < 0.0f) return DENSITY_CLASS_INSIDE;
+        return DENSITY_CLASS_SURFACE;
+      },
+      .leaf = [&](const int3 origin) -> u64 {
+        u64 mask{0};
+        for(i32 z = 0; z < DAG_LEAF_VOXELS; z++) {
+        for(i32 y = 0; y < DAG_LEAF_VOXELS; y++) {
+        for(i32 x = 0; x < DAG_LEAF_VOXELS; x++) {
+          if(picker->voxel(origin + int3{x, y, z}) < 0.0f) {
+            mask |= u64{1} << dag_leaf_bit(int3{x, y, z});
+          }
+        }
+        }
+        }
+        return mask;
+      },
+    };
+
+    return VoxelDag::build(VoxelDag::levels_for(world_voxels), source);
+  }
+
+  // Meshes from the DAG instead of the voxel pool from now on. The next
+  // IsosurfaceMeshingEvent remeshes every chunk.
+  void mesh_from_dag(const VoxelDag &dag) {
+    TMX_ZONE("TerrainManager::mesh_from_dag");
+    vk_context->queue_wait_idle(vk_context->get_graphics_queue());
+    vk_context->queue_wait_idle(compute_queue);
+
+    gpu_dag =
+      resource_manager->create_buffer<u32>(
+        dag.size_bytes(),
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        TMX_MEMORY_PROPERTY_UNIFIED,
+        TMX_BUFFER_CREATE_MAPPED_BIT
+      );
+    memcpy(gpu_dag->host_address(), dag.data().data(), dag.size_bytes());
+
+    meshing_chunks_progress = int3{0};
+    std::cout << "Meshing from a " << dag.size_bytes() << " byte voxel DAG, " << dag.side() << " voxels per axis" << std::endl;
+  }
+
+  [[nodiscard]] inline
+  const TerrainPicker &get_picker(void) const {
+    return *picker;
   }
 
 
   [[nodiscard]] inline
   u32 get_chunk_render_count(void) const {
-	  return gpu_globals->host_address()->mc_chunks_indirect_cmd_count;
+	  return glm::min<u32>(gpu_globals->host_address()->mc_chunks_indirect_cmd_count, COUNT_CHUNKS);
   }
   
+  [[nodiscard]] inline
+  u32 get_resident_brick_count(void) const {
+    return brick_pool->resident_count();
+  }
+
+  // Device memory behind every terrain buffer, whether or not it is used.
+  [[nodiscard]]
+  u64 get_allocated_bytes(void) const {
+    u64 bytes{0};
+    const auto add = [&](const auto &buffer) {
+      if(buffer) bytes += buffer->allocation_size();
+    };
+    add(gpu_LUT);
+    add(gpu_vertex_count_LUT);
+    add(gpu_edges_triangle_assembly_lut);
+    add(gpu_points_triangle_assembly_lut);
+    add(gpu_ptr_table);
+    add(gpu_voxels);
+    add(gpu_page_table);
+    add(gpu_summaries);
+    add(gpu_dag);
+    add(gpu_vertices);
+    add(gpu_allocator);
+    add(gpu_chunk_draw_info);
+    add(gpu_indirect_cmds);
+    add(gpu_globals);
+    add(gpu_edits);
+    add(gpu_edit_chunks);
+    add(gpu_dirty_chunks);
+    add(gpu_dirty_flags);
+    add(gpu_chunk_stats);
+    return bytes;
+  }
+
   [[nodiscard]] inline
   VkDrawIndirectCommand *get_indirect_cmds_host_address(void) const {
 	  return gpu_indirect_cmds->host_address();
@@ -407,30 +819,242 @@ struct TerrainManager {
 	  return gpu_indirect_cmds->vk_buffer();
   }
 
+  // Indexed by chunk2idx, null unless constructed with chunk_stats. Read
+  // once the passes writing it have completed.
+  [[nodiscard]] inline
+  const ChunkStat *get_chunk_stats(void) const {
+    return gpu_chunk_stats ? gpu_chunk_stats->host_address() : nullptr;
+  }
+
+  // Optional, time the GPU work of generation and meshing.
+  inline void set_timers(TimestampTimer *generation, TimestampTimer *meshing) {
+    generation_timer = generation;
+    meshing_timer = meshing;
+  }
+
 
   private:
+  // The *_clock variants count cycles for the chunk stats.
+  [[nodiscard]]
+  std::string shader_name(const std::string &name) const {
+    return chunk_stats && vk_context->shader_clock ? name + "_clock" : name;
+  }
+
+  [[nodiscard]]
+  IsosurfaceMeshingPush meshing_push(const int3 chunk) const {
+    return IsosurfaceMeshingPush {
+      .pAllocator = SHADER_CAST(gpu_allocator->device_address()),
+      .pMcPtrTable = SHADER_CAST(gpu_ptr_table->device_address()),
+      .pVertices = SHADER_CAST(gpu_vertices->device_address()),
+      .pVoxels = SHADER_CAST(gpu_voxels->device_address()),
+      .pPageTable = SHADER_CAST(gpu_page_table->device_address()),
+      .pSummaries = SHADER_CAST(gpu_summaries->device_address()),
+      .pChunkDrawInfo = SHADER_CAST(gpu_chunk_draw_info->device_address()),
+      .pIndirect = SHADER_CAST(gpu_indirect_cmds->device_address()),
+      .pGpuGlobals = SHADER_CAST(gpu_globals->device_address()),
+      .pChunkQueue = 0,
+      .pDirtyFlags = 0,
+      .pDag = gpu_dag ? SHADER_CAST(gpu_dag->device_address()) : 0,
+      .pChunkStats = gpu_chunk_stats ? SHADER_CAST(gpu_chunk_stats->device_address()) : 0,
+      .chunk_pos = int4{chunk, 0},
+    };
+  }
+
+  [[nodiscard]]
+  IsosurfaceRemeshedEvent remeshed_event(const int4 *chunks, const u32 chunk_count) const {
+    return IsosurfaceRemeshedEvent{
+      .chunks = chunks,
+      .chunk_count = chunk_count,
+      .vertices = gpu_vertices->host_address(),
+      .chunk_draw_info = gpu_chunk_draw_info->host_address(),
+      .indirect = gpu_indirect_cmds->host_address(),
+    };
+  }
+
+  // DensityBounds::classify_chunk for every chunk, generation reuses it.
+  [[nodiscard]]
+  static std::vector<i8> classify_chunks(void) {
+    TMX_ZONE("TerrainManager::classify_chunks");
+    std::vector<i8> classes(COUNT_CHUNKS);
+    for(u32 i = 0; i < COUNT_CHUNKS; i++) {
+      classes[i] = static_cast<i8>(DensityBounds::classify_chunk(idx2chunk(i)));
+    }
+    return classes;
+  }
+
+  [[nodiscard]]
+  std::unique_ptr< DeviceBuffer<DensityCode> > create_voxel_pool(const u32 capacity) const {
+    return resource_manager->create_buffer<DensityCode>(
+      sizeof(DensityCode)*COUNT_VOXELS*capacity,
+      VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+      TMX_MEMORY_PROPERTY_UNIFIED,
+      TMX_BUFFER_CREATE_MAPPED_BIT
+    );
+  }
+
+  // Meshes left out since the last call because the vertex buffer had no
+  // run of free pages long enough for them, see atomicMalloc.
+  u32 take_dropped_meshes(void) {
+    u32 &dropped = gpu_globals->host_address()->mc_dropped_meshes;
+    const u32 count = dropped;
+    dropped = 0;
+    return count;
+  }
+
+  // Reallocates the voxel pool with room for at least required bricks,
+  // doubling so a run of edits does not reallocate every frame. The queues
+  // must be idle. When the device is out of memory the pool is kept as is
+  // and the edits that do not fit are dropped.
+  void grow_voxel_pool(const u32 required) {
+    TMX_ZONE("TerrainManager::grow_voxel_pool");
+    const u32 capacity = brick_pool->slot_count();
+    const u32 new_capacity = glm::min<u32>(glm::max(required, capacity*2), COUNT_CHUNKS);
+
+    std::unique_ptr< DeviceBuffer<DensityCode> > voxels;
+    try {
+      voxels = create_voxel_pool(new_capacity);
+    }
+    catch(const std::runtime_error &error) {
+      std::cout << "Failed to grow the voxel pool to " << new_capacity << " bricks: " << error.what() << std::endl;
+      return;
+    }
+
+    memcpy(voxels->host_address(), gpu_voxels->host_address(), sizeof(DensityCode)*COUNT_VOXELS*capacity);
+    gpu_voxels = std::move(voxels);
+    brick_pool->grow(new_capacity);
+    picker = std::make_unique<TerrainPicker>(
+      gpu_voxels->host_address(),
+      gpu_page_table->host_address(),
+      gpu_summaries->host_address()
+    );
+    std::cout << "Voxel pool grown from " << capacity << " to " << new_capacity << " bricks, "
+              << gpu_voxels->allocation_size() << " bytes" << std::endl;
+  }
+
+  // Writes the summaries of a chunk holding a uniform density.
+  void cmd_fill_uniform_summaries(VkCommandBuffer command_buffer, const int3 chunk, const f32 density) {
+    // min == max == density, so both halves of every float2 share the pattern.
+    const u32 bits = std::bit_cast<u32>(density);
+
+    vkCmdFillBuffer(
+      command_buffer,
+      gpu_summaries->vk_buffer(),
+      summary_chunk_index(chunk)*sizeof(float2),
+      sizeof(float2),
+      bits
+    );
+    vkCmdFillBuffer(
+      command_buffer,
+      gpu_summaries->vk_buffer(),
+      summary_brick_index(chunk, int3{0})*sizeof(float2),
+      COUNT_BRICKS*sizeof(float2),
+      bits
+    );
+  }
+
+  // Gives a uniform chunk a brick holding its density so it can be edited.
+  bool cmd_make_resident(VkCommandBuffer command_buffer, const int3 chunk) {
+    const u32 page = brick_pool->page(chunk);
+    if(page_resident(page)) {
+      return true;
+    }
+
+    std::optional<u32> brick = brick_pool->make_resident(chunk);
+    if(!brick.has_value()) {
+      return false;
+    }
+
+    vkCmdFillBuffer(
+      command_buffer,
+      gpu_voxels->vk_buffer(),
+      pool_index(brick.value(), int3{0})*sizeof(DensityCode),
+      COUNT_VOXELS*sizeof(DensityCode),
+      density_fill_pattern(page_uniform_density(page))
+    );
+    return true;
+  }
+
+  // A density's code repeated over the 32 bits vkCmdFillBuffer writes.
+  [[nodiscard]]
+  static u32 density_fill_pattern(const f32 density) {
+    const DensityCode code = encode_density(density);
+    u32 pattern{0};
+    for(u32 i = 0; i < sizeof(u32)/sizeof(DensityCode); i++) {
+      memcpy(reinterpret_cast<u8 *>(&pattern) + i*sizeof(DensityCode), &code, sizeof(DensityCode));
+    }
+    return pattern;
+  }
+
+  // Returns a resident chunk's brick to the pool when all of its voxels hold
+  // exactly one of the sentinel densities.
+  void release_uniform_brick(const int3 chunk) {
+    if(!page_resident(brick_pool->page(chunk))) {
+      return;
+    }
+
+    const float2 summary = gpu_summaries->host_address()[summary_chunk_index(chunk)];
+    if(summary.x != summary.y) {
+      return;
+    }
+    if(summary.x == page_uniform_density(PAGE_UNIFORM_INSIDE)) {
+      brick_pool->make_uniform(chunk, PAGE_UNIFORM_INSIDE);
+    }
+    else if(summary.x == page_uniform_density(PAGE_UNIFORM_OUTSIDE)) {
+      brick_pool->make_uniform(chunk, PAGE_UNIFORM_OUTSIDE);
+    }
+  }
+
+  void cmd_dispatch_meshing(VkCommandBuffer command_buffer, const int3 chunk) {
+    IsosurfaceMeshingPush isosurface_meshing_push = meshing_push(chunk);
+
+    isosurface_meshing_pipeline.cmd_dispatch(
+      command_buffer,
+      1,
+      1,
+      1,
+      &isosurface_meshing_push
+    );
+  }
+
   Context* vk_context;
   EventBus* event_bus;
   ResourceManager* resource_manager;
   VkQueue compute_queue;
+  bool chunk_stats;
   
   GraphicsPipeline* pipeline;
   ComputePipeline isosurface_generation_pipeline
   {
-    "isosurface_generation",
+    shader_name("isosurface_generation"),
     sizeof(IsosurfaceGenerationPush),
-    vk_context->get_device()
+    vk_context
   };
   ComputePipeline isosurface_meshing_pipeline
   {
-    "isosurface_meshing",
+    shader_name("isosurface_meshing"),
     sizeof(IsosurfaceMeshingPush),
-    vk_context->get_device()
+    vk_context
+  };
+  ComputePipeline isosurface_edit_pipeline
+  {
+    "isosurface_edit",
+    sizeof(IsosurfaceEditPush),
+    vk_context
   };
 
   int3 chunks_per_axis{COUNT_CHUNKS_X, COUNT_CHUNKS_Y, COUNT_CHUNKS_Z};
   int3 isosurface_chunks_progress{0, 0, 0};
   int3 meshing_chunks_progress{0, 0, 0};
+
+  std::unique_ptr<TerrainPicker> picker;
+  std::unique_ptr<BrickPool> brick_pool;
+  std::vector<i8> chunk_classes;
+
+  TimestampTimer *generation_timer{nullptr};
+  TimestampTimer *meshing_timer{nullptr};
+
+  std::vector<SdfEdit> pending_edits;
+  std::vector<u8> edit_chunk_flags = std::vector<u8>(COUNT_CHUNKS, 0);
   
   std::unique_ptr< DeviceBuffer<i32> >                     gpu_LUT;
   std::unique_ptr< DeviceBuffer<u32> >                     gpu_vertex_count_LUT;
@@ -438,12 +1062,21 @@ struct TerrainManager {
   std::unique_ptr< DeviceBuffer<uint4> >                   gpu_points_triangle_assembly_lut;
   std::unique_ptr< DeviceBuffer<McPtrTable> >              gpu_ptr_table;
 
-  std::unique_ptr< DeviceBuffer<f32> >                     gpu_voxels;
+  std::unique_ptr< DeviceBuffer<DensityCode> >             gpu_voxels;
+  std::unique_ptr< DeviceBuffer<u32> >                     gpu_page_table;
+  std::unique_ptr< DeviceBuffer<float2> >                  gpu_summaries;
+  std::unique_ptr< DeviceBuffer<u32> >                     gpu_dag;
   std::unique_ptr< DeviceBuffer<float4> >                  gpu_vertices;
   std::unique_ptr< DeviceBuffer<Allocator> >               gpu_allocator;
   std::unique_ptr< DeviceBuffer<uint2> >                   gpu_chunk_draw_info;
   std::unique_ptr< DeviceBuffer<VkDrawIndirectCommand> >   gpu_indirect_cmds; 
   std::unique_ptr< DeviceBuffer<GpuGlobals> >              gpu_globals;
+
+  std::unique_ptr< DeviceBuffer<SdfEdits> >                gpu_edits;
+  std::unique_ptr< DeviceBuffer<ChunkQueue> >              gpu_edit_chunks;
+  std::unique_ptr< DeviceBuffer<ChunkQueue> >              gpu_dirty_chunks;
+  std::unique_ptr< DeviceBuffer<DirtyFlags> >              gpu_dirty_flags;
+  std::unique_ptr< DeviceBuffer<ChunkStat> >               gpu_chunk_stats;
 };
 
 }
@@ -0,0 +1 @@
+#include "voxel_dag.hpp"
\ No newline at end of file
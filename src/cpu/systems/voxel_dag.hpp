@@ -0,0 +1,293 @@
+#pragma once
+
+#include <push.inl>
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace tmx {
+
+// Occupancy source for VoxelDag::build. classify bounds an inclusive voxel
+// region as one of DENSITY_CLASS_*, so uniform subtrees are never sampled
+// (leave it empty to sample everything). leaf returns the 4^3 occupancy mask
+// of the leaf at origin, one bit per voxel at dag_leaf_bit().
+struct DagSource {
+  std::function<i32(int3, int3)> classify;
+  std::function<u64(int3)> leaf;
+};
+
+// Sparse voxel octree of occupancy with identical subtrees merged into a
+// DAG. Nodes are hash-consed as they are created, so both the bottom-up
+// build and path-copying single leaves share every repeated subtree.
+// Path copying leaves the replaced nodes behind until compact().
+// data() is the layout read by dag.glsl and is uploaded as is.
+struct VoxelDag {
+  public:
+  explicit VoxelDag(const u32 levels = 0) : words{DAG_EMPTY, levels} {}
+
+  // Offline: builds the DAG covering [0, side()) on every axis.
+  [[nodiscard]]
+  static VoxelDag build(const u32 levels, const DagSource &source) {
+    VoxelDag dag{levels};
+    dag.words[DAG_WORD_ROOT] = dag.build_node(int3{0}, levels, source);
+    return dag;
+  }
+
+  // Fewest levels whose side covers extent voxels on every axis.
+  [[nodiscard]]
+  static u32 levels_for(const int3 extent) {
+    const i32 longest = glm::max(extent.x, glm::max(extent.y, extent.z));
+    u32 levels{0};
+    while((DAG_LEAF_VOXELS << levels) < longest) {
+      levels++;
+    }
+    return levels;
+  }
+
+  // CPU mirror of dag_occupied() in dag.glsl.
+  [[nodiscard]]
+  bool occupied(const int3 voxel) const {
+    const int3 local = voxel & (DAG_LEAF_VOXELS - 1);
+    return (leaf_mask(voxel - local) >> dag_leaf_bit(local)) & 1;
+  }
+
+  // Occupancy mask of the leaf at origin, empty outside of the DAG.
+  [[nodiscard]]
+  u64 leaf_mask(const int3 origin) const {
+    if(glm::any(glm::lessThan(origin, int3{0})) || glm::any(glm::greaterThanEqual(origin, int3{side()}))) {
+      return 0;
+    }
+
+    u32 node = root();
+    for(u32 level = level_count(); level > 0 && node > DAG_FULL; level--) {
+      const u32 mask = words[node];
+      const u32 octant = dag_octant(origin, DAG_LEAF_VOXELS << (level - 1));
+      if(!((mask >> octant) & 1)) {
+        return 0;
+      }
+      node = words[node + 1 + std::popcount(mask & ((1u << octant) - 1u))];
+    }
+
+    if(node <= DAG_FULL) {
+      return node == DAG_FULL ? ~u64{0} : 0;
+    }
+    return u64{words[node]} | u64{words[node + 1]} << 32;
+  }
+
+  // Online: replaces the leaf at origin, copying the path above it.
+  void set_leaf(const int3 origin, const u64 mask) {
+    words[DAG_WORD_ROOT] = replace(root(), level_count(), origin, mask);
+  }
+
+  // Rebuilds the word array from the nodes still reachable from the root.
+  void compact(void) {
+    VoxelDag packed{level_count()};
+    std::unordered_map<u64, u32> remap;
+    packed.words[DAG_WORD_ROOT] = packed.copy_node(*this, root(), level_count(), remap);
+    *this = std::move(packed);
+  }
+
+  void save(const std::string &path) const {
+    std::ofstream file(path, std::ios::binary);
+    if(!file.is_open()) {
+      throw std::runtime_error("Failed to open " + path + " for writing!");
+    }
+    const u32 header[2] = {FILE_MAGIC, static_cast<u32>(words.size())};
+    file.write(reinterpret_cast<const char *>(header), sizeof(header));
+    file.write(reinterpret_cast<const char *>(words.data()), words.size()*sizeof(u32));
+  }
+
+  [[nodiscard]]
+  static VoxelDag load(const std::string &path) {
+    std::ifstream file(path, std::ios::binary);
+    if(!file.is_open()) {
+      throw std::runtime_error("Failed to open " + path + "!");
+    }
+    u32 header[2]{};
+    file.read(reinterpret_cast<char *>(header), sizeof(header));
+    if(header[0] != FILE_MAGIC || header[1] < DAG_HEADER_WORDS) {
+      throw std::runtime_error(path + " is not a voxel DAG!");
+    }
+
+    VoxelDag raw{};
+    raw.words.resize(header[1]);
+    file.read(reinterpret_cast<char *>(raw.words.data()), raw.words.size()*sizeof(u32));
+    if(!file) {
+      throw std::runtime_error(path + " is truncated!");
+    }
+
+    // Re-interning rebuilds the hash table so online updates share nodes again.
+    raw.compact();
+    return raw;
+  }
+
+  [[nodiscard]] inline
+  std::span<const u32> data(void) const { return words; }
+
+  [[nodiscard]] inline
+  u32 root(void) const { return words[DAG_WORD_ROOT]; }
+
+  [[nodiscard]] inline
+  u32 level_count(void) const { return words[DAG_WORD_LEVELS]; }
+
+  [[nodiscard]] inline
+  i32 side(void) const { return DAG_LEAF_VOXELS << level_count(); }
+
+  [[nodiscard]] inline
+  u64 size_bytes(void) const { return words.size()*sizeof(u32); }
+
+  private:
+  static constexpr u32 FILE_MAGIC = 0x47414454; // "TDAG"
+
+  u32 build_node(const int3 origin, const u32 level, const DagSource &source) {
+    const i32 size = DAG_LEAF_VOXELS << level;
+    const i32 region_class = source.classify ?
+      source.classify(origin, origin + size - 1) :
+      DENSITY_CLASS_SURFACE;
+    if(region_class == DENSITY_CLASS_OUTSIDE) return DAG_EMPTY;
+    if(region_class == DENSITY_CLASS_INSIDE) return DAG_FULL;
+
+    if(level == 0) {
+      return make_leaf(source.leaf(origin));
+    }
+
+    u32 children[8];
+    const i32 half = size / 2;
+    for(i32 i = 0; i < 8; i++) {
+      children[i] = build_node(origin + half*octant_offset(i), level - 1, source);
+    }
+    return make_interior(children);
+  }
+
+  u32 replace(const u32 node, const u32 level, const int3 origin, const u64 mask) {
+    if(level == 0) {
+      return make_leaf(mask);
+    }
+
+    u32 children[8];
+    expand(node, children);
+    const u32 octant = dag_octant(origin, DAG_LEAF_VOXELS << (level - 1));
+    children[octant] = replace(children[octant], level - 1, origin, mask);
+    return make_interior(children);
+  }
+
+  u32 copy_node(const VoxelDag &source, const u32 node, const u32 level, std::unordered_map<u64, u32> &remap) {
+    if(node <= DAG_FULL) {
+      return node;
+    }
+
+    // Leaves and interior nodes may share words, so the level is part of the key.
+    const u64 key = u64{node} << 8 | level;
+    if(auto it = remap.find(key); it != remap.end()) {
+      return it->second;
+    }
+
+    u32 copied;
+    if(level == 0) {
+      copied = make_leaf(u64{source.words[node]} | u64{source.words[node + 1]} << 32);
+    }
+    else {
+      u32 children[8];
+      source.expand(node, children);
+      for(u32 &child : children) {
+        child = copy_node(source, child, level - 1, remap);
+      }
+      copied = make_interior(children);
+    }
+
+    remap.emplace(key, copied);
+    return copied;
+  }
+
+  void expand(const u32 node, u32 (&children)[8]) const {
+    if(node <= DAG_FULL) {
+      std::fill(children, children + 8, node);
+      return;
+    }
+
+    const u32 mask = words[node];
+    u32 next = node + 1;
+    for(u32 i = 0; i < 8; i++) {
+      children[i] = (mask >> i) & 1 ? words[next++] : DAG_EMPTY;
+    }
+  }
+
+  u32 make_leaf(const u64 mask) {
+    if(mask == 0) return DAG_EMPTY;
+    if(mask == ~u64{0}) return DAG_FULL;
+
+    const u32 node[DAG_LEAF_WORDS] = {static_cast<u32>(mask), static_cast<u32>(mask >> 32)};
+    return intern(node, DAG_LEAF_WORDS);
+  }
+
+  // Children that are all empty or all solid collapse into their parent.
+  u32 make_interior(const u32 (&children)[8]) {
+    u32 node[9];
+    u32 count{1};
+    u32 mask{0};
+    bool full{true};
+    for(u32 i = 0; i < 8; i++) {
+      full &= children[i] == DAG_FULL;
+      if(children[i] != DAG_EMPTY) {
+        mask |= 1u << i;
+        node[count++] = children[i];
+      }
+    }
+
+    if(mask == 0) return DAG_EMPTY;
+    if(full) return DAG_FULL;
+
+    node[0] = mask;
+    return intern(node, count);
+  }
+
+  // Returns the index of an existing node with the same words, or appends it.
+  u32 intern(const u32 *node, const u32 count) {
+    const u64 hash = hash_words(node, count);
+    const auto [first, last] = lookup.equal_range(hash);
+    for(auto it = first; it != last; it++) {
+      if(it->second + count <= words.size() &&
+         std::memcmp(&words[it->second], node, count*sizeof(u32)) == 0) {
+        return it->second;
+      }
+    }
+
+    const u32 index = static_cast<u32>(words.size());
+    if(index + count < index) {
+      throw std::runtime_error("Voxel DAG exceeds 2^32 words!");
+    }
+    words.insert(words.end(), node, node + count);
+    lookup.emplace(hash, index);
+    return index;
+  }
+
+  [[nodiscard]]
+  static u64 hash_words(const u32 *node, const u32 count) {
+    u64 hash = 0xCBF29CE484222325ull ^ count;
+    for(u32 i = 0; i < count; i++) {
+      hash = (hash ^ node[i]) * 0x100000001B3ull;
+      hash ^= hash >> 29;
+    }
+    return hash;
+  }
+
+  [[nodiscard]] inline
+  static int3 octant_offset(const i32 octant) {
+    return int3{octant & 1, (octant >> 1) & 1, (octant >> 2) & 1};
+  }
+
+  std::vector<u32> words;
+  std::unordered_multimap<u64, u32> lookup;
+};
+
+}
@@ -50,6 +50,7 @@ namespace tmx {
       };
 
       VK_CHECK(vkAllocateMemory(vk_context->get_device(), &memory_allocate_info, nullptr, &memory));
+      memory_size = memory_requirements.size;
       VK_CHECK(vkBindBufferMemory(vk_context->get_device(), buffer, memory, 0));
 
       VkBufferDeviceAddressInfo bdai{.sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO, .buffer = buffer};
@@ -73,6 +74,10 @@ namespace tmx {
     [[nodiscard]] inline
     T* host_address(void) const { return mapped_address; }
 
+    // Bytes of device memory backing the buffer, at least its size.
+    [[nodiscard]] inline
+    VkDeviceSize allocation_size(void) const { return memory_size; }
+
     inline void map_memory(void) {
       VK_CHECK(vkMapMemory(vk_context->get_device(), memory, 0, buffer_size, 0, (void**)&mapped_address));
     }
@@ -105,6 +110,7 @@ namespace tmx {
     VkDeviceMemory memory{VK_NULL_HANDLE};
     T* buffer_device_address{};
     const VkDeviceSize buffer_size;
+    VkDeviceSize memory_size{0};
     T* mapped_address{nullptr};
   };
 }
@@ -1,11 +1,16 @@
 #pragma once
 
+#include "../core/cpu_profiler.hpp"
 #include "../core/utils.hpp"
 #include "../window.hpp"
 #include "../pipelines/graphics/graphics_pipeline.hpp"
+#include "gpu_profiler.hpp"
+#include "pipeline_cache.hpp"
 
 #include <set>
+#include <memory>
 #include <vector>
+#include <string>
 #include <cstring>
 #include <cstdlib>
 #include <optional>
@@ -64,6 +69,17 @@ namespace tmx {
     VkPipelineStageFlagBits2 dstStage;
   };
 
+  // A context without a window renders into offscreen images of this size
+  // and takes any device type, e.g. on render servers or lavapipe in CI.
+  struct TmxHeadlessInfo{
+    VkExtent2D extent;
+    // Off by default, the layers skew timings and CI images rarely ship them.
+    bool validation;
+    // Only devices whose name contains it, e.g. "llvmpipe". Empty takes
+    // the first compatible one.
+    std::string device_name{};
+  };
+
   struct TmxSubmitInfo{
     VkQueue queue;
     u32 waitSemaphoreInfoCount;
@@ -74,23 +90,45 @@ namespace tmx {
 
   struct Context {
     public:
-    Context(Window &window) : window{window} {
+    Context(Window &window) : window{&window} {
       create_vulkan_instance();
       setup_debug_messenger();
       create_surface();
       choose_physical_device();
       create_logical_device();
+      create_pipeline_cache();
       create_swapchain();
       create_swapchain_image_views();
       create_command_pool();
       create_command_buffers();
       create_syncronization_objects();
       create_depth_buffer();
+      create_profiler();
+    }
+
+    Context(const TmxHeadlessInfo &headless_info) : window{nullptr} {
+      enable_validation_layers = headless_info.validation;
+      device_name_filter = headless_info.device_name;
+      create_vulkan_instance();
+      setup_debug_messenger();
+      choose_physical_device();
+      create_logical_device();
+      create_pipeline_cache();
+      create_command_pool();
+      create_offscreen_images(headless_info.extent);
+      create_swapchain_image_views();
+      create_command_buffers();
+      create_syncronization_objects();
+      create_depth_buffer();
+      create_profiler();
     }
 
     ~Context(void) {
       std::cout << "Destroying Vulkan Objects!" << std::endl;
 
+      gpu_profiler.reset();
+      pipeline_cache.reset();
+
       if (enable_validation_layers) {
         destroyDebugUtilsMessengerEXT(instance, debug_messenger, nullptr);
       }
@@ -126,9 +164,21 @@ namespace tmx {
         vkDestroySemaphore(device, semaphore, nullptr);
       }
 
-      vkDestroySwapchainKHR(device, swapchain, nullptr);
+      if(is_headless()) {
+        for(auto &vk_image : swapchain_images) {
+          vkDestroyImage(device, vk_image, nullptr);
+        }
+        for(auto &vk_device_memory : offscreen_image_memories) {
+          vkFreeMemory(device, vk_device_memory, nullptr);
+        }
+      }
+      else {
+        vkDestroySwapchainKHR(device, swapchain, nullptr);
+      }
       vkDestroyDevice(device, nullptr);
-      vkDestroySurfaceKHR(instance, surface, nullptr);
+      if(!is_headless()) {
+        vkDestroySurfaceKHR(instance, surface, nullptr);
+      }
       vkDestroyInstance(instance, nullptr);
 
       std::cout << "Destroyed all Vulkan objects!" << std::endl;
@@ -137,6 +187,21 @@ namespace tmx {
     [[nodiscard]] inline
     u32 get_current_frame(void) { return current_frame; }
 
+    // Signalled once the current frame's submission completes, and waited on
+    // by rendering_begin_command_buffers when the frame comes around again.
+    [[nodiscard]] inline
+    VkFence get_in_flight_fence(void) const { return in_flight_fences[current_frame]; }
+
+    [[nodiscard]] inline
+    bool is_headless(void) const { return window == nullptr; }
+
+    [[nodiscard]] inline
+    VkExtent2D get_render_extent(void) const { return swapchain_extent; }
+
+    // Headless contexts leave the frame in TRANSFER_SRC_OPTIMAL for readback.
+    [[nodiscard]] inline
+    VkImage get_frame_image(void) const { return swapchain_images[image_index]; }
+
     [[nodiscard]] inline
     VkPhysicalDevice &get_physical_device(void) { return physical_device; }
 
@@ -158,6 +223,34 @@ namespace tmx {
     [[nodiscard]] inline
     VkDeviceSize get_non_coherent_atom_size(void) { return non_coherent_atom_size; }
 
+    [[nodiscard]] inline
+    const VkPhysicalDeviceLimits &get_limits(void) const { return limits; }
+
+    // Identifies the physical device across runs, e.g. for tuned settings.
+    [[nodiscard]] inline
+    const std::string &get_device_uuid(void) const { return device_uuid; }
+
+    [[nodiscard]] inline
+    const std::string &get_device_name(void) const { return device_name; }
+
+    // Zero when the compute queue cannot write timestamps.
+    [[nodiscard]] inline
+    u32 get_compute_timestamp_valid_bits(void) const { return compute_timestamp_valid_bits; }
+
+    [[nodiscard]] inline
+    GpuProfiler &get_profiler(void) { return *gpu_profiler; }
+
+    // Shared by every pipeline, it is internally synchronized so pipelines
+    // may be created from several threads at once.
+    [[nodiscard]] inline
+    VkPipelineCache get_pipeline_cache(void) const { return pipeline_cache->get_pipeline_cache(); }
+
+    // Subgroup size the compute shaders are specialized for. Pipelines pin it
+    // on devices with subgroup size control, elsewhere it is the smallest size
+    // the driver may pick, which bounds the subgroups of a workgroup.
+    [[nodiscard]] inline
+    u32 get_shader_subgroup_size(void) const { return subgroup_size_control ? subgroup_size : min_subgroup_size; }
+
 
    //********************************************************//
    //********************************************************//
@@ -193,6 +286,7 @@ namespace tmx {
     }
 
     inline void queue_submit(VkCommandBuffer command_buffer, const TmxSubmitInfo &info, VkFence fence = VK_NULL_HANDLE) {
+      TMX_ZONE("Context::queue_submit");
       const VkCommandBufferSubmitInfo cmd_buf_submit_info{
         .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO,
         .pNext = nullptr,
@@ -221,6 +315,7 @@ namespace tmx {
     }
 
     inline void queue_wait_idle(VkQueue queue) {
+      TMX_ZONE("Context::queue_wait_idle");
       VK_CHECK(vkQueueWaitIdle(queue));
     }
 
@@ -286,6 +381,37 @@ namespace tmx {
       vkFreeCommandBuffers(device, command_pool, 1, &command_buffer);
     }
 
+    void cmd_memory_barrier(
+      VkCommandBuffer command_buffer,
+      VkPipelineStageFlags2 src_stage,
+      VkAccessFlags2 src_access,
+      VkPipelineStageFlags2 dst_stage,
+      VkAccessFlags2 dst_access
+    ) {
+      const VkMemoryBarrier2 barrier{
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+        .pNext = nullptr,
+        .srcStageMask = src_stage,
+        .srcAccessMask = src_access,
+        .dstStageMask = dst_stage,
+        .dstAccessMask = dst_access,
+      };
+
+      const VkDependencyInfo dependency_info{
+        .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+        .pNext = nullptr,
+        .dependencyFlags = 0,
+        .memoryBarrierCount = 1,
+        .pMemoryBarriers = &barrier,
+        .bufferMemoryBarrierCount = 0,
+        .pBufferMemoryBarriers = nullptr,
+        .imageMemoryBarrierCount = 0,
+        .pImageMemoryBarriers = nullptr,
+      };
+
+      vkCmdPipelineBarrier2(command_buffer, &dependency_info);
+    }
+
     void copy_buffer(const TmxCopyBufferInfo &info) {
       VkCommandBuffer command_buffer = begin_command_buffers<1>();
 
@@ -373,14 +499,21 @@ namespace tmx {
     //***************************************************//
 
     VkCommandBuffer rendering_begin_command_buffers(void) {
+      TMX_ZONE("Context::rendering_begin_command_buffers");
       //  Block host and wait for 1 second
       VK_CHECK(vkWaitForFences(device, 1, &in_flight_fences[current_frame], VK_TRUE, 1000000000));
 
       VK_CHECK(vkResetFences(device, 1, &in_flight_fences[current_frame]));
-      
-      // Aquire the next swapchain image, timeout => 1 second
+
+      gpu_profiler->begin_frame();
+
+      // Aquire the next swapchain image, timeout => 1 second. Offscreen
+      // images belong to a frame in flight, there is nothing to acquire.
       #pragma diag_suppress 20
-      do {
+      if(is_headless()) {
+        image_index = current_frame;
+      }
+      else do {
         VkResult result =
           vkAcquireNextImageKHR(
             device,
@@ -554,10 +687,10 @@ namespace tmx {
         .pNext = nullptr,
         .srcStageMask = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
         .srcAccessMask = VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
-        .dstStageMask = VK_PIPELINE_STAGE_2_BOTTOM_OF_PIPE_BIT,
-        .dstAccessMask = 0,
+        .dstStageMask = is_headless() ? VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT : VK_PIPELINE_STAGE_2_BOTTOM_OF_PIPE_BIT,
+        .dstAccessMask = is_headless() ? VK_ACCESS_2_TRANSFER_READ_BIT : VK_ACCESS_2_NONE,
         .oldLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
-        .newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+        .newLayout = is_headless() ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
         .image = swapchain_images[image_index],
         .subresourceRange = {
           .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
@@ -577,7 +710,7 @@ namespace tmx {
         .dstStageMask = VK_PIPELINE_STAGE_2_BOTTOM_OF_PIPE_BIT,
         .dstAccessMask = 0,
         .oldLayout = VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL,
-        .newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+        .newLayout = is_headless() ? VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
         .image = depth_images[image_index],
         .subresourceRange = {
           .aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT,
@@ -613,6 +746,14 @@ namespace tmx {
     }
 
     void queue_submit_and_present(VkCommandBuffer &command_buffer) {
+      TMX_ZONE("Context::queue_submit_and_present");
+
+      // Without a swapchain there is nothing to wait for or present to.
+      if(is_headless()) {
+        queue_submit(command_buffer, TmxSubmitInfo{graphics_queue, 0, nullptr, 0, nullptr}, in_flight_fences[current_frame]);
+        current_frame = (current_frame + 1) % RENDERER_FRAMES_IN_FLIGHT;
+        return;
+      }
 
       VkSemaphoreSubmitInfo wait{
         .sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
@@ -673,9 +814,15 @@ namespace tmx {
 
     u32 current_frame{0};
     u32 subgroup_size{0};
+    u32 min_subgroup_size{0};
+    bool subgroup_size_control{false};
+    // VK_KHR_shader_clock with shaderSubgroupClock, the chunk stats then
+    // count cycles, see ChunkStat.
+    bool shader_clock{false};
 
     private:
-    const bool enable_validation_layers = true;
+    bool enable_validation_layers{true};
+    std::string device_name_filter{};
 
     const std::vector<const char *> validation_layers{
       "VK_LAYER_KHRONOS_validation"
@@ -683,8 +830,10 @@ namespace tmx {
 
     std::vector<const char *> get_required_extensions(void) {
       u32 glfw_extension_count = 0;
-      const char **glfw_extensions;
-      glfw_extensions = glfwGetRequiredInstanceExtensions(&glfw_extension_count);
+      const char **glfw_extensions{nullptr};
+      if(!is_headless()) {
+        glfw_extensions = glfwGetRequiredInstanceExtensions(&glfw_extension_count);
+      }
 
       std::vector<const char *> extensions(glfw_extensions, glfw_extensions + glfw_extension_count);
 
@@ -816,7 +965,8 @@ namespace tmx {
 
       bool bindless_images_supported = descriptor_indexing.descriptorBindingPartiallyBound && descriptor_indexing.runtimeDescriptorArray;
 
-      bool compatible_device_type = props.deviceType == DESIRED_PHYSICAL_DEVICE_TYPE;
+      // choose_physical_device still prefers the desired type when headless.
+      bool compatible_device_type = is_headless() || props.deviceType == DESIRED_PHYSICAL_DEVICE_TYPE;
       
       if(compatible_device_type && bindless_images_supported) {
         u32 queue_family_count{0};
@@ -835,8 +985,14 @@ namespace tmx {
             queue_family_indices.compute_family = i;
           }
 
+          // Headless contexts never present, the graphics queue stands in.
           VkBool32 present_support{false};
-          VK_CHECK(vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &present_support));
+          if(is_headless()) {
+            present_support = queue_family_indices.graphics_family == static_cast<u32>(i);
+          }
+          else {
+            VK_CHECK(vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &present_support));
+          }
           if(present_support) {
             queue_family_indices.present_family = i;
           }
@@ -851,10 +1007,32 @@ namespace tmx {
       return queue_family_indices;
     }
 
+    [[nodiscard]]
+    std::vector<const char *> get_device_extensions(void) const {
+      if(is_headless()) {
+        return {};
+      }
+      return {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
+    }
+
+    [[nodiscard]]
+    bool device_extension_available(VkPhysicalDevice device, const char *name) {
+      u32 extension_count;
+      VK_CHECK(vkEnumerateDeviceExtensionProperties(device, nullptr, &extension_count, nullptr));
+
+      std::vector<VkExtensionProperties> available_extensions(extension_count);
+      VK_CHECK(vkEnumerateDeviceExtensionProperties(device, nullptr, &extension_count, available_extensions.data()));
+
+      for(const auto &extension : available_extensions) {
+        if(std::string{extension.extensionName} == name) {
+          return true;
+        }
+      }
+      return false;
+    }
+
     bool check_device_extension_support(VkPhysicalDevice device) {
-      const std::vector<const char*> device_extensions{
-        VK_KHR_SWAPCHAIN_EXTENSION_NAME,
-      };
+      const std::vector<const char*> device_extensions = get_device_extensions();
 
       u32 extension_count;
       VK_CHECK(vkEnumerateDeviceExtensionProperties(device, nullptr, &extension_count, nullptr));
@@ -898,7 +1076,9 @@ namespace tmx {
       bool extensions_supported = check_device_extension_support(device);
 
       bool swapchain_compatible{false};
-      if (extensions_supported) {
+      if (extensions_supported && is_headless()) {
+        swapchain_compatible = true;
+      } else if (extensions_supported) {
         SwapchainSupportDetails swapchain_support = query_swapchain_support(device);
         swapchain_compatible = !swapchain_support.surface_formats.empty() && !swapchain_support.present_modes.empty();
       } else {
@@ -917,10 +1097,19 @@ namespace tmx {
       std::vector<VkPhysicalDevice> devices(device_count);
       vkEnumeratePhysicalDevices(instance, &device_count, devices.data());
 
+      // Headless contexts take any device type, the desired one first.
+      std::stable_partition(devices.begin(), devices.end(), [](VkPhysicalDevice device) {
+        VkPhysicalDeviceProperties props;
+        vkGetPhysicalDeviceProperties(device, &props);
+        return props.deviceType == DESIRED_PHYSICAL_DEVICE_TYPE;
+      });
+
       for (const auto &device : devices) {
         VkPhysicalDeviceProperties props;
         vkGetPhysicalDeviceProperties(device, &props);
         std::cout << "Found device: " << props.deviceName << std::endl;
+        if (std::string{props.deviceName}.find(device_name_filter) == std::string::npos)
+          continue;
         if (device_is_compatible(device)) {
           physical_device = device;
           break;
@@ -933,12 +1122,18 @@ namespace tmx {
       VkPhysicalDeviceProperties props;
       vkGetPhysicalDeviceProperties(physical_device, &props);
       non_coherent_atom_size = props.limits.nonCoherentAtomSize;
+      limits = props.limits;
 
       std::cout << "VkPhysicalDevice " << props.deviceName << "\n";
 
+      VkPhysicalDeviceIDProperties id_properties{
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES,
+        .pNext = nullptr,
+      };
+
       VkPhysicalDeviceSubgroupSizeControlProperties subgroup_size_control_properties{
         .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SUBGROUP_SIZE_CONTROL_PROPERTIES,
-        .pNext = nullptr,
+        .pNext = &id_properties,
       };
 
       VkPhysicalDeviceSubgroupProperties subgroup_properties{
@@ -954,6 +1149,21 @@ namespace tmx {
       vkGetPhysicalDeviceProperties2(physical_device, &physical_device_properties);
       subgroup_size = subgroup_properties.subgroupSize;
 
+      device_name = props.deviceName;
+      device_uuid.clear();
+      for(const u8 byte : id_properties.deviceUUID) {
+        const char *digits = "0123456789abcdef";
+        device_uuid += digits[byte >> 4];
+        device_uuid += digits[byte & 15];
+      }
+      min_subgroup_size = subgroup_size_control_properties.minSubgroupSize != 0 ?
+        subgroup_size_control_properties.minSubgroupSize :
+        subgroup_size;
+      subgroup_size_control =
+        (subgroup_size_control_properties.requiredSubgroupSizeStages & VK_SHADER_STAGE_COMPUTE_BIT) != 0 &&
+        subgroup_size >= subgroup_size_control_properties.minSubgroupSize &&
+        subgroup_size <= subgroup_size_control_properties.maxSubgroupSize;
+
       VkSubgroupFeatureFlags required_feature_flags{
         VK_SUBGROUP_FEATURE_BASIC_BIT |
         VK_SUBGROUP_FEATURE_ARITHMETIC_BIT |
@@ -967,8 +1177,6 @@ namespace tmx {
           (subgroup_properties.supportedStages & VK_SHADER_STAGE_COMPUTE_BIT) != VK_SHADER_STAGE_COMPUTE_BIT
           ||
           (subgroup_properties.supportedOperations & required_feature_flags) != required_feature_flags
-          ||
-          (subgroup_size_control_properties.requiredSubgroupSizeStages & VK_SHADER_STAGE_COMPUTE_BIT) != VK_SHADER_STAGE_COMPUTE_BIT
       ) {
         throw std::runtime_error("Device selection failed. Cause: Insufficient subgroupOp support...");
       }
@@ -1007,9 +1215,14 @@ namespace tmx {
         .pNext = &variable_ptr_features,
       };
 
+      VkPhysicalDevice16BitStorageFeatures bit16_features{
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_16BIT_STORAGE_FEATURES,
+        .pNext = &float16_int8_features,
+      };
+
       VkPhysicalDevice8BitStorageFeatures bit8_features{
         .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_8BIT_STORAGE_FEATURES,
-        .pNext = &float16_int8_features,
+        .pNext = &bit16_features,
       };
 
       VkPhysicalDeviceDescriptorIndexingFeatures descriptor_indexing_features{
@@ -1042,14 +1255,27 @@ namespace tmx {
         .maintenance4 = VK_TRUE,
       };
 
+      // Optional, only chained where the extension exists.
+      VkPhysicalDeviceShaderClockFeaturesKHR shader_clock_features{
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_CLOCK_FEATURES_KHR,
+        .pNext = &features13,
+      };
+      const bool shader_clock_extension = device_extension_available(physical_device, VK_KHR_SHADER_CLOCK_EXTENSION_NAME);
+
       VkPhysicalDeviceFeatures2 device_features{
         .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
-        .pNext = &features13,
+        .pNext = shader_clock_extension ? static_cast<void *>(&shader_clock_features) : static_cast<void *>(&features13),
       };
       vkGetPhysicalDeviceFeatures2(physical_device, &device_features);
+      shader_clock = shader_clock_extension && shader_clock_features.shaderSubgroupClock;
+      // The snorm density encodings read i8 and i16 codes from the voxel pool.
       assert(bit8_features.storageBuffer8BitAccess);
-      assert(features13.subgroupSizeControl);
-      assert(features13.computeFullSubgroups);
+      assert(float16_int8_features.shaderInt8);
+      assert(bit16_features.storageBuffer16BitAccess);
+      assert(device_features.features.shaderInt16);
+      // Optional, without it the compute shaders run with whatever subgroup
+      // size the driver picks, see get_shader_subgroup_size.
+      subgroup_size_control = subgroup_size_control && features13.subgroupSizeControl;
       assert(features13.synchronization2);
       assert(features13.dynamicRendering);
       assert(features13.maintenance4);
@@ -1057,9 +1283,13 @@ namespace tmx {
       assert(descriptor_indexing_features.descriptorBindingPartiallyBound);
       assert(descriptor_indexing_features.descriptorBindingStorageBufferUpdateAfterBind);
 
-      const std::vector<const char*> device_extensions{
-        VK_KHR_SWAPCHAIN_EXTENSION_NAME,
-      };
+      std::vector<const char*> device_extensions = get_device_extensions();
+      if(shader_clock) {
+        device_extensions.push_back(VK_KHR_SHADER_CLOCK_EXTENSION_NAME);
+      }
+      else {
+        device_features.pNext = &features13;
+      }
 
       VkDeviceCreateInfo device_create_info{
         .sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
@@ -1079,10 +1309,19 @@ namespace tmx {
       vkGetDeviceQueue(device, queue_family_indices.graphics_family.value(), 0, &graphics_queue);
       vkGetDeviceQueue(device, queue_family_indices.compute_family.value(), 0, &compute_queue);
       vkGetDeviceQueue(device, queue_family_indices.present_family.value(), 0, &present_queue);
+
+      u32 queue_family_count{0};
+      vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &queue_family_count, nullptr);
+      std::vector<VkQueueFamilyProperties> queue_families(queue_family_count);
+      vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &queue_family_count, queue_families.data());
+      compute_timestamp_valid_bits = queue_families[queue_family_indices.compute_family.value()].timestampValidBits;
+      graphics_timestamp_valid_bits = queue_families[queue_family_indices.graphics_family.value()].timestampValidBits;
+      // Enabled along with every other supported feature above.
+      pipeline_statistics_query = device_features.features.pipelineStatisticsQuery;
     }
 
     void create_surface(void) {
-      VK_CHECK(glfwCreateWindowSurface(instance, window.get_glfw_window(), nullptr, &surface));
+      VK_CHECK(glfwCreateWindowSurface(instance, window->get_glfw_window(), nullptr, &surface));
     }
 
     VkSurfaceFormatKHR choose_swapchain_surface_format(const std::vector<VkSurfaceFormatKHR> &available_formats) {
@@ -1127,7 +1366,7 @@ namespace tmx {
       
       VkSurfaceFormatKHR surface_format = choose_swapchain_surface_format(swapchain_support.surface_formats);
       VkPresentModeKHR present_mode = choose_swapchain_present_mode(swapchain_support.present_modes);
-      VkExtent2D extent = choose_swapchain_extent(swapchain_support.surface_capabilities, window.get_glfw_window());
+      VkExtent2D extent = choose_swapchain_extent(swapchain_support.surface_capabilities, window->get_glfw_window());
 
       image_count = swapchain_support.surface_capabilities.minImageCount + 1;
 
@@ -1180,6 +1419,60 @@ namespace tmx {
       swapchain_extent = extent;
     }
 
+    // Stand-ins for the swapchain images, one per frame in flight, so the
+    // rendering code is the same with and without a window.
+    void create_offscreen_images(const VkExtent2D extent) {
+      swapchain_image_format = choose_supported_format(
+        {VK_FORMAT_B8G8R8A8_SRGB, VK_FORMAT_R8G8B8A8_SRGB, VK_FORMAT_R8G8B8A8_UNORM},
+        VK_IMAGE_TILING_OPTIMAL,
+        VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT | VK_FORMAT_FEATURE_TRANSFER_SRC_BIT
+      );
+      swapchain_extent = extent;
+      image_count = RENDERER_FRAMES_IN_FLIGHT;
+
+      swapchain_images.resize(image_count);
+      offscreen_image_memories.resize(image_count);
+
+      for(u32 i = 0; i < image_count; i++) {
+        VkImageCreateInfo image_create_info {
+          .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+          .pNext = nullptr,
+          .flags = 0,
+          .imageType = VK_IMAGE_TYPE_2D,
+          .format = swapchain_image_format,
+          .extent =
+            {
+              .width = extent.width,
+              .height = extent.height,
+              .depth = 1,
+            },
+          .mipLevels = 1,
+          .arrayLayers = 1,
+          .samples = VK_SAMPLE_COUNT_1_BIT,
+          .tiling = VK_IMAGE_TILING_OPTIMAL,
+          .usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+          .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+          .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+        };
+
+        VK_CHECK(vkCreateImage(device, &image_create_info, nullptr, &swapchain_images[i]));
+
+        VkMemoryRequirements memory_requirements;
+        vkGetImageMemoryRequirements(device, swapchain_images[i], &memory_requirements);
+
+        VkMemoryAllocateInfo allocation_info{
+          .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+          .allocationSize = memory_requirements.size,
+          .memoryTypeIndex = find_image_memory_type(physical_device, memory_requirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT),
+        };
+
+        VK_CHECK(vkAllocateMemory(device, &allocation_info, nullptr, &offscreen_image_memories[i]));
+        VK_CHECK(vkBindImageMemory(device, swapchain_images[i], offscreen_image_memories[i], 0));
+      }
+
+      std::cout << "Offscreen " << extent.width << "x" << extent.height << ", image count: " << image_count << std::endl;
+    }
+
     void create_swapchain_image_views(void) {
       swapchain_image_views.resize(swapchain_images.size());
 
@@ -1210,6 +1503,20 @@ namespace tmx {
       }
     }
 
+    void create_pipeline_cache(void) {
+      pipeline_cache = std::make_unique<PipelineCache>(device, physical_device);
+    }
+
+    void create_profiler(void) {
+      gpu_profiler = std::make_unique<GpuProfiler>(
+        device,
+        limits.timestampPeriod,
+        compute_timestamp_valid_bits,
+        graphics_timestamp_valid_bits,
+        pipeline_statistics_query
+      );
+    }
+
     void create_command_pool(void) {
       QueueFamilyIndices queue_family_indices = get_queue_family_indices(physical_device);
 
@@ -1388,9 +1695,9 @@ namespace tmx {
       }
     }
     
-    Window &window;
+    Window *window;
     VkInstance instance;
-    VkSurfaceKHR surface;
+    VkSurfaceKHR surface{VK_NULL_HANDLE};
 
     VkDebugUtilsMessengerEXT debug_messenger;
 
@@ -1400,6 +1707,16 @@ namespace tmx {
     VkQueue compute_queue;
     VkQueue present_queue;
     VkDeviceSize non_coherent_atom_size;
+    VkPhysicalDeviceLimits limits{};
+    std::string device_name;
+    std::string device_uuid;
+    u32 compute_timestamp_valid_bits{0};
+    u32 graphics_timestamp_valid_bits{0};
+    bool pipeline_statistics_query{false};
+
+    static_assert(GPU_PROFILER_FRAMES > RENDERER_FRAMES_IN_FLIGHT, "Profiler slots must outlive the frames in flight");
+    std::unique_ptr<GpuProfiler> gpu_profiler;
+    std::unique_ptr<PipelineCache> pipeline_cache;
 
     u32 image_index;
     u32 image_count;
@@ -1408,6 +1725,7 @@ namespace tmx {
     VkExtent2D swapchain_extent;
     std::vector<VkImage> swapchain_images;
     std::vector<VkImageView> swapchain_image_views;
+    std::vector<VkDeviceMemory> offscreen_image_memories;
     VkFormat depth_image_format;
     std::vector<VkDeviceMemory> depth_image_memories;
     std::vector<VkImage> depth_images;
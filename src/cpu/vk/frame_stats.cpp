@@ -0,0 +1 @@
+#include "frame_stats.hpp"
\ No newline at end of file
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <types.inl>
+
+#include "../core/latency_histogram.hpp"
+#include "../core/utils.hpp"
+
+#include "gpu_profiler.hpp"
+
+#include <vulkan/vulkan.h>
+
+#include <array>
+#include <chrono>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+namespace tmx {
+
+enum FrameMetric {
+  FRAME_METRIC_FRAME,
+  FRAME_METRIC_CPU_SUBMIT,
+  FRAME_METRIC_GPU,
+  FRAME_METRIC_INPUT_LATENCY,
+  FRAME_METRIC_COUNT,
+};
+
+inline constexpr const char *FRAME_METRIC_NAMES[FRAME_METRIC_COUNT] = {
+  "frame",
+  "cpu_submit",
+  "gpu",
+  "input_latency",
+};
+
+// Histograms of what a frame costs, for stutter rather than averages:
+// - frame, host time between the starts of consecutive frames
+// - cpu_submit, host time from the frame's start until it is presented
+// - gpu, every pass GpuProfiler timed in the frame
+// - input_latency, from sampling input until the frame's fence signals
+//
+// Without present timing on every platform, input_latency ends at the
+// fence rather than the photons, it leaves out scan out and compositing.
+// Fences are polled once per frame, so it reads up to a frame high.
+struct FrameStats {
+  public:
+  using Clock = std::chrono::steady_clock;
+
+  void frame(const f64 frame_ms) {
+    histograms[FRAME_METRIC_FRAME].record(frame_ms);
+  }
+
+  // Call once the frame is presented, with the fence get_in_flight_fence
+  // gave before the submit, the frame's start and when its input was sampled.
+  void submitted(VkFence fence, const Clock::time_point frame_start, const Clock::time_point input_time) {
+    histograms[FRAME_METRIC_CPU_SUBMIT].record(elapsed_ms(frame_start, Clock::now()));
+    in_flight.push_back(InFlightFrame{fence, input_time});
+  }
+
+  // Call before rendering_begin_command_buffers waits on reused, the frame
+  // using it is waited on here instead, which costs nothing extra.
+  void retire(VkDevice device, VkFence reused) {
+    while(!in_flight.empty()) {
+      const InFlightFrame &oldest = in_flight.front();
+      if(oldest.fence == reused) {
+        VK_CHECK(vkWaitForFences(device, 1, &oldest.fence, VK_TRUE, 1000000000));
+      }
+      else if(vkGetFenceStatus(device, oldest.fence) != VK_SUCCESS) {
+        break;
+      }
+      histograms[FRAME_METRIC_INPUT_LATENCY].record(elapsed_ms(oldest.input_time, Clock::now()));
+      in_flight.pop_front();
+    }
+  }
+
+  // Takes the frames GpuProfiler collected, profiler frame 0 being the
+  // startup generation and meshing.
+  void collect_gpu(GpuProfiler &profiler) {
+    for(const GpuFrameTime &frame_time : profiler.take_frame_times()) {
+      if(frame_time.frame > 0) {
+        histograms[FRAME_METRIC_GPU].record(frame_time.ms);
+      }
+    }
+  }
+
+  [[nodiscard]] inline
+  const LatencyHistogram &get_histogram(const FrameMetric metric) const { return histograms[metric]; }
+
+  void print_report(void) const {
+    for(u32 metric = 0; metric < FRAME_METRIC_COUNT; metric++) {
+      const LatencyHistogram &histogram = histograms[metric];
+      if(histogram.count() == 0) {
+        continue;
+      }
+      std::cout << "FRAME " << FRAME_METRIC_NAMES[metric] << ": "
+                << histogram.percentile_ms(0.5) << " p50, " << histogram.percentile_ms(0.9) << " p90, "
+                << histogram.percentile_ms(0.99) << " p99, " << histogram.percentile_ms(0.999) << " p99.9, "
+                << histogram.max_ms() << " max ms over " << histogram.count() << " frames" << std::endl;
+    }
+  }
+
+  void export_json(const std::string &path) const {
+    std::ofstream file(path, std::ios::trunc);
+    if(!file.is_open()) {
+      throw std::runtime_error("Failed to open " + path + " for writing!");
+    }
+
+    file << "{";
+    for(u32 metric = 0; metric < FRAME_METRIC_COUNT; metric++) {
+      file << (metric == 0 ? "" : ",") << "\"" << FRAME_METRIC_NAMES[metric] << "\":";
+      histograms[metric].write_json(file);
+    }
+    file << "}\n";
+    std::cout << "Frame stats of " << histograms[FRAME_METRIC_FRAME].count() << " frames written to " << path << std::endl;
+  }
+
+  private:
+  struct InFlightFrame {
+    VkFence fence;
+    Clock::time_point input_time;
+  };
+
+  [[nodiscard]]
+  static f64 elapsed_ms(const Clock::time_point begin, const Clock::time_point end) {
+    return std::chrono::duration<f64, std::chrono::milliseconds::period>(end - begin).count();
+  }
+
+  std::array<LatencyHistogram, FRAME_METRIC_COUNT> histograms{};
+  std::deque<InFlightFrame> in_flight;
+};
+
+}
@@ -0,0 +1 @@
+#include "gpu_profiler.hpp"
\ No newline at end of file
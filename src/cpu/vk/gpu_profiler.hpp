@@ -0,0 +1,383 @@
+#pragma once
+
+#include <types.inl>
+
+#include "../core/utils.hpp"
+
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <array>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace tmx {
+
+enum GpuPass {
+  GPU_PASS_GENERATION,
+  GPU_PASS_MESHING,
+  GPU_PASS_EDITS,
+  GPU_PASS_RASTERIZATION,
+  GPU_PASS_COUNT,
+};
+
+inline constexpr const char *GPU_PASS_NAMES[GPU_PASS_COUNT] = {
+  "generation",
+  "meshing",
+  "edits",
+  "rasterization",
+};
+
+// Query slots cycled through, results are read back when a slot comes
+// around again, by which point its frame's fence has long been waited on.
+#define GPU_PROFILER_FRAMES (4)
+// Scopes per slot, startup meshing records one per row of chunks and drops
+// the excess.
+#define GPU_PROFILER_MAX_SCOPES (1024)
+// Samples per pass the rolling min/avg/p99 are taken over.
+#define GPU_PROFILER_WINDOW (512)
+// Samples kept for export_csv, older ones are dropped.
+#define GPU_PROFILER_MAX_HISTORY (1 << 20)
+// Frames between the reports Application prints.
+#define GPU_PROFILER_REPORT_INTERVAL (1000)
+
+#define GPU_PROFILER_NO_SCOPE (~0u)
+
+// Invocation counters of one scope, zero without pipelineStatisticsQuery.
+struct GpuPassStatistics {
+  u64 compute_invocations;
+  u64 vertex_invocations;
+  u64 fragment_invocations;
+  u64 primitives;
+};
+
+struct GpuPassSample {
+  u64 frame;
+  GpuPass pass;
+  f64 ms;
+  GpuPassStatistics statistics;
+};
+
+// Every pass a profiler frame recorded, summed.
+struct GpuFrameTime {
+  u64 frame;
+  f64 ms;
+};
+
+struct GpuPassReport {
+  u32 samples;
+  f64 min_ms;
+  f64 avg_ms;
+  f64 p99_ms;
+};
+
+// Times passes with timestamp queries and counts their invocations with
+// pipeline statistics queries. Nothing waits on the GPU: a scope's results
+// are read when its slot is reused GPU_PROFILER_FRAMES frames later, or in
+// flush() once the device is idle.
+struct GpuProfiler {
+  public:
+  GpuProfiler(
+    VkDevice device,
+    const f32 timestamp_period,
+    const u32 compute_timestamp_valid_bits,
+    const u32 graphics_timestamp_valid_bits,
+    const bool pipeline_statistics
+  ) : device{device},
+      timestamp_period{timestamp_period},
+      compute_mask{valid_mask(compute_timestamp_valid_bits)},
+      graphics_mask{valid_mask(graphics_timestamp_valid_bits)},
+      pipeline_statistics{pipeline_statistics} {
+
+    for(Slot &slot : slots) {
+      slot.timestamps = create_query_pool(VK_QUERY_TYPE_TIMESTAMP, 2*GPU_PROFILER_MAX_SCOPES, 0);
+      if(pipeline_statistics) {
+        slot.compute_statistics = create_query_pool(
+          VK_QUERY_TYPE_PIPELINE_STATISTICS,
+          GPU_PROFILER_MAX_SCOPES,
+          VK_QUERY_PIPELINE_STATISTIC_COMPUTE_SHADER_INVOCATIONS_BIT
+        );
+        slot.graphics_statistics = create_query_pool(
+          VK_QUERY_TYPE_PIPELINE_STATISTICS,
+          GPU_PROFILER_MAX_SCOPES,
+          VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+          VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT |
+          VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT
+        );
+      }
+    }
+  }
+
+  ~GpuProfiler(void) {
+    for(Slot &slot : slots) {
+      vkDestroyQueryPool(device, slot.timestamps, nullptr);
+      vkDestroyQueryPool(device, slot.compute_statistics, nullptr);
+      vkDestroyQueryPool(device, slot.graphics_statistics, nullptr);
+    }
+  }
+
+  GpuProfiler(const GpuProfiler &) = delete;
+  GpuProfiler &operator=(const GpuProfiler &) = delete;
+
+  // Moves on to the next slot, collecting what it recorded last time round.
+  void begin_frame(void) {
+    frame++;
+    collect(slots[frame % GPU_PROFILER_FRAMES]);
+  }
+
+  // Collects every slot, only call it once the device is idle.
+  void flush(void) {
+    for(Slot &slot : slots) {
+      collect(slot);
+    }
+  }
+
+  // Outside of dynamic rendering, the query resets are transfer commands.
+  [[nodiscard]]
+  u32 cmd_begin(VkCommandBuffer command_buffer, const GpuPass pass) {
+    Slot &slot = slots[frame % GPU_PROFILER_FRAMES];
+    if(slot.scope_count == GPU_PROFILER_MAX_SCOPES || timestamp_mask(pass) == 0) {
+      dropped_scopes++;
+      return GPU_PROFILER_NO_SCOPE;
+    }
+
+    const u32 scope = slot.scope_count++;
+    slot.passes[scope] = pass;
+    slot.frames[scope] = frame;
+
+    vkCmdResetQueryPool(command_buffer, slot.timestamps, 2*scope, 2);
+    if(pipeline_statistics) {
+      VkQueryPool statistics = statistics_pool(slot, pass);
+      vkCmdResetQueryPool(command_buffer, statistics, scope, 1);
+      vkCmdBeginQuery(command_buffer, statistics, scope, 0);
+    }
+    vkCmdWriteTimestamp2(command_buffer, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, slot.timestamps, 2*scope);
+    return scope;
+  }
+
+  void cmd_end(VkCommandBuffer command_buffer, const u32 scope) {
+    if(scope == GPU_PROFILER_NO_SCOPE) {
+      return;
+    }
+
+    Slot &slot = slots[frame % GPU_PROFILER_FRAMES];
+    vkCmdWriteTimestamp2(command_buffer, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, slot.timestamps, 2*scope + 1);
+    if(pipeline_statistics) {
+      vkCmdEndQuery(command_buffer, statistics_pool(slot, slot.passes[scope]), scope);
+    }
+  }
+
+  // Rolling statistics over the last GPU_PROFILER_WINDOW samples of a pass.
+  [[nodiscard]]
+  GpuPassReport report(const GpuPass pass) const {
+    const PassWindow &window = windows[pass];
+    const u32 count = std::min<u32>(window.count, GPU_PROFILER_WINDOW);
+    if(count == 0) {
+      return GpuPassReport{0, 0.0, 0.0, 0.0};
+    }
+
+    std::vector<f64> sorted(window.ms.begin(), window.ms.begin() + count);
+    std::sort(sorted.begin(), sorted.end());
+
+    f64 sum{0.0};
+    for(const f64 ms : sorted) {
+      sum += ms;
+    }
+
+    const u32 p99 = std::min<u32>(count - 1, static_cast<u32>(0.99*count));
+    return GpuPassReport{count, sorted.front(), sum / count, sorted[p99]};
+  }
+
+  void print_report(void) const {
+    for(u32 pass = 0; pass < GPU_PASS_COUNT; pass++) {
+      const GpuPassReport pass_report = report(static_cast<GpuPass>(pass));
+      if(pass_report.samples == 0) {
+        continue;
+      }
+      std::cout << "GPU " << GPU_PASS_NAMES[pass] << ": "
+                << pass_report.min_ms << " min, " << pass_report.avg_ms << " avg, " << pass_report.p99_ms << " p99 ms over "
+                << pass_report.samples << " samples" << std::endl;
+    }
+    if(dropped_scopes > 0) {
+      std::cout << "GPU " << dropped_scopes << " scopes dropped" << std::endl;
+    }
+  }
+
+  // One row per sample for offline analysis.
+  void export_csv(const std::string &path) const {
+    std::ofstream file(path, std::ios::trunc);
+    if(!file.is_open()) {
+      throw std::runtime_error("Failed to open " + path + " for writing!");
+    }
+
+    file << "frame,pass,ms,compute_invocations,vertex_invocations,fragment_invocations,primitives\n";
+    for(const GpuPassSample &sample : history) {
+      file << sample.frame << "," << GPU_PASS_NAMES[sample.pass] << "," << sample.ms << ","
+           << sample.statistics.compute_invocations << "," << sample.statistics.vertex_invocations << ","
+           << sample.statistics.fragment_invocations << "," << sample.statistics.primitives << "\n";
+    }
+    std::cout << "GPU profile of " << history.size() << " samples written to " << path << std::endl;
+  }
+
+  [[nodiscard]] inline
+  const std::vector<GpuPassSample> &get_history(void) const { return history; }
+
+  // Frames collected since the last call, in no particular order.
+  [[nodiscard]]
+  std::vector<GpuFrameTime> take_frame_times(void) {
+    return std::exchange(frame_times, {});
+  }
+
+  private:
+  struct Slot {
+    VkQueryPool timestamps{VK_NULL_HANDLE};
+    VkQueryPool compute_statistics{VK_NULL_HANDLE};
+    VkQueryPool graphics_statistics{VK_NULL_HANDLE};
+    std::array<GpuPass, GPU_PROFILER_MAX_SCOPES> passes{};
+    std::array<u64, GPU_PROFILER_MAX_SCOPES> frames{};
+    u32 scope_count{0};
+  };
+
+  struct PassWindow {
+    std::array<f64, GPU_PROFILER_WINDOW> ms{};
+    u32 count{0};
+  };
+
+  [[nodiscard]]
+  static u64 valid_mask(const u32 valid_bits) {
+    return valid_bits == 0 ? 0 : valid_bits >= 64 ? ~u64{0} : (u64{1} << valid_bits) - 1;
+  }
+
+  [[nodiscard]]
+  u64 timestamp_mask(const GpuPass pass) const {
+    return pass == GPU_PASS_RASTERIZATION ? graphics_mask : compute_mask;
+  }
+
+  [[nodiscard]]
+  static VkQueryPool statistics_pool(const Slot &slot, const GpuPass pass) {
+    return pass == GPU_PASS_RASTERIZATION ? slot.graphics_statistics : slot.compute_statistics;
+  }
+
+  [[nodiscard]]
+  VkQueryPool create_query_pool(const VkQueryType type, const u32 count, const VkQueryPipelineStatisticFlags statistics) {
+    VkQueryPoolCreateInfo create_info{
+      .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+      .pNext = nullptr,
+      .flags = 0,
+      .queryType = type,
+      .queryCount = count,
+      .pipelineStatistics = statistics,
+    };
+    VkQueryPool query_pool{VK_NULL_HANDLE};
+    VK_CHECK(vkCreateQueryPool(device, &create_info, nullptr, &query_pool));
+    return query_pool;
+  }
+
+  // Scopes still in flight are dropped rather than waited for. Each query
+  // is followed by its availability word.
+  void collect(Slot &slot) {
+    if(slot.scope_count == 0) {
+      return;
+    }
+
+    std::vector<u64> stamps(4*slot.scope_count);
+    const VkResult query_result = vkGetQueryPoolResults(
+      device,
+      slot.timestamps,
+      0,
+      2*slot.scope_count,
+      stamps.size()*sizeof(u64),
+      stamps.data(),
+      2*sizeof(u64),
+      VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT
+    );
+    if(query_result != VK_NOT_READY) {
+      VK_CHECK(query_result);
+    }
+
+    GpuFrameTime frame_time{slot.frames[0], 0.0};
+    u32 collected{0};
+    for(u32 scope = 0; scope < slot.scope_count; scope++) {
+      const u64 *begin = &stamps[4*scope];
+      const u64 *end = &stamps[4*scope + 2];
+      if(begin[1] == 0 || end[1] == 0) {
+        dropped_scopes++;
+        continue;
+      }
+
+      const GpuPass pass = slot.passes[scope];
+      const u64 ticks = (end[0] - begin[0]) & timestamp_mask(pass);
+      GpuPassSample sample{
+        .frame = slot.frames[scope],
+        .pass = pass,
+        .ms = static_cast<f64>(ticks)*timestamp_period*1e-6,
+        .statistics = {0, 0, 0, 0},
+      };
+
+      if(pipeline_statistics) {
+        sample.statistics = statistics_result(slot, scope);
+      }
+
+      PassWindow &window = windows[pass];
+      window.ms[window.count % GPU_PROFILER_WINDOW] = sample.ms;
+      window.count++;
+
+      if(history.size() < GPU_PROFILER_MAX_HISTORY) {
+        history.push_back(sample);
+      }
+      frame_time.ms += sample.ms;
+      collected++;
+    }
+
+    if(collected > 0 && frame_times.size() < GPU_PROFILER_MAX_HISTORY) {
+      frame_times.push_back(frame_time);
+    }
+    slot.scope_count = 0;
+  }
+
+  // Only the pool of the scope's pass holds a reset query at its index.
+  [[nodiscard]]
+  GpuPassStatistics statistics_result(const Slot &slot, const u32 scope) {
+    const bool graphics = slot.passes[scope] == GPU_PASS_RASTERIZATION;
+    const u32 counter_count = graphics ? 3 : 1;
+
+    std::array<u64, 4> counts{};
+    const VkResult query_result = vkGetQueryPoolResults(
+      device,
+      statistics_pool(slot, slot.passes[scope]),
+      scope,
+      1,
+      counts.size()*sizeof(u64),
+      counts.data(),
+      (counter_count + 1)*sizeof(u64),
+      VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT
+    );
+    if(query_result != VK_NOT_READY) {
+      VK_CHECK(query_result);
+    }
+    if(counts[counter_count] == 0) {
+      return GpuPassStatistics{0, 0, 0, 0};
+    }
+    return graphics ?
+      GpuPassStatistics{0, counts[0], counts[1], counts[2]} :
+      GpuPassStatistics{counts[0], 0, 0, 0};
+  }
+
+  VkDevice device;
+  f32 timestamp_period;
+  u64 compute_mask;
+  u64 graphics_mask;
+  bool pipeline_statistics;
+
+  std::array<Slot, GPU_PROFILER_FRAMES> slots{};
+  std::array<PassWindow, GPU_PASS_COUNT> windows{};
+  std::vector<GpuPassSample> history;
+  std::vector<GpuFrameTime> frame_times;
+  u64 frame{0};
+  u64 dropped_scopes{0};
+};
+
+}
@@ -0,0 +1 @@
+#include "pipeline_cache.hpp"
\ No newline at end of file
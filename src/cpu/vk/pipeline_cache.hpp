@@ -0,0 +1,161 @@
+#pragma once
+
+#include <types.inl>
+
+#include "../core/utils.hpp"
+#include "../core/paths.hpp"
+
+#include <vulkan/vulkan.h>
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace tmx {
+
+// Pipelines compiled by earlier runs, loaded at startup and written back
+// when the Context goes, so a warm start skips shader compilation. The file
+// is only handed to the driver that wrote it, some drivers crash on a
+// cache from another device rather than ignoring it.
+struct PipelineCache {
+  public:
+  static constexpr const char *CACHE_FILE = "pipeline_cache.bin";
+  static constexpr u32 FILE_MAGIC = 0x43505854; // "TXPC"
+
+  PipelineCache(VkDevice device, VkPhysicalDevice physical_device, const std::string &path = cache_path(CACHE_FILE))
+              : device{device}, path{path} {
+    vkGetPhysicalDeviceProperties(physical_device, &properties);
+
+    const std::vector<char> initial_data = load();
+    VkPipelineCacheCreateInfo create_info{
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+      .pNext = nullptr,
+      .flags = 0,
+      .initialDataSize = initial_data.size(),
+      .pInitialData = initial_data.empty() ? nullptr : initial_data.data(),
+    };
+    VK_CHECK(vkCreatePipelineCache(device, &create_info, nullptr, &pipeline_cache));
+  }
+
+  ~PipelineCache(void) {
+    save();
+    vkDestroyPipelineCache(device, pipeline_cache, nullptr);
+  }
+
+  PipelineCache(const PipelineCache &) = delete;
+  PipelineCache &operator=(const PipelineCache &) = delete;
+
+  [[nodiscard]] inline
+  VkPipelineCache get_pipeline_cache(void) const { return pipeline_cache; }
+
+  // Written next to the old file and renamed over it, so a crash mid write
+  // leaves the previous cache. Failing to save only costs the next startup.
+  void save(void) const {
+    size_t size{0};
+    if(vkGetPipelineCacheData(device, pipeline_cache, &size, nullptr) != VK_SUCCESS || size == 0) {
+      return;
+    }
+    std::vector<char> data(size);
+    if(vkGetPipelineCacheData(device, pipeline_cache, &size, data.data()) != VK_SUCCESS) {
+      return;
+    }
+
+    const std::string temporary_path = path + ".tmp";
+    {
+      std::ofstream file(temporary_path, std::ios::binary | std::ios::trunc);
+      if(!file.is_open()) {
+        std::cout << "Failed to write the pipeline cache to " << temporary_path << std::endl;
+        return;
+      }
+      const FileHeader header = expected_header(size);
+      file.write(reinterpret_cast<const char *>(&header), sizeof(FileHeader));
+      file.write(data.data(), static_cast<std::streamsize>(size));
+    }
+
+    std::error_code error;
+    std::filesystem::rename(temporary_path, path, error);
+    if(error) {
+      std::cout << "Failed to replace " << path << ": " << error.message() << std::endl;
+      return;
+    }
+    std::cout << "Pipeline cache of " << size << " bytes written to " << path << std::endl;
+  }
+
+  private:
+  // Ahead of the driver's data, which has its own VkPipelineCacheHeaderVersionOne.
+  struct FileHeader {
+    u32 magic;
+    u32 vendor_id;
+    u32 device_id;
+    u32 driver_version;
+    u8 pipeline_cache_uuid[VK_UUID_SIZE];
+    u64 data_size;
+  };
+
+  [[nodiscard]]
+  FileHeader expected_header(const u64 data_size) const {
+    FileHeader header{
+      .magic = FILE_MAGIC,
+      .vendor_id = properties.vendorID,
+      .device_id = properties.deviceID,
+      .driver_version = properties.driverVersion,
+      .pipeline_cache_uuid = {},
+      .data_size = data_size,
+    };
+    std::memcpy(header.pipeline_cache_uuid, properties.pipelineCacheUUID, VK_UUID_SIZE);
+    return header;
+  }
+
+  // Empty when there is no cache yet or it belongs to another device or
+  // driver, pipelines are then compiled from scratch.
+  [[nodiscard]]
+  std::vector<char> load(void) const {
+    std::ifstream file(path, std::ios::binary);
+    if(!file.is_open()) {
+      std::cout << "No pipeline cache at " << path << ", compiling every pipeline" << std::endl;
+      return {};
+    }
+
+    FileHeader header{};
+    file.read(reinterpret_cast<char *>(&header), sizeof(FileHeader));
+    const FileHeader expected = expected_header(header.data_size);
+    if(!file || std::memcmp(&header, &expected, sizeof(FileHeader)) != 0) {
+      std::cout << "Pipeline cache at " << path << " is from another device or driver, ignoring it" << std::endl;
+      return {};
+    }
+
+    std::vector<char> data(header.data_size);
+    file.read(data.data(), static_cast<std::streamsize>(data.size()));
+    if(!file || !driver_header_matches(data)) {
+      std::cout << "Pipeline cache at " << path << " is damaged, ignoring it" << std::endl;
+      return {};
+    }
+
+    std::cout << "Pipeline cache of " << data.size() << " bytes loaded from " << path << std::endl;
+    return data;
+  }
+
+  [[nodiscard]]
+  bool driver_header_matches(const std::vector<char> &data) const {
+    VkPipelineCacheHeaderVersionOne driver_header{};
+    if(data.size() < sizeof(driver_header)) {
+      return false;
+    }
+    std::memcpy(&driver_header, data.data(), sizeof(driver_header));
+    return driver_header.headerSize >= sizeof(driver_header) &&
+           driver_header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+           driver_header.vendorID == properties.vendorID &&
+           driver_header.deviceID == properties.deviceID &&
+           std::memcmp(driver_header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+  }
+
+  VkDevice device;
+  std::string path;
+  VkPhysicalDeviceProperties properties{};
+  VkPipelineCache pipeline_cache{VK_NULL_HANDLE};
+};
+
+}
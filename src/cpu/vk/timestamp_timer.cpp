@@ -0,0 +1 @@
+#include "timestamp_timer.hpp"
\ No newline at end of file
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <types.inl>
+
+#include "../core/utils.hpp"
+#include "context.hpp"
+
+#include <vulkan/vulkan.h>
+
+#include <stdexcept>
+#include <vector>
+
+namespace tmx {
+
+// Sums the GPU time spent between pairs of timestamps recorded into
+// compute command buffers. Meant for offline measurement: resolve_ms()
+// waits for every pair, so only call it after the submissions completed.
+struct TimestampTimer {
+  public:
+  TimestampTimer(Context *vk_context, const u32 capacity) : vk_context{vk_context}, capacity{capacity} {
+    if(vk_context->get_compute_timestamp_valid_bits() == 0) {
+      throw std::runtime_error("The compute queue does not support timestamps!");
+    }
+
+    VkQueryPoolCreateInfo create_info{
+      .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+      .pNext = nullptr,
+      .flags = 0,
+      .queryType = VK_QUERY_TYPE_TIMESTAMP,
+      .queryCount = 2*capacity,
+      .pipelineStatistics = 0,
+    };
+    VK_CHECK(vkCreateQueryPool(vk_context->get_device(), &create_info, nullptr, &query_pool));
+  }
+
+  ~TimestampTimer(void) {
+    vkDestroyQueryPool(vk_context->get_device(), query_pool, nullptr);
+  }
+
+  TimestampTimer(const TimestampTimer &) = delete;
+  TimestampTimer &operator=(const TimestampTimer &) = delete;
+
+  void cmd_begin(VkCommandBuffer command_buffer) {
+    if(pair_count == capacity) {
+      throw std::runtime_error("TimestampTimer capacity exceeded!");
+    }
+    vkCmdResetQueryPool(command_buffer, query_pool, 2*pair_count, 2);
+    vkCmdWriteTimestamp2(command_buffer, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, query_pool, 2*pair_count);
+  }
+
+  void cmd_end(VkCommandBuffer command_buffer) {
+    vkCmdWriteTimestamp2(command_buffer, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, query_pool, 2*pair_count + 1);
+    pair_count++;
+  }
+
+  // Total of the recorded pairs in milliseconds, the timer is empty afterwards.
+  [[nodiscard]]
+  f64 resolve_ms(void) {
+    if(pair_count == 0) {
+      return 0.0;
+    }
+
+    std::vector<u64> stamps(2*pair_count);
+    VK_CHECK(
+      vkGetQueryPoolResults(
+        vk_context->get_device(),
+        query_pool,
+        0,
+        2*pair_count,
+        stamps.size()*sizeof(u64),
+        stamps.data(),
+        sizeof(u64),
+        VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT
+      )
+    );
+
+    const u32 valid_bits = vk_context->get_compute_timestamp_valid_bits();
+    const u64 mask = valid_bits >= 64 ? ~u64{0} : (u64{1} << valid_bits) - 1;
+    u64 ticks{0};
+    for(u32 i = 0; i < pair_count; i++) {
+      ticks += ((stamps[2*i + 1] - stamps[2*i]) & mask);
+    }
+
+    pair_count = 0;
+    return static_cast<f64>(ticks) * vk_context->get_limits().timestampPeriod * 1e-6;
+  }
+
+  private:
+  Context *vk_context;
+  VkQueryPool query_pool{VK_NULL_HANDLE};
+  u32 capacity;
+  u32 pair_count{0};
+};
+
+}
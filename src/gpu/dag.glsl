@@ -0,0 +1,36 @@
+#ifndef DAG_GLSL
+#define DAG_GLSL
+
+#include "../../src/shared/push.inl"
+
+// Occupancy of a world-space voxel stored in a sparse voxel DAG, see
+// VoxelDag on the CPU for the layout. Interior nodes are a child mask
+// followed by one pointer per set bit, leaves are a 4^3 bit mask.
+// Voxels outside of the DAG are air.
+bool dag_occupied(u64 dag, int3 voxel) {
+  u32 node = deref(DagWords(dag))[DAG_WORD_ROOT];
+  u32 levels = deref(DagWords(dag))[DAG_WORD_LEVELS];
+
+  i32 side = DAG_LEAF_VOXELS << levels;
+  if(any(lessThan(voxel, int3(0))) || any(greaterThanEqual(voxel, int3(side)))) {
+    return false;
+  }
+
+  for(u32 level = levels; level > 0 && node > DAG_FULL; level--) {
+    u32 mask = deref(DagWords(dag))[node];
+    u32 octant = dag_octant(voxel, DAG_LEAF_VOXELS << (level - 1));
+    if((mask & (1u << octant)) == 0) {
+      return false;
+    }
+    node = deref(DagWords(dag))[node + 1 + bitCount(mask & ((1u << octant) - 1u))];
+  }
+
+  if(node <= DAG_FULL) {
+    return node == DAG_FULL;
+  }
+
+  u32 bit = dag_leaf_bit(voxel & (DAG_LEAF_VOXELS - 1));
+  return (deref(DagWords(dag))[node + (bit >> 5)] & (1u << (bit & 31))) != 0;
+}
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef DENSITY_GLSL
+#define DENSITY_GLSL
+
+#include "noise.glsl"
+#include "../../src/shared/push.inl"
+
+// Octaves of the density FBM, kept in sync with DensityBounds on the CPU.
+const float OCTAVE_SCALE[DENSITY_OCTAVES]     = float[](1.0, 2.0, 4.0, 16.0);
+const float OCTAVE_OFFSET[DENSITY_OCTAVES]    = float[](0.0, 2.85, 7.45, 24.95);
+const float OCTAVE_AMPLITUDE[DENSITY_OCTAVES] = float[](1.0, 0.5, 0.25, 0.0625);
+
+float fbm(float3 world_pos) {
+  float3 seed = density_seed_offset(DENSITY_SEED);
+
+  // [-0.97, 1.25] ~ 0.14
+  float density = 0.0;
+  for(i32 i = 0; i < DENSITY_OCTAVES; i++) {
+    density += snoise(seed + world_pos * DENSITY_FREQUENCY * OCTAVE_SCALE[i] + OCTAVE_OFFSET[i]) * OCTAVE_AMPLITUDE[i];
+  }
+  return density;
+}
+
+// Distance estimate in voxels, clamped to the stored density band.
+float evaluate(float3 world_pos) {
+  return clamp(fbm(world_pos) / DENSITY_LIPSCHITZ, -DENSITY_BAND, DENSITY_BAND);
+}
+
+// Conservative [min, max] of fbm() within radius of center. Each octave is
+// bounded by its value at the center plus its Lipschitz constant times the
+// radius, clamped to the amplitude of snoise.
+float2 fbm_bound(float3 center, float radius) {
+  float3 seed = density_seed_offset(DENSITY_SEED);
+
+  float2 bound = float2(0.0);
+  for(i32 i = 0; i < DENSITY_OCTAVES; i++) {
+    float frequency = DENSITY_FREQUENCY * OCTAVE_SCALE[i];
+    float n = snoise(seed + center * frequency + OCTAVE_OFFSET[i]);
+    float reach = SNOISE_LIPSCHITZ * frequency * radius;
+    bound += OCTAVE_AMPLITUDE[i] * float2(
+      max(n - reach, -SNOISE_AMPLITUDE),
+      min(n + reach,  SNOISE_AMPLITUDE)
+    );
+  }
+  return bound;
+}
+
+// Regions are only uniform when every voxel in them is clamped to the band.
+i32 classify_density(float3 lo, float3 hi) {
+  float2 bound = fbm_bound((lo + hi) * 0.5, length(hi - lo) * 0.5);
+  if(bound.x > DENSITY_SATURATION) return DENSITY_CLASS_OUTSIDE;
+  if(bound.y < -DENSITY_SATURATION) return DENSITY_CLASS_INSIDE;
+  return DENSITY_CLASS_SURFACE;
+}
+
+// Stored density of a world-space voxel, voxels outside of the world are air
+// and chunks without a brick hold their page's uniform density.
+float load_density(u64 page_table, u64 voxels, int3 voxel) {
+  if(!voxel_in_world(voxel)) return DENSITY_OUTSIDE_WORLD;
+  u32 page = deref(PageTable(page_table))[chunk2idx(voxel_chunk(voxel))];
+  if(!page_resident(page)) return page_uniform_density(page);
+  return decode_density(deref(Voxel(voxels))[pool_index(page, voxel_local(voxel))]);
+}
+
+#endif
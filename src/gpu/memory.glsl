@@ -4,33 +4,61 @@
 #include "../../src/shared/push.inl"
 
 // TODO: This is technically UB, replace with less UB version.
-u32 atomicMalloc(u64 allocator) {
+// Takes the first run of ceil(size/ALLOCATOR_PAGE_SIZE) free pages, chunks
+// whose mesh outgrows a page get several contiguous ones. Returns
+// ALLOCATOR_OUT_OF_PAGES when the vertex buffer has no such run left.
+// spins and probes count the failed lock attempts and the free[] entries
+// scanned, see ChunkStat.
+u32 atomicMalloc(u64 allocator, u32 size, out u32 spins, out u32 probes) {
   // Check allocator lock status until it is free,
   // in which case this thread while lock it and
-  // allocate a page.
+  // allocate the pages.
   Allocator pAllocator = Allocator(allocator);
-  while( bool(atomicCompSwap(pAllocator.locked, UNLOCKED, LOCKED)) );
+  u32 pages = (size + ALLOCATOR_PAGE_SIZE - 1)/ALLOCATOR_PAGE_SIZE;
+  spins = 0;
+  while(atomicCompSwap(pAllocator.locked, UNLOCKED, LOCKED) != UNLOCKED) { spins++; }
 
-  // Look for free page
+  // Look for enough free pages in a row
+  u32 first = 0;
   u32 i = 0;
-  while(pAllocator.free[i] != 0) { i++; }
+  while(i - first < pages && i < ALLOCATOR_MAX_ALLOCATIONS) {
+    if(pAllocator.free[i] != 0) { first = i + 1; }
+    i++;
+  }
+  probes = i;
 
-  // Mark page as used
-  pAllocator.free[i] = 1;
+  if(i - first < pages) {
+    atomicExchange(pAllocator.locked, UNLOCKED);
+    return ALLOCATOR_OUT_OF_PAGES;
+  }
+
+  // Mark pages as used
+  for(u32 page = first; page < first + pages; page++) {
+    pAllocator.free[page] = 1;
+  }
   // Unlock allocator
   atomicExchange(pAllocator.locked, UNLOCKED);
 
   // Base of allocation
-  return i*ALLOCATOR_PAGE_SIZE;
+  return first*ALLOCATOR_PAGE_SIZE;
+}
+
+u32 atomicMalloc(u64 allocator, u32 size) {
+  u32 spins, probes;
+  return atomicMalloc(allocator, size, spins, probes);
 }
 
 u32 debugMalloc(u64 pAllocator, u32 size) {
   return atomicAdd(Allocator(pAllocator).locked, size);
 }
 
-void atomicFree(u64 pAllocator, u32 global_index) {
-  u32 page = global_index/ALLOCATOR_PAGE_SIZE;
-  atomicExchange(Allocator(pAllocator).free[page], 0);
+// Releases the pages atomicMalloc handed out for size vertices at base.
+void atomicFree(u64 pAllocator, u32 base, u32 size) {
+  u32 first = base/ALLOCATOR_PAGE_SIZE;
+  u32 pages = (size + ALLOCATOR_PAGE_SIZE - 1)/ALLOCATOR_PAGE_SIZE;
+  for(u32 page = first; page < first + pages; page++) {
+    atomicExchange(Allocator(pAllocator).free[page], 0);
+  }
 }
 
 #endif
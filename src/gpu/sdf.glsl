@@ -0,0 +1,41 @@
+#ifndef SDF_GLSL
+#define SDF_GLSL
+
+#include "../../src/shared/push.inl"
+
+float sdf_sphere(float3 p, float radius) {
+  return length(p) - radius;
+}
+
+float sdf_box(float3 p, float3 half_extent) {
+  float3 q = abs(p) - half_extent;
+  return length(max(q, 0.0)) + min(max(q.x, max(q.y, q.z)), 0.0);
+}
+
+// Polynomial smooth minimum, k is the blend distance.
+float smooth_min(float a, float b, float k) {
+  float h = max(k - abs(a - b), 0.0) / k;
+  return min(a, b) - h*h*k*0.25;
+}
+
+// Negative density is inside the surface.
+float apply_sdf_edit(float density, SdfEdit edit, float3 world_pos) {
+  float3 p = world_pos - edit.center;
+
+  float distance = edit.shape == SDF_SHAPE_BOX ?
+    sdf_box(p, float3(edit.radius)) :
+    sdf_sphere(p, edit.radius);
+
+  switch(edit.operation) {
+    case SDF_OPERATION_UNION:
+      return min(density, distance);
+    case SDF_OPERATION_SUBTRACT:
+      return max(density, -distance);
+    case SDF_OPERATION_SMOOTH_UNION:
+      return edit.smoothing > 0.0 ? smooth_min(density, distance, edit.smoothing) : min(density, distance);
+  }
+
+  return density;
+}
+
+#endif
@@ -7,7 +7,7 @@ layout(location = 0) out float vcolor;
 
 void main(){
   u32 vertexID = gl_VertexIndex;
-  float4 vertex = deref(Vertex(pVertices[vertexID]));
+  float4 vertex = deref(Vertex(pVertices))[vertexID];
 
   float4 mvVert = CameraMatrices(pMatrices).view_matrix * float4(vertex.xyz, 1.0);
 
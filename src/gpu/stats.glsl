@@ -0,0 +1,19 @@
+#ifndef STATS_GLSL
+#define STATS_GLSL
+
+#include "../../src/shared/push.inl"
+
+// Clock of the chunk counters in ChunkStat. The *_clock shader variants are
+// compiled with CHUNK_STATS_CLOCK and enable GL_ARB_shader_clock before any
+// include, TerrainManager only loads them with shaderSubgroupClock. Elsewhere
+// the clocks read zero. Only the low word is kept, a chunk never takes 2^32
+// cycles, and the difference of two low words survives a wrap.
+u32 stats_clock() {
+#if defined(CHUNK_STATS_CLOCK)
+  return clock2x32ARB().x;
+#else
+  return 0u;
+#endif
+}
+
+#endif
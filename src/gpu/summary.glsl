@@ -0,0 +1,80 @@
+#ifndef SUMMARY_GLSL
+#define SUMMARY_GLSL
+
+#include "../../src/shared/push.inl"
+
+// Per-workgroup reduction of one chunk's densities into its brick and chunk
+// summaries. Floats are mapped to uints that sort in the same order so the
+// reduction can use shared memory atomics. Chunks may have more bricks than
+// the workgroup has invocations, so brick slots are strided over.
+
+shared u32 sh_brick_min[COUNT_BRICKS];
+shared u32 sh_brick_max[COUNT_BRICKS];
+
+u32 order_float(float f) {
+  u32 bits = floatBitsToUint(f);
+  return (bits & 0x80000000u) != 0 ? ~bits : bits | 0x80000000u;
+}
+
+float unorder_float(u32 bits) {
+  return uintBitsToFloat((bits & 0x80000000u) != 0 ? bits & 0x7FFFFFFFu : ~bits);
+}
+
+void summary_begin() {
+  for(u32 b = gl_LocalInvocationIndex; b < COUNT_BRICKS; b += WORKGROUP_SIZE) {
+    sh_brick_min[b] = 0xFFFFFFFFu;
+    sh_brick_max[b] = 0u;
+  }
+
+  barrier();
+  memoryBarrierShared();
+}
+
+void summary_accumulate(int3 local_voxel, float density) {
+  int3 brick = local_voxel / COUNT_BRICK_VOXELS;
+  u32 b = brick.x + brick.y*COUNT_BRICKS_X + brick.z*COUNT_BRICKS_X*COUNT_BRICKS_Y;
+  u32 d = order_float(density);
+  atomicMin(sh_brick_min[b], d);
+  atomicMax(sh_brick_max[b], d);
+}
+
+void summary_end(u64 summaries, int3 chunk) {
+  barrier();
+  memoryBarrierShared();
+
+  for(u32 i = gl_LocalInvocationIndex; i < COUNT_BRICKS; i += WORKGROUP_SIZE) {
+    int3 brick = int3(i % COUNT_BRICKS_X, (i / COUNT_BRICKS_X) % COUNT_BRICKS_Y, i / (COUNT_BRICKS_X*COUNT_BRICKS_Y));
+    deref(DensitySummaries(summaries))[summary_brick_index(chunk, brick)] =
+      float2(unorder_float(sh_brick_min[i]), unorder_float(sh_brick_max[i]));
+  }
+
+  if(gl_LocalInvocationIndex == 0) {
+    u32 lo = 0xFFFFFFFFu, hi = 0u;
+    for(u32 b = 0; b < COUNT_BRICKS; b++) {
+      lo = min(lo, sh_brick_min[b]);
+      hi = max(hi, sh_brick_max[b]);
+    }
+    deref(DensitySummaries(summaries))[summary_chunk_index(chunk)] =
+      float2(unorder_float(lo), unorder_float(hi));
+  }
+}
+
+// True when every cell corner read while meshing the chunk has the same sign.
+// Cells also read the lower faces of the +1 neighbours, which are covered by
+// the neighbours' summaries; outside of the world reads as air.
+bool chunk_cells_uniform(u64 summaries, int3 chunk) {
+  float lo = 3.4e38, hi = -3.4e38;
+  for(i32 i = 0; i < 8; i++) {
+    int3 n = chunk + int3(i & 1, (i >> 1) & 1, (i >> 2) & 1);
+    bool in_world = all(greaterThanEqual(n, int3(0))) &&
+                    all(lessThan(n, int3(COUNT_CHUNKS_X, COUNT_CHUNKS_Y, COUNT_CHUNKS_Z)));
+    float2 s = in_world ?
+      deref(DensitySummaries(summaries))[summary_chunk_index(n)] :
+      float2(DENSITY_OUTSIDE_WORLD);
+    lo = min(lo, s.x);
+    hi = max(hi, s.y);
+  }
+  return lo >= 0.0 || hi < 0.0;
+}
+
+#endif
@@ -5,26 +5,174 @@
 
 #if defined(__cplusplus)
 #include <vulkan/vulkan.h>
+#if defined(__BMI2__)
+#include <immintrin.h>
 #endif
+#endif
+
+// Chunk and world dimensions are chosen at startup, see GridConfig. The
+// shaders receive them as specialization constants with these ids, so one
+// SPIR-V build serves every configuration. The values below are defaults.
+#define SPEC_COUNT_VOXELS_X (0)
+#define SPEC_COUNT_VOXELS_Y (1)
+#define SPEC_COUNT_VOXELS_Z (2)
+#define SPEC_COUNT_CHUNKS_X (3)
+#define SPEC_COUNT_CHUNKS_Y (4)
+#define SPEC_COUNT_CHUNKS_Z (5)
+#define SPEC_WORKGROUP_SIZE (6)
+#define SPEC_SUBGROUP_SIZE  (7)
+#define SPEC_DENSITY_SEED   (8)
+
+// The chunk kernels run one dimensional workgroups of WORKGROUP_SIZE
+// invocations that stride over the voxels of their chunk. SUBGROUP_SIZE
+// is the device's pinned subgroup size, or the smallest one it may pick,
+// and only bounds the number of subgroups in a workgroup.
+#define DEFAULT_WORKGROUP_SIZE (512)
+
+#if defined(__cplusplus)
+inline i32 COUNT_VOXELS_X = 8;
+inline i32 COUNT_VOXELS_Y = 8;
+inline i32 COUNT_VOXELS_Z = 8;
+
+inline i32 COUNT_CHUNKS_X = 8;
+inline i32 COUNT_CHUNKS_Y = 8;
+inline i32 COUNT_CHUNKS_Z = 8;
+
+inline u32 WORKGROUP_SIZE = DEFAULT_WORKGROUP_SIZE;
+inline u32 SUBGROUP_SIZE = 32;
+
+inline u32 DENSITY_SEED = 0;
+#else
+layout(constant_id = SPEC_COUNT_VOXELS_X) const i32 COUNT_VOXELS_X = 8;
+layout(constant_id = SPEC_COUNT_VOXELS_Y) const i32 COUNT_VOXELS_Y = 8;
+layout(constant_id = SPEC_COUNT_VOXELS_Z) const i32 COUNT_VOXELS_Z = 8;
 
-#define COUNT_VOXELS_X (8)
-#define COUNT_VOXELS_Y (8)
-#define COUNT_VOXELS_Z (8)
+layout(constant_id = SPEC_COUNT_CHUNKS_X) const i32 COUNT_CHUNKS_X = 8;
+layout(constant_id = SPEC_COUNT_CHUNKS_Y) const i32 COUNT_CHUNKS_Y = 8;
+layout(constant_id = SPEC_COUNT_CHUNKS_Z) const i32 COUNT_CHUNKS_Z = 8;
 
-#define COUNT_CHUNKS_X (8)
-#define COUNT_CHUNKS_Y (8)
-#define COUNT_CHUNKS_Z (8)
+#define WORKGROUP_SIZE (gl_WorkGroupSize.x)
+layout(constant_id = SPEC_SUBGROUP_SIZE) const u32 SUBGROUP_SIZE = 32;
+
+layout(constant_id = SPEC_DENSITY_SEED) const u32 DENSITY_SEED = 0;
+#endif
 
 #define COUNT_CHUNKS (COUNT_CHUNKS_X*COUNT_CHUNKS_Y*COUNT_CHUNKS_Z)
+#define COUNT_VOXELS (COUNT_VOXELS_X*COUNT_VOXELS_Y*COUNT_VOXELS_Z)
+
+// Order of the voxels within a chunk and of the chunks within the world,
+// see voxel2idx and chunk2idx. The Z-order layout keeps the corners of
+// a cell and each 2^n block together, and needs cubic power of two sizes,
+// which GridConfig checks.
+#define VOXEL_LAYOUT_LINEAR (0)
+#define VOXEL_LAYOUT_MORTON (1)
+
+#ifndef VOXEL_LAYOUT
+#define VOXEL_LAYOUT VOXEL_LAYOUT_LINEAR
+#endif
+
+// Base frequency of the density FBM, see evaluate() in density.glsl
+// and DensityBounds on the CPU.
+#define DENSITY_FREQUENCY (0.008)
+#define DENSITY_OCTAVES (4)
+
+// Bounds of snoise(float3). Each of the four simplex corners contributes
+// 105 m^4 dot(g, x) with m = max(0.5 - |x|^2, 0) and |g| <= 1, so the value
+// is at most sum(105 m^4 |x|) and the gradient at most
+// sum(105 m^3 (0.5 + 7|x|^2)); maximised over a simplex these give
+// 0.976 and 11.62, rounded up.
+#define SNOISE_AMPLITUDE (0.98)
+#define SNOISE_LIPSCHITZ (11.7)
+
+// Lipschitz constant of the FBM per voxel, the octaves' scale times
+// amplitude sums to 4.
+#define DENSITY_LIPSCHITZ (SNOISE_LIPSCHITZ*DENSITY_FREQUENCY*4.0)
+
+// Stored densities are signed distance estimates in voxels (the FBM over
+// its Lipschitz constant, or the SDF of an edit) clamped to DENSITY_BAND.
+// Both corners of an edge that crosses the surface lie within one voxel
+// of it, so a band of one voxel never moves a vertex. DENSITY_SATURATION
+// is the FBM value past which the stored density is clamped.
+#define DENSITY_BAND (1.0)
+#define DENSITY_SATURATION (DENSITY_BAND*DENSITY_LIPSCHITZ)
+
+// Density outside of the world, treated as air.
+#define DENSITY_OUTSIDE_WORLD (DENSITY_BAND)
+
+// Encoding of the stored densities, DENSITY_ENCODING selects one.
+// The snorm encodings map [-DENSITY_BAND, DENSITY_BAND] onto the full
+// code range, 16 bits need storageBuffer16BitAccess.
+#define DENSITY_ENCODING_F32     (0)
+#define DENSITY_ENCODING_SNORM16 (1)
+#define DENSITY_ENCODING_SNORM8  (2)
+
+#ifndef DENSITY_ENCODING
+#define DENSITY_ENCODING DENSITY_ENCODING_SNORM16
+#endif
+
+#if DENSITY_ENCODING == DENSITY_ENCODING_F32
+#define DensityCode f32
+#elif DENSITY_ENCODING == DENSITY_ENCODING_SNORM16
+#define DensityCode i16
+#define DENSITY_CODE_MAX (32767.0)
+#elif DENSITY_ENCODING == DENSITY_ENCODING_SNORM8
+#define DensityCode i8
+#define DENSITY_CODE_MAX (127.0)
+#endif
+
+// Bound classification of a region's density.
+#define DENSITY_CLASS_OUTSIDE (0)
+#define DENSITY_CLASS_INSIDE  (1)
+#define DENSITY_CLASS_SURFACE (2)
+
+// Voxels live in a pool of chunk-sized bricks. Only chunks that can
+// hold surface are resident; the page table maps every chunk to its
+// pool slot or to one of the uniform sentinels below. The host sizes
+// the pool from the chunks DensityBounds cannot prove uniform.
+
+#define PAGE_UNIFORM_OUTSIDE (0xFFFFFFFFu)
+#define PAGE_UNIFORM_INSIDE  (0xFFFFFFFEu)
+
+// Large static worlds can be meshed from a sparse voxel DAG of occupancy
+// instead of the pool, see VoxelDag and dag.glsl. Word 0 of the DAG is the
+// root and word 1 the number of interior levels above the 4^3 leaves, nodes
+// follow. Child pointers 0 and 1 never name a node, they stand for empty
+// and solid subtrees.
+#define DAG_WORD_ROOT    (0)
+#define DAG_WORD_LEVELS  (1)
+#define DAG_HEADER_WORDS (2)
+
+#define DAG_EMPTY (0u)
+#define DAG_FULL  (1u)
+
+#define DAG_LEAF_VOXELS (4)
+#define DAG_LEAF_WORDS  (2)
+
+#define COUNT_BRICK_VOXELS (4)
+
+#define COUNT_BRICKS_X (COUNT_VOXELS_X/COUNT_BRICK_VOXELS)
+#define COUNT_BRICKS_Y (COUNT_VOXELS_Y/COUNT_BRICK_VOXELS)
+#define COUNT_BRICKS_Z (COUNT_VOXELS_Z/COUNT_BRICK_VOXELS)
+
+#define COUNT_BRICKS (COUNT_BRICKS_X*COUNT_BRICKS_Y*COUNT_BRICKS_Z)
+#define COUNT_SUMMARIES (COUNT_CHUNKS*(1 + COUNT_BRICKS))
 
 // Refactoring...
 
 BDA(Vertex) {
-  float4 value;
+  float4 value[1];
 };
 
 BDA(Voxel) {
-  float value;
+  DensityCode value[1];
+};
+
+BDA(PageTable) {
+  u32 value[1];
+};
+
+BDA(DagWords) {
+  u32 value[1];
 };
 
 BDA(CameraMatrices) {
@@ -56,29 +204,104 @@ BDA(McPtrTable) {
 };
 
 
+// mc_dropped_meshes counts the meshes atomicMalloc found no pages for.
 BDA(GpuGlobals) {
   u32 mc_chunks_indirect_cmd_count;
+  u32 mc_dropped_meshes;
 };
 
+// x: indirect command slot + 1 (0 if the chunk has never been drawn)
+// y: vertex count of the chunk's current mesh
 BDA(ChunkDrawInfo) {
-  uint2 value;
+  uint2 value[1];
+};
+
+BDA(DrawIndirectCommands) {
+  VkDrawIndirectCommand value[1];
+};
+
+BDA(DirtyFlags) {
+  u32 value[1];
+};
+
+// Min/max density of the voxels owned by each chunk, followed by the
+// min/max of each brick within every chunk. See summary_chunk_index and
+// summary_brick_index.
+BDA(DensitySummaries) {
+  float2 value[1];
+};
+
+// The header doubles as a VkDispatchIndirectCommand with
+// one workgroup per queued chunk.
+BDA(ChunkQueue) {
+  uint3 dispatch;
+  u32   pad;
+  int4  chunks[1];
+};
+
+#define SDF_OPERATION_UNION        0
+#define SDF_OPERATION_SUBTRACT     1
+#define SDF_OPERATION_SMOOTH_UNION 2
+
+#define SDF_SHAPE_SPHERE 0
+#define SDF_SHAPE_BOX    1
+
+#define MAX_SDF_EDITS_PER_FRAME 256
+
+// Radius is the half extent for boxes, smoothing is the
+// blend distance of SDF_OPERATION_SMOOTH_UNION, in voxels.
+struct SdfEdit {
+  float3 center;
+  f32    radius;
+  u32    operation;
+  u32    shape;
+  f32    smoothing;
+  u32    pad;
 };
 
+BDA(SdfEdits) {
+  SdfEdit value[1];
+};
+
+// Bytes of float4 vertices all chunk meshes share, free[] has a flag per
+// page of it.
+#define VERTEX_BUFFER_SIZE 2147483646
 #define ALLOCATOR_PAGE_SIZE 8192
-#define ALLOCATOR_MAX_ALLOCATIONS 2147483647/ALLOCATOR_PAGE_SIZE
+#define ALLOCATOR_MAX_ALLOCATIONS (VERTEX_BUFFER_SIZE/(16*ALLOCATOR_PAGE_SIZE))
+#define ALLOCATOR_OUT_OF_PAGES 0xFFFFFFFFu
 
 #define LOCKED 0
 #define UNLOCKED 1
 
-struct Allocator {
+BDA(Allocator) {
   u32 locked;
   u32 free[1];
 };
 
+// Cost counters of one chunk, written by generation and meshing when their
+// push constants carry pChunkStats, see ChunkStatsReport. Meshing counters
+// describe the chunk's latest mesh. Clocks are subgroup clock cycles of the
+// chunk's workgroup, only the *_clock shader variants count them.
+struct ChunkStat {
+  u32 generations;
+  u32 noise_voxels;       // voxels whose FBM was evaluated
+  u32 generation_clocks;
+  u32 meshings;
+  u32 nonempty_cells;     // cells that emitted vertices
+  u32 vertices;
+  u32 alloc_spins;        // failed attempts at the allocator lock
+  u32 alloc_probes;       // free[] entries scanned for the pages
+  u32 meshing_clocks;
+};
+
+BDA(ChunkStats) {
+  ChunkStat value[1];
+};
+
 
 #if defined(GRAPHICS_PUSH_CONSTANT) || defined(__cplusplus)
 PUSH(GraphicsPush) {
-  PTR(Vertex)         pVertices[1];
+  PTR(Vertex)         pVertices;
   PTR(CameraMatrices) pMatrices;
 };
 #endif
@@ -97,10 +320,18 @@ push_assert(IsosurfaceDrawCollectionPush);
 
 #if defined(ISOSURFACE_GENERATION_PUSH_CONSTANT) || defined(__cplusplus)
 PUSH(IsosurfaceGenerationPush) {
-  PTR(Voxel)                 pVoxels[1];
+  PTR(Voxel)                 pVoxels;
+  PTR(PageTable)             pPageTable;
+  PTR(DensitySummaries)      pSummaries;
   PTR(ChunkDrawInfo)         pChunkDrawInfo;
   PTR(VkDrawIndirectCommand) pIndirect;
   PTR(GpuGlobals)            pGpuGlobals;
+
+  // Optional, see ChunkStat. The pad keeps chunk_pos at the offset of
+  // the std430 push block.
+  PTR(ChunkStats)            pChunkStats;
+  u64                        pad;
+
   int4                       chunk_pos;
 };
 push_assert(IsosurfaceGenerationPush);
@@ -114,15 +345,48 @@ PUSH(IsosurfaceMeshingPush) {
               
   PTR(Vertex)                pVertices;
   PTR(Voxel)                 pVoxels;
+  PTR(PageTable)             pPageTable;
+  PTR(DensitySummaries)      pSummaries;
 
+  PTR(ChunkDrawInfo)         pChunkDrawInfo;
   PTR(VkDrawIndirectCommand) pIndirect;
   PTR(GpuGlobals)            pGpuGlobals;
 
+  // When set, workgroup i meshes pChunkQueue.chunks[i] and clears
+  // its flag in pDirtyFlags instead of meshing chunk_pos.
+  PTR(ChunkQueue)            pChunkQueue;
+  PTR(DirtyFlags)            pDirtyFlags;
+
+  // When set, occupancy is read from this DAG instead of pVoxels.
+  PTR(DagWords)              pDag;
+
+  // Optional, see ChunkStat. The pad keeps chunk_pos at the offset of
+  // the std430 push block.
+  PTR(ChunkStats)            pChunkStats;
+  u64                        pad;
+
   int4                       chunk_pos;
 };
 #endif
 push_assert(IsosurfaceMeshingPush);
 
+
+#if defined(ISOSURFACE_EDIT_PUSH_CONSTANT) || defined(__cplusplus)
+PUSH(IsosurfaceEditPush) {
+  PTR(Voxel)                 pVoxels;
+  PTR(PageTable)             pPageTable;
+  PTR(DensitySummaries)      pSummaries;
+  PTR(SdfEdits)              pEdits;
+
+  PTR(ChunkQueue)            pEditChunks;
+  PTR(ChunkQueue)            pDirtyChunks;
+  PTR(DirtyFlags)            pDirtyFlags;
+
+  u32                        edit_count;
+};
+#endif
+push_assert(IsosurfaceEditPush);
+
 /***************************************************************/
 
 #ifndef __cplusplus
@@ -130,24 +394,145 @@ push_assert(IsosurfaceMeshingPush);
 #define inline
 #endif
 
-inline static u32 fromcoord(i32 x, i32 y, i32 z, i32 cx, i32 cy, i32 cz) {
-  return x+y*COUNT_VOXELS_X+z*COUNT_VOXELS_X*COUNT_VOXELS_Y
-         +
-         cx*COUNT_VOXELS_X*COUNT_VOXELS_Y*COUNT_VOXELS_Z
-         +cy*COUNT_VOXELS_X*COUNT_VOXELS_Y*COUNT_VOXELS_Z*COUNT_CHUNKS_X
-         +cz*COUNT_VOXELS_X*COUNT_VOXELS_Y*COUNT_VOXELS_Z*COUNT_CHUNKS_X*COUNT_CHUNKS_Y;
+inline static int3 voxel_chunk(int3 voxel) {
+  return voxel / int3(COUNT_VOXELS_X, COUNT_VOXELS_Y, COUNT_VOXELS_Z);
+}
+
+inline static int3 voxel_local(int3 voxel) {
+  return voxel % int3(COUNT_VOXELS_X, COUNT_VOXELS_Y, COUNT_VOXELS_Z);
+}
+
+inline static bool page_resident(u32 page) {
+  return page < PAGE_UNIFORM_INSIDE;
+}
+
+inline static f32 page_uniform_density(u32 page) {
+  return page == PAGE_UNIFORM_INSIDE ? -f32(DENSITY_BAND) : f32(DENSITY_BAND);
+}
+
+// Noise space offset of a world seed. The components stay small so that
+// snoise keeps its precision far from the origin of the world.
+inline static float3 density_seed_offset(u32 seed) {
+  return float3(f32(seed % 64u), f32((seed / 64u) % 64u), f32((seed / 4096u) % 64u)) * f32(3.7);
+}
+
+inline static DensityCode encode_density(f32 density) {
+  f32 clamped = clamp(density, -f32(DENSITY_BAND), f32(DENSITY_BAND));
+#if DENSITY_ENCODING == DENSITY_ENCODING_F32
+  return clamped;
+#else
+  return DensityCode(round(clamped / f32(DENSITY_BAND) * f32(DENSITY_CODE_MAX)));
+#endif
+}
+
+inline static f32 decode_density(DensityCode code) {
+#if DENSITY_ENCODING == DENSITY_ENCODING_F32
+  return code;
+#else
+  return f32(code) / f32(DENSITY_CODE_MAX) * f32(DENSITY_BAND);
+#endif
+}
+
+// Spreads the low 10 bits of v so that two zero bits follow each one.
+inline static u32 morton_spread(u32 v) {
+#if defined(__cplusplus) && defined(__BMI2__)
+  return _pdep_u32(v, 0x09249249u);
+#else
+  v &= 0x000003FFu;
+  v = (v | (v << 16)) & 0x030000FFu;
+  v = (v | (v <<  8)) & 0x0300F00Fu;
+  v = (v | (v <<  4)) & 0x030C30C3u;
+  v = (v | (v <<  2)) & 0x09249249u;
+  return v;
+#endif
+}
+
+// Inverse of morton_spread.
+inline static u32 morton_compact(u32 v) {
+#if defined(__cplusplus) && defined(__BMI2__)
+  return _pext_u32(v, 0x09249249u);
+#else
+  v &= 0x09249249u;
+  v = (v | (v >>  2)) & 0x030C30C3u;
+  v = (v | (v >>  4)) & 0x0300F00Fu;
+  v = (v | (v >>  8)) & 0x030000FFu;
+  v = (v | (v >> 16)) & 0x000003FFu;
+  return v;
+#endif
 }
 
-inline static u32 fromcoord(int3 voxel_pos, int3 chunk_pos) {
-  return fromcoord(voxel_pos.x, voxel_pos.y, voxel_pos.z, chunk_pos.x, chunk_pos.y, chunk_pos.z);
+inline static u32 morton_encode(int3 pos) {
+  return morton_spread(u32(pos.x)) | morton_spread(u32(pos.y)) << 1 | morton_spread(u32(pos.z)) << 2;
 }
 
+inline static int3 morton_decode(u32 index) {
+  return int3(i32(morton_compact(index)), i32(morton_compact(index >> 1)), i32(morton_compact(index >> 2)));
+}
+
+// Bit of a voxel within the 64 bit occupancy mask of a DAG leaf.
+inline static u32 dag_leaf_bit(int3 local) {
+  return local.x+local.y*DAG_LEAF_VOXELS+local.z*DAG_LEAF_VOXELS*DAG_LEAF_VOXELS;
+}
+
+// Child slot of a voxel within a node whose children are child_voxels wide.
+inline static u32 dag_octant(int3 voxel, i32 child_voxels) {
+  return (voxel.x/child_voxels & 1) | (voxel.y/child_voxels & 1) << 1 | (voxel.z/child_voxels & 1) << 2;
+}
+
+inline static bool voxel_in_world(int3 voxel) {
+  return voxel.x >= 0 && voxel.x < COUNT_VOXELS_X*COUNT_CHUNKS_X
+      && voxel.y >= 0 && voxel.y < COUNT_VOXELS_Y*COUNT_CHUNKS_Y
+      && voxel.z >= 0 && voxel.z < COUNT_VOXELS_Z*COUNT_CHUNKS_Z;
+}
+
+// Index of a voxel within its chunk.
 inline static u32 voxel2idx(int3 voxel_pos) {
+#if VOXEL_LAYOUT == VOXEL_LAYOUT_MORTON
+  return morton_encode(voxel_pos);
+#else
   return voxel_pos.x+voxel_pos.y*COUNT_VOXELS_X+voxel_pos.z*COUNT_VOXELS_X*COUNT_VOXELS_Y;
+#endif
+}
+
+// Local voxel of a chunk index, also maps a workgroup's invocations
+// onto voxels so that neighbouring invocations touch neighbouring memory.
+inline static int3 idx2voxel(u32 index) {
+#if VOXEL_LAYOUT == VOXEL_LAYOUT_MORTON
+  return morton_decode(index);
+#else
+  return int3(i32(index % COUNT_VOXELS_X), i32((index / COUNT_VOXELS_X) % COUNT_VOXELS_Y), i32(index / (COUNT_VOXELS_X*COUNT_VOXELS_Y)));
+#endif
 }
 
 inline static u32 chunk2idx(int3 chunk_pos) {
+#if VOXEL_LAYOUT == VOXEL_LAYOUT_MORTON
+  return morton_encode(chunk_pos);
+#else
   return chunk_pos.x+chunk_pos.y*COUNT_CHUNKS_X+chunk_pos.z*COUNT_CHUNKS_X*COUNT_CHUNKS_Y;
+#endif
+}
+
+inline static int3 idx2chunk(u32 index) {
+#if VOXEL_LAYOUT == VOXEL_LAYOUT_MORTON
+  return morton_decode(index);
+#else
+  return int3(i32(index % COUNT_CHUNKS_X), i32((index / COUNT_CHUNKS_X) % COUNT_CHUNKS_Y), i32(index / (COUNT_CHUNKS_X*COUNT_CHUNKS_Y)));
+#endif
+}
+
+// Index into the brick pool of a voxel of a resident chunk.
+inline static u32 pool_index(u32 page, int3 local) {
+  return page*COUNT_VOXELS + voxel2idx(local);
+}
+
+inline static u32 summary_chunk_index(int3 chunk_pos) {
+  return chunk2idx(chunk_pos);
+}
+
+inline static u32 summary_brick_index(int3 chunk_pos, int3 brick_pos) {
+  return COUNT_CHUNKS
+         + chunk2idx(chunk_pos)*COUNT_BRICKS
+         + brick_pos.x+brick_pos.y*COUNT_BRICKS_X+brick_pos.z*COUNT_BRICKS_X*COUNT_BRICKS_Y;
 }
 
 inline static u32 flatten(int3 pos, int dimensions) {
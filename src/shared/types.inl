@@ -52,6 +52,8 @@ typedef glm::uvec4 uint4;
 #extension GL_EXT_shader_explicit_arithmetic_types_int32 : require
 #extension GL_EXT_shader_explicit_arithmetic_types_int64 : require
 #extension GL_EXT_shader_atomic_int64 : require
+#extension GL_EXT_shader_16bit_storage : require
+#extension GL_EXT_shader_8bit_storage : require
 
 #define VkDrawIndirectCommand uint4
 
@@ -64,6 +66,9 @@ typedef glm::uvec4 uint4;
 #define i64 int64_t
 #define u64 uint64_t
 
+#define f32 float
+#define f64 double
+
 #define float4x4 mat4
 #define float2   vec2
 #define float3   vec3
@@ -85,6 +90,7 @@ typedef glm::uvec4 uint4;
 #define deref(var) var.value
 #define push_assert(expr)
 #define numthreads(sz_x, sz_y, sz_z) layout(local_size_x = sz_x, local_size_y = sz_y, local_size_z = sz_z) in;
+#define numthreads_id(sz_x, id_x) layout(local_size_x = sz_x, local_size_x_id = id_x) in;
 
 #endif// #ifdef __cplusplus
 